@@ -0,0 +1,218 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <climits>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include "controlCache.h"
+
+#define CACHE_MAGIC 0x76346c32
+#define CACHE_VERSION 2
+
+/* Flags which follow the state of the device rather than describe it */
+#define VOLATILE_FLAGS (V4L2_CTRL_FLAG_GRABBED | V4L2_CTRL_FLAG_INACTIVE)
+
+static __s32 clamp32(__s64 val)
+{
+    if(val < INT_MIN)
+        return INT_MIN;
+    if(val > INT_MAX)
+        return INT_MAX;
+    return val;
+}
+
+void V4L2ControlInfo::setExt(const struct v4l2_query_ext_ctrl &e)
+{
+    ext = e;
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.id = e.id;
+    ctrl.type = (enum v4l2_ctrl_type)e.type;
+    memcpy(ctrl.name, e.name, sizeof(ctrl.name));
+    ctrl.flags = e.flags;
+    ctrl.default_value = clamp32(e.default_value);
+    if(e.type == V4L2_CTRL_TYPE_BITMASK) {
+        /* The mask of the valid bits, bit 31 included */
+        ctrl.minimum = 0;
+        ctrl.maximum = (__u32)e.maximum;
+        ctrl.step = 0;
+        ctrl.default_value = (__u32)e.default_value;
+    } else {
+        ctrl.minimum = clamp32(e.minimum);
+        ctrl.maximum = clamp32(e.maximum);
+        ctrl.step = e.step > INT_MAX ? INT_MAX : e.step;
+    }
+}
+
+void V4L2ControlInfo::setQuery(const struct v4l2_queryctrl &q)
+{
+    ctrl = q;
+    memset(&ext, 0, sizeof(ext));
+    ext.id = q.id;
+    ext.type = q.type;
+    memcpy(ext.name, q.name, sizeof(ext.name));
+    ext.minimum = q.minimum;
+    if(q.type == V4L2_CTRL_TYPE_BITMASK)
+        ext.maximum = (__u32)q.maximum;
+    else
+        ext.maximum = q.maximum;
+    ext.step = q.step;
+    ext.default_value = q.default_value;
+    ext.flags = q.flags;
+    ext.elems = 1;
+    switch(q.type) {
+        case V4L2_CTRL_TYPE_INTEGER64:
+            ext.elem_size = sizeof(__s64);
+            break;
+        case V4L2_CTRL_TYPE_STRING:
+            /* Strings always went through the extended control API */
+            ext.elem_size = q.maximum + 1;
+            ext.flags |= V4L2_CTRL_FLAG_HAS_PAYLOAD;
+            break;
+        default:
+            ext.elem_size = sizeof(__s32);
+            break;
+    }
+}
+
+static QByteArray deviceKey(const struct v4l2_capability &cap)
+{
+    QByteArray key;
+    key.append((const char *)cap.driver);
+    key.append('\0');
+    key.append((const char *)cap.card);
+    key.append('\0');
+    key.append((const char *)cap.bus_info);
+    key.append('\0');
+    key.append(QByteArray::number(cap.version));
+    return key;
+}
+
+QString ControlCache::fileName(const struct v4l2_capability &cap)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QByteArray hash = QCryptographicHash::hash(deviceKey(cap), QCryptographicHash::Md5);
+    return dir + "/controls-" + hash.toHex();
+}
+
+bool ControlCache::load(const struct v4l2_capability &cap, QList<V4L2ControlInfo> &infos)
+{
+    QFile file(fileName(cap));
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic, version, count;
+    QByteArray key;
+    in >> magic >> version >> key >> count;
+    if(magic != CACHE_MAGIC || version != CACHE_VERSION || key != deviceKey(cap))
+        return false;
+
+    infos.clear();
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        V4L2ControlInfo info;
+        struct v4l2_query_ext_ctrl e;
+        QByteArray name;
+        quint32 id, type, flags, elemSize, elems, dims;
+        qint64 minimum, maximum, default_value, value64;
+        quint64 step;
+        qint32 value;
+
+        memset(&e, 0, sizeof(e));
+        in >> id >> type >> name >> minimum >> maximum >> step
+           >> default_value >> flags >> elemSize >> elems >> dims;
+        for(int k = 0; k < V4L2_CTRL_MAX_DIMS; k++) {
+            quint32 dim;
+            in >> dim;
+            e.dims[k] = dim;
+        }
+        in >> info.menu >> value >> value64;
+        e.id = id;
+        e.type = type;
+        strncpy(e.name, name.constData(), sizeof(e.name) - 1);
+        e.minimum = minimum;
+        e.maximum = maximum;
+        e.step = step;
+        e.default_value = default_value;
+        e.flags = flags;
+        e.elem_size = elemSize;
+        e.elems = elems;
+        e.nr_of_dims = dims;
+        info.setExt(e);
+        info.value = value;
+        info.value64 = value64;
+        infos.append(info);
+    }
+
+    if(in.status() != QDataStream::Ok) {
+        infos.clear();
+        return false;
+    }
+    return true;
+}
+
+void ControlCache::save(const struct v4l2_capability &cap, const QList<V4L2ControlInfo> &infos)
+{
+    QString name = fileName(cap);
+    QDir().mkpath(QFileInfo(name).path());
+
+    QFile file(name);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QDataStream out(&file);
+    out << (quint32)CACHE_MAGIC << (quint32)CACHE_VERSION << deviceKey(cap)
+        << (quint32)infos.size();
+
+    QList<V4L2ControlInfo>::const_iterator it;
+    for(it = infos.begin(); it != infos.end(); it++) {
+        const struct v4l2_query_ext_ctrl &e = it->ext;
+        out << (quint32)e.id << (quint32)e.type
+            << QByteArray(e.name)
+            << (qint64)e.minimum << (qint64)e.maximum << (quint64)e.step
+            << (qint64)e.default_value << (quint32)e.flags
+            << (quint32)e.elem_size << (quint32)e.elems << (quint32)e.nr_of_dims;
+        for(int k = 0; k < V4L2_CTRL_MAX_DIMS; k++)
+            out << (quint32)e.dims[k];
+        out << it->menu << (qint32)it->value << (qint64)it->value64;
+    }
+}
+
+void ControlCache::invalidate(const struct v4l2_capability &cap)
+{
+    QFile::remove(fileName(cap));
+}
+
+bool ControlCache::sameDescriptor(const V4L2ControlInfo &a, const V4L2ControlInfo &b)
+{
+    const struct v4l2_query_ext_ctrl &x = a.ext, &y = b.ext;
+    return x.id == y.id && x.type == y.type &&
+           !strncmp(x.name, y.name, sizeof(x.name)) &&
+           x.minimum == y.minimum && x.maximum == y.maximum &&
+           x.step == y.step && x.default_value == y.default_value &&
+           (x.flags & ~VOLATILE_FLAGS) == (y.flags & ~VOLATILE_FLAGS) &&
+           x.elem_size == y.elem_size && x.elems == y.elems &&
+           x.nr_of_dims == y.nr_of_dims && !memcmp(x.dims, y.dims, sizeof(x.dims));
+}
@@ -0,0 +1,64 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef CONTROLCACHE_H
+#define CONTROLCACHE_H
+
+#include <linux/types.h>          /* for videodev2.h */
+#include <linux/videodev2.h>
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/* Everything needed to create the widget of a control without talking to
+   the device */
+struct V4L2ControlInfo
+{
+    struct v4l2_queryctrl ctrl;     /* ext clamped to 32 bit, as most of
+                                       the code only needs that */
+    struct v4l2_query_ext_ctrl ext;
+    QStringList menu;
+    int value;
+    qint64 value64;                 /* for V4L2_CTRL_TYPE_INTEGER64 */
+
+    void setExt(const struct v4l2_query_ext_ctrl &e);
+    /* For drivers without VIDIOC_QUERY_EXT_CTRL */
+    void setQuery(const struct v4l2_queryctrl &q);
+    /* Strings, arrays and compound controls */
+    bool hasPayload() const { return ext.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD; }
+    int payloadSize() const { return ext.elem_size * ext.elems; }
+};
+
+/* Control descriptors and last known values are kept on disk, keyed on the
+   identity of the device, so that a window can be shown before the
+   (possibly slow) device has been enumerated again. */
+class ControlCache
+{
+public:
+    static bool load(const struct v4l2_capability &cap, QList<V4L2ControlInfo> &infos);
+    static void save(const struct v4l2_capability &cap, const QList<V4L2ControlInfo> &infos);
+    static void invalidate(const struct v4l2_capability &cap);
+    static bool sameDescriptor(const V4L2ControlInfo &a, const V4L2ControlInfo &b);
+
+private:
+    static QString fileName(const struct v4l2_capability &cap);
+};
+
+#endif
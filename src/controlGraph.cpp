@@ -0,0 +1,38 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include "controlGraph.h"
+
+void V4L2ControlGraph::setControls(const QVector<__u32> &ids)
+{
+    dependents.clear();
+    auto_modes_init(&autos);
+    for(int i = 0; i < control_edge_count; i++) {
+        const struct control_edge &e = control_edges[i];
+        if(ids.contains(e.master) && ids.contains(e.dependent))
+            dependents[e.master].append(e.dependent);
+    }
+}
+
+bool V4L2ControlGraph::setValue(__u32 id, int value)
+{
+    if(!isMaster(id))
+        return false;
+    return auto_modes_set(&autos, id, value);
+}
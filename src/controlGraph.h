@@ -0,0 +1,58 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef CONTROLGRAPH_H
+#define CONTROLGRAPH_H
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+#include "v4l2core.h"
+
+/* Which controls of one device gate which others: exposure auto gates
+   exposure and iris, focus auto gates focus and so on. Older drivers do
+   not report the resulting flags, so the graph also keeps the value of
+   every auto mode and adds them itself. Every device has its own graph. */
+class V4L2ControlGraph
+{
+public:
+    V4L2ControlGraph() { auto_modes_init(&autos); }
+
+    /* Keep the edges between the controls the device has, forget values */
+    void setControls(const QVector<__u32> &ids);
+
+    /* Record the value of a control, returns true when it is an auto mode
+       and the value changed, the flags of its dependents then change */
+    bool setValue(__u32 id, int value);
+
+    bool isMaster(__u32 id) const { return dependents.contains(id); }
+    QList<__u32> dependentsOf(__u32 master) const { return dependents.value(master); }
+
+    /* Set the flags known for well known (UVC) controls, which should
+       really be set by the driver, but older drivers do not */
+    void cleanup(struct v4l2_queryctrl *ctrl) const
+    { ctrl->flags = quirk_flags(ctrl->id, ctrl->flags, &autos); }
+
+private:
+    QHash<__u32, QList<__u32> > dependents;
+    struct auto_modes autos;
+};
+
+#endif
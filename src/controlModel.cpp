@@ -0,0 +1,860 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <cstring>
+#include <libv4l2.h>
+
+#include <QFont>
+#include <QMap>
+
+#include "controlModel.h"
+
+/* Group rows have a null internal id, control rows carry group + 1 */
+#define GROUP_ID 0
+
+static QString className(__u32 cls)
+{
+    switch(cls) {
+        case V4L2_CTRL_CLASS_USER:
+            return "User Controls";
+        case V4L2_CTRL_CLASS_CAMERA:
+            return "Camera Controls";
+        default:
+            return QString().sprintf("Controls 0x%08x", cls);
+    }
+}
+
+static bool isSupported(const struct v4l2_queryctrl &ctrl)
+{
+    /* Any payload is shown, as a hex dump when nothing better is known */
+    if(ctrl.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD)
+        return true;
+    switch(ctrl.type) {
+        case V4L2_CTRL_TYPE_INTEGER:
+        case V4L2_CTRL_TYPE_BOOLEAN:
+        case V4L2_CTRL_TYPE_MENU:
+        case V4L2_CTRL_TYPE_BUTTON:
+        case V4L2_CTRL_TYPE_INTEGER64:
+        case V4L2_CTRL_TYPE_BITMASK:
+        case V4L2_CTRL_TYPE_INTEGER_MENU:
+            return true;
+        default:
+            return false;
+    }
+}
+
+V4L2ControlModel::V4L2ControlModel(V4L2DeviceWorker *worker, QObject *parent) :
+    QAbstractItemModel(parent), worker(worker), pool(NULL), refreshing(false),
+    refreshSeq(0), refreshShown(0), refreshChanged(0), refreshIoctls(0),
+    subscribeSeq(0), subscribed(0)
+{
+    QObject::connect(worker, SIGNAL(results(const QVector<V4L2Result> &)),
+                     this, SLOT(completed(const QVector<V4L2Result> &)));
+}
+
+void V4L2ControlModel::setControls(const QList<V4L2ControlInfo> &infos)
+{
+    int group = -1;
+    __u32 cls = 0;
+    int poolSize = 0;
+
+    beginResetModel();
+    ctrls.clear();
+    groups.clear();
+    byId.clear();
+    ctrls.reserve(infos.size());
+
+    QList<V4L2ControlInfo>::const_iterator it;
+    for(it = infos.begin(); it != infos.end(); it++) {
+        Control c;
+        c.info = *it;
+        c.hwFlags = it->ctrl.flags;
+        c.flags = it->ctrl.flags;
+        c.group = -1;
+        c.row = -1;
+        c.payload = -1;
+        c.busy = 0;
+        c.dirty = false;
+        if(it->hasPayload() && !(it->ctrl.flags & V4L2_CTRL_FLAG_DISABLED)) {
+            c.payload = poolSize;
+            poolSize += 2 * it->payloadSize();
+        }
+        byId.insert(it->ctrl.id, ctrls.size());
+        ctrls.append(c);
+
+        if(it->ctrl.flags & V4L2_CTRL_FLAG_DISABLED)
+            continue;
+
+        __u32 ctrlClass = V4L2_CTRL_ID2CLASS(it->ctrl.id);
+        if(it->ctrl.type == V4L2_CTRL_TYPE_CTRL_CLASS || group < 0 ||
+           ctrlClass != cls) {
+            Group g;
+            if(it->ctrl.type == V4L2_CTRL_TYPE_CTRL_CLASS)
+                g.name = (const char *)it->ctrl.name;
+            else
+                g.name = className(ctrlClass);
+            groups.append(g);
+            group = groups.size() - 1;
+            cls = ctrlClass;
+            if(it->ctrl.type == V4L2_CTRL_TYPE_CTRL_CLASS)
+                continue;
+        }
+
+        Control &last = ctrls.last();
+        last.group = group;
+        last.row = groups[group].members.size();
+        groups[group].members.append(ctrls.size() - 1);
+    }
+
+    /* One block for all the payloads, edits and reads only copy */
+    pool = poolSize ? worker->allocPayloads(poolSize) : NULL;
+
+    /* The flags fixed up by the graph depend on the auto controls */
+    QVector<__u32> ids;
+    ids.reserve(ctrls.size());
+    for(int i = 0; i < ctrls.size(); i++)
+        ids.append(ctrls[i].info.ctrl.id);
+    graph.setControls(ids);
+    for(int i = 0; i < ctrls.size(); i++)
+        graph.setValue(ctrls[i].info.ctrl.id, ctrls[i].info.value);
+    for(int i = 0; i < ctrls.size(); i++) {
+        struct v4l2_queryctrl ctrl = ctrls[i].info.ctrl;
+        graph.cleanup(&ctrl);
+        ctrls[i].flags = ctrl.flags;
+    }
+    endResetModel();
+}
+
+/* The descriptors as given to setControls(), with the current values */
+QList<V4L2ControlInfo> V4L2ControlModel::controlInfos() const
+{
+    QList<V4L2ControlInfo> infos;
+    QVector<Control>::const_iterator it;
+    for(it = ctrls.begin(); it != ctrls.end(); it++)
+        infos.append(it->info);
+    return infos;
+}
+
+QModelIndex V4L2ControlModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if(column < 0 || column >= ColumnCount || row < 0)
+        return QModelIndex();
+
+    if(!parent.isValid()) {
+        if(row >= groups.size())
+            return QModelIndex();
+        return createIndex(row, column, quintptr(GROUP_ID));
+    }
+
+    if(parent.internalId() != GROUP_ID || row >= groups[parent.row()].members.size())
+        return QModelIndex();
+    return createIndex(row, column, quintptr(parent.row() + 1));
+}
+
+QModelIndex V4L2ControlModel::parent(const QModelIndex &child) const
+{
+    if(!child.isValid() || child.internalId() == GROUP_ID)
+        return QModelIndex();
+    return createIndex(child.internalId() - 1, 0, quintptr(GROUP_ID));
+}
+
+int V4L2ControlModel::rowCount(const QModelIndex &parent) const
+{
+    if(!parent.isValid())
+        return groups.size();
+    if(parent.internalId() == GROUP_ID && parent.column() == 0)
+        return groups[parent.row()].members.size();
+    return 0;
+}
+
+int V4L2ControlModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+int V4L2ControlModel::control(const QModelIndex &index) const
+{
+    if(!index.isValid() || index.internalId() == GROUP_ID)
+        return -1;
+    return groups[index.internalId() - 1].members[index.row()];
+}
+
+QModelIndex V4L2ControlModel::indexOf(int c, int column) const
+{
+    if(ctrls[c].group < 0)
+        return QModelIndex();
+    return createIndex(ctrls[c].row, column, quintptr(ctrls[c].group + 1));
+}
+
+QVariant V4L2ControlModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid())
+        return QVariant();
+
+    if(index.internalId() == GROUP_ID) {
+        if(index.column() != NameColumn)
+            return QVariant();
+        if(role == Qt::DisplayRole)
+            return groups[index.row()].name;
+        if(role == Qt::FontRole) {
+            QFont font;
+            font.setBold(true);
+            return font;
+        }
+        return QVariant();
+    }
+
+    int c = control(index);
+    const V4L2ControlInfo &info = ctrls[c].info;
+    if(role == Qt::EditRole && index.column() == ValueColumn)
+        return value64(c);
+    if(role != Qt::DisplayRole)
+        return QVariant();
+
+    switch(index.column()) {
+        case NameColumn:
+            return QString((const char *)info.ctrl.name);
+        case ValueColumn:
+            if(!isSupported(info.ctrl))
+                return QString("Unknown control");
+            if(info.hasPayload()) {
+                if(ctrls[c].payload < 0)
+                    return QVariant();
+                if(info.ext.type == V4L2_CTRL_TYPE_STRING && !info.ext.nr_of_dims)
+                    return QString::fromUtf8(payload(c), qstrnlen(payload(c), info.ext.elem_size));
+                return QString().sprintf("%u x %u bytes", info.ext.elems, info.ext.elem_size);
+            }
+            if(info.ctrl.type == V4L2_CTRL_TYPE_MENU ||
+               info.ctrl.type == V4L2_CTRL_TYPE_INTEGER_MENU) {
+                int item = info.value - info.ctrl.minimum;
+                if(item >= 0 && item < info.menu.size())
+                    return info.menu[item];
+            }
+            if(info.ctrl.type == V4L2_CTRL_TYPE_BITMASK)
+                return QString().sprintf("0x%08x", (__u32)info.value);
+            if(info.ctrl.type == V4L2_CTRL_TYPE_BUTTON)
+                return QVariant();
+            return value64(c);
+        case UpdateColumn:
+            if(!isSupported(info.ctrl))
+                return QVariant();
+            return QString("Update");
+        case ResetColumn:
+            if(!isResettable(c))
+                return QVariant();
+            return QString("Reset");
+    }
+    return QVariant();
+}
+
+bool V4L2ControlModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    int c = control(index);
+    if(c < 0 || index.column() != ValueColumn || role != Qt::EditRole)
+        return false;
+    return writeValue(c, value.toLongLong());
+}
+
+Qt::ItemFlags V4L2ControlModel::flags(const QModelIndex &index) const
+{
+    int c = control(index);
+    if(c >= 0 && index.column() == ValueColumn && isSupported(ctrls[c].info.ctrl) &&
+       isEnabled(c))
+        return Qt::ItemIsEnabled | Qt::ItemIsEditable;
+    return Qt::ItemIsEnabled;
+}
+
+QVariant V4L2ControlModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch(section) {
+        case NameColumn:
+            return QString("Control");
+        case ValueColumn:
+            return QString("Value");
+    }
+    return QVariant();
+}
+
+bool V4L2ControlModel::isEnabled(int c) const
+{
+    return !(ctrls[c].flags & (V4L2_CTRL_FLAG_GRABBED|V4L2_CTRL_FLAG_READ_ONLY|V4L2_CTRL_FLAG_INACTIVE));
+}
+
+bool V4L2ControlModel::isReadable(int c) const
+{
+    const struct v4l2_queryctrl &ctrl = ctrls[c].info.ctrl;
+    if(!isSupported(ctrl) || ctrl.type == V4L2_CTRL_TYPE_BUTTON)
+        return false;
+#ifdef V4L2_CTRL_FLAG_WRITE_ONLY
+    if(ctrls[c].flags & V4L2_CTRL_FLAG_WRITE_ONLY)
+        return false;
+#endif
+    return true;
+}
+
+void V4L2ControlModel::valueChanged(int c)
+{
+    QModelIndex index = indexOf(c, ValueColumn);
+    if(index.isValid())
+        emit dataChanged(index, index);
+}
+
+qint64 V4L2ControlModel::value64(int c) const
+{
+    const V4L2ControlInfo &info = ctrls[c].info;
+    return info.ctrl.type == V4L2_CTRL_TYPE_INTEGER64 ? info.value64 : info.value;
+}
+
+const char *V4L2ControlModel::payload(int c) const
+{
+    return ctrls[c].payload >= 0 ? pool + ctrls[c].payload : NULL;
+}
+
+/* Queue the write, the value is shown right away and corrected by the
+   read back which follows it */
+bool V4L2ControlModel::writeValue(int c, qint64 val)
+{
+    if(ctrls[c].payload >= 0)
+        return false;
+    submitSet(c, val);
+    applyValue(c, val);
+    updateStatus(c, true);
+    return true;
+}
+
+/* Like resetAll(), all the writes are queued before the read backs,
+   which writeValue() would put between them */
+int V4L2ControlModel::writeValues(const __u32 *ids, const __s32 *values, int n)
+{
+    QVector<int> written;
+
+    for(int i = 0; i < n; i++) {
+        int c = controlById(ids[i]);
+        if(c < 0 || ctrls[c].payload >= 0)
+            continue;
+        submitSet(c, values[i]);
+        applyValue(c, values[i]);
+        written.append(c);
+    }
+
+    for(int i = 0; i < written.size(); i++)
+        worker->submit(V4L2Request::Query, ctrls[written[i]].info.ctrl.id);
+    for(int i = 0; i < written.size(); i++) {
+        if(isReadable(written[i]))
+            submitGet(written[i]);
+    }
+    for(int i = 0; i < written.size(); i++) {
+        if(isMaster(written[i]))
+            queryDependents(written[i]);
+    }
+    return written.size();
+}
+
+bool V4L2ControlModel::writePayload(int c, int offset, const void *data, int size)
+{
+    Control &ctl = ctrls[c];
+    if(ctl.payload < 0 || offset < 0 || size < 0 || offset + size > ctl.info.payloadSize())
+        return false;
+
+    memcpy(pool + ctl.payload + offset, data, size);
+    valueChanged(c);
+    if(ctl.busy)
+        ctl.dirty = true;
+    else
+        submitPayload(c);
+    return true;
+}
+
+/* Copy the payload to the transfer buffer and write it, then read it
+   back. Only called while no request of c is in flight. */
+void V4L2ControlModel::submitPayload(int c)
+{
+    Control &ctl = ctrls[c];
+    int size = ctl.info.payloadSize();
+    char *shown = pool + ctl.payload;
+
+    memcpy(shown + size, shown, size);
+    ctl.dirty = false;
+    ctl.busy++;
+    worker->submitPayload(V4L2Request::Set, ctl.info.ctrl.id, shown + size, size);
+    updateStatus(c, true);
+}
+
+/* Queue a read of c, in the form its type needs */
+quint32 V4L2ControlModel::submitGet(int c)
+{
+    Control &ctl = ctrls[c];
+    __u32 id = ctl.info.ctrl.id;
+
+    if(ctl.payload >= 0) {
+        int size = ctl.info.payloadSize();
+        ctl.busy++;
+        return worker->submitPayload(V4L2Request::Get, id, pool + ctl.payload + size, size);
+    }
+    if(ctl.info.ctrl.type == V4L2_CTRL_TYPE_INTEGER64)
+        return worker->submit64(V4L2Request::Get, id);
+    return worker->submit(V4L2Request::Get, id);
+}
+
+quint32 V4L2ControlModel::submitSet(int c, qint64 val)
+{
+    __u32 id = ctrls[c].info.ctrl.id;
+    if(ctrls[c].info.ctrl.type == V4L2_CTRL_TYPE_INTEGER64)
+        return worker->submit64(V4L2Request::Set, id, val);
+    return worker->submit(V4L2Request::Set, id, val);
+}
+
+void V4L2ControlModel::updateStatus(int c, bool hwChanged)
+{
+    worker->submit(V4L2Request::Query, ctrls[c].info.ctrl.id);
+    if(isReadable(c))
+        submitGet(c);
+
+    /* Other controls may have been (de)activated */
+    if(hwChanged && isMaster(c))
+        queryDependents(c);
+}
+
+/* Payloads have no default the driver tells about */
+bool V4L2ControlModel::isResettable(int c) const
+{
+    const V4L2ControlInfo &info = ctrls[c].info;
+    return isSupported(info.ctrl) && info.ctrl.type != V4L2_CTRL_TYPE_BUTTON &&
+           !info.hasPayload();
+}
+
+qint64 V4L2ControlModel::defaultValue(int c) const
+{
+    const V4L2ControlInfo &info = ctrls[c].info;
+    if(info.ctrl.type == V4L2_CTRL_TYPE_INTEGER64)
+        return info.ext.default_value;
+    return info.ctrl.default_value;
+}
+
+void V4L2ControlModel::resetToDefault(int c)
+{
+    if(isResettable(c) && isEnabled(c))
+        writeValue(c, defaultValue(c));
+}
+
+/* Write every default at once. The auto modes go first, as they decide
+   which of the other controls are still enabled, and each pass is queued
+   in control order so the worker merges it into one VIDIOC_S_EXT_CTRLS
+   per control class. The flags of the controls gated by a written auto
+   mode and all the values are read back after the last write, by one
+   refresh. */
+void V4L2ControlModel::resetAll()
+{
+    QVector<int> masters;
+
+    for(int pass = 0; pass < 2; pass++) {
+        for(int c = 0; c < ctrls.size(); c++) {
+            if(ctrls[c].group < 0 || isMaster(c) != (pass == 0) ||
+               !isResettable(c) || !isEnabled(c))
+                continue;
+            submitSet(c, defaultValue(c));
+            applyValue(c, defaultValue(c));
+            if(pass == 0)
+                masters.append(c);
+        }
+    }
+
+    QVector<bool> query(ctrls.size(), false);
+    for(int i = 0; i < masters.size(); i++) {
+        QVector<int> deps = dependents(masters[i]);
+        for(int k = 0; k < deps.size(); k++)
+            query[deps[k]] = true;
+    }
+    for(int c = 0; c < ctrls.size(); c++) {
+        if(query[c])
+            worker->submit(V4L2Request::Query, ctrls[c].info.ctrl.id);
+    }
+
+    refresh();
+}
+
+/* Queue a flags query for every shown control, returns the last seq */
+quint32 V4L2ControlModel::queryAllStatus()
+{
+    quint32 last = 0;
+    for(int c = 0; c < ctrls.size(); c++) {
+        if(ctrls[c].group >= 0)
+            last = worker->submit(V4L2Request::Query, ctrls[c].info.ctrl.id);
+    }
+    return last;
+}
+
+/* The shown controls gated by c. An auto mode the graph does not know
+   about, only flagged by the driver, gates its whole control class. */
+QVector<int> V4L2ControlModel::dependents(int c) const
+{
+    __u32 id = ctrls[c].info.ctrl.id;
+    QVector<int> deps;
+
+    if(!graph.isMaster(id)) {
+        for(int d = 0; d < ctrls.size(); d++) {
+            if(d != c && ctrls[d].group >= 0 &&
+               V4L2_CTRL_ID2CLASS(ctrls[d].info.ctrl.id) == V4L2_CTRL_ID2CLASS(id))
+                deps.append(d);
+        }
+        return deps;
+    }
+
+    QList<__u32> ids = graph.dependentsOf(id);
+    QList<__u32>::const_iterator it;
+    for(it = ids.begin(); it != ids.end(); it++) {
+        int d = controlById(*it);
+        if(d >= 0 && ctrls[d].group >= 0)
+            deps.append(d);
+    }
+    return deps;
+}
+
+/* Queue a flags query and a read for the controls gated by c, returns
+   the last seq */
+quint32 V4L2ControlModel::queryDependents(int c)
+{
+    QVector<int> deps = dependents(c);
+    quint32 last = 0;
+
+    /* Reads of one class in a row are merged by the worker */
+    for(int i = 0; i < deps.size(); i++)
+        last = worker->submit(V4L2Request::Query, ctrls[deps[i]].info.ctrl.id);
+    for(int i = 0; i < deps.size(); i++) {
+        if(isReadable(deps[i]))
+            last = submitGet(deps[i]);
+    }
+    return last;
+}
+
+/* Recompute the effective flags from the cached driver flags, no ioctl */
+void V4L2ControlModel::applyStatus(int c)
+{
+    struct v4l2_queryctrl ctrl = ctrls[c].info.ctrl;
+    ctrl.flags = ctrls[c].hwFlags;
+    graph.cleanup(&ctrl);
+
+    bool wasEnabled = isEnabled(c);
+    ctrls[c].flags = ctrl.flags;
+    if(wasEnabled != isEnabled(c)) {
+        QModelIndex first = indexOf(c, NameColumn), last = indexOf(c, ResetColumn);
+        if(first.isValid())
+            emit dataChanged(first, last);
+    }
+}
+
+void V4L2ControlModel::setDriverFlags(__u32 id, __u32 flags)
+{
+    int c = controlById(id);
+    if(c >= 0) {
+        ctrls[c].hwFlags = flags;
+        applyStatus(c);
+    }
+}
+
+/* Returns true when the value differs from what we had. The flags the
+   graph adds to the controls gated by an auto mode follow right away. */
+bool V4L2ControlModel::applyValue(int c, qint64 val)
+{
+    if(ctrls[c].info.ctrl.type == V4L2_CTRL_TYPE_INTEGER64) {
+        if(val == ctrls[c].info.value64)
+            return false;
+        ctrls[c].info.value64 = val;
+        valueChanged(c);
+        return true;
+    }
+
+    int v = val;
+    if(graph.setValue(ctrls[c].info.ctrl.id, v)) {
+        QList<__u32> deps = graph.dependentsOf(ctrls[c].info.ctrl.id);
+        QList<__u32>::const_iterator it;
+        for(it = deps.begin(); it != deps.end(); it++) {
+            int d = controlById(*it);
+            if(d >= 0)
+                applyStatus(d);
+        }
+    }
+    if(v == ctrls[c].info.value)
+        return false;
+    ctrls[c].info.value = v;
+    valueChanged(c);
+    return true;
+}
+
+/* Take the payload the worker read, unless it was edited in the meantime
+   or more requests are still to come. Returns true when it differs. */
+bool V4L2ControlModel::applyPayload(int c)
+{
+    Control &ctl = ctrls[c];
+    int size = ctl.info.payloadSize();
+    char *shown = pool + ctl.payload;
+
+    if(ctl.busy || ctl.dirty || !memcmp(shown, shown + size, size))
+        return false;
+    memcpy(shown, shown + size, size);
+    valueChanged(c);
+    return true;
+}
+
+/* Drivers without control events fail every subscription, the count
+   eventsSubscribed() reports is 0 then */
+void V4L2ControlModel::subscribeEvents()
+{
+    subscribed = 0;
+    subscribeSeq = 0;
+    for(int c = 0; c < ctrls.size(); c++) {
+        const struct v4l2_queryctrl &ctrl = ctrls[c].info.ctrl;
+        if(ctrl.type == V4L2_CTRL_TYPE_CTRL_CLASS ||
+           (ctrl.flags & V4L2_CTRL_FLAG_DISABLED))
+            continue;
+        subscribeSeq = worker->submit(V4L2Request::Subscribe, ctrl.id);
+    }
+    if(!subscribeSeq)
+        emit eventsSubscribed(0);
+}
+
+void V4L2ControlModel::dequeueEvents()
+{
+    worker->submit(V4L2Request::DequeueEvents, 0);
+}
+
+/* Apply a V4L2_EVENT_CTRL notification. The driver reports its own flag
+   changes, the ones the graph adds follow the value of the auto modes. */
+void V4L2ControlModel::applyEvent(const struct v4l2_event_ctrl &ev, __u32 id)
+{
+    int c = controlById(id);
+    if(c < 0)
+        return;
+
+    if(ev.changes & V4L2_EVENT_CTRL_CH_RANGE) {
+        struct v4l2_queryctrl &ctrl = ctrls[c].info.ctrl;
+        ctrl.minimum = ev.minimum;
+        ctrl.maximum = ev.maximum;
+        ctrl.step = ev.step;
+        ctrl.default_value = ev.default_value;
+        /* The event only has 32 bit fields */
+        if(ctrl.type != V4L2_CTRL_TYPE_INTEGER64) {
+            struct v4l2_query_ext_ctrl &ext = ctrls[c].info.ext;
+            ext.minimum = ev.minimum;
+            ext.maximum = ev.maximum;
+            ext.step = ev.step;
+            ext.default_value = ev.default_value;
+        }
+        /* The items follow once the worker has read them */
+        if(ctrl.type == V4L2_CTRL_TYPE_MENU || ctrl.type == V4L2_CTRL_TYPE_INTEGER_MENU)
+            worker->submit(V4L2Request::QueryMenu, ctrl.id);
+        valueChanged(c);
+    }
+
+    if(ev.changes & V4L2_EVENT_CTRL_CH_FLAGS) {
+        ctrls[c].hwFlags = ev.flags;
+        applyStatus(c);
+    }
+
+    /* Events carry no payload, it has to be read */
+    if((ev.changes & V4L2_EVENT_CTRL_CH_VALUE) && isReadable(c)) {
+        if(ctrls[c].payload >= 0)
+            submitGet(c);
+        else if(ctrls[c].info.ctrl.type == V4L2_CTRL_TYPE_INTEGER64)
+            applyValue(c, ev.value64);
+        else
+            applyValue(c, ev.value);
+    }
+}
+
+/* Read back the state of every control on the device. The reads are
+   queued in control order, so the worker fetches the values with one
+   VIDIOC_G_EXT_CTRLS per control class. Flags are only queried again when
+   asked to or when a control which affects others (an auto mode) has
+   changed, and only rows whose state differs get repainted. refreshed()
+   is emitted once the last result is in. */
+void V4L2ControlModel::refresh(bool requeryFlags)
+{
+    quint32 last = 0;
+    int shown = 0;
+
+    for(int c = 0; c < ctrls.size(); c++) {
+        if(ctrls[c].group < 0)
+            continue;
+        shown++;
+        if(isReadable(c))
+            last = submitGet(c);
+    }
+
+    if(requeryFlags) {
+        quint32 seq = queryAllStatus();
+        if(seq)
+            last = seq;
+    } else {
+        for(int c = 0; c < ctrls.size(); c++) {
+            if(ctrls[c].group >= 0)
+                applyStatus(c);
+        }
+    }
+
+    if(!last) {
+        emit refreshed(shown, 0, 0);
+        return;
+    }
+    /* A refresh asked for while one is running extends it */
+    if(!refreshing) {
+        refreshing = true;
+        refreshChanged = 0;
+        refreshIoctls = 0;
+    }
+    refreshShown = shown;
+    refreshSeq = last;
+}
+
+void V4L2ControlModel::completed(const QVector<V4L2Result> &res)
+{
+    QVector<int> masters;
+    QVector<__u32> written;
+    QStringList errors;
+    bool done = false;
+    bool subscribeDone = false;
+    bool dequeued = false;
+
+    QVector<V4L2Result>::const_iterator r;
+    for(r = res.begin(); r != res.end(); r++) {
+        if(refreshing) {
+            refreshIoctls += r->ioctls;
+            if(r->seq == refreshSeq)
+                done = true;
+        }
+
+        QString msg;
+        if(r->type == V4L2Request::Subscribe) {
+            if(!r->error)
+                subscribed++;
+            if(r->seq == subscribeSeq)
+                subscribeDone = true;
+            continue;
+        }
+        if(r->type == V4L2Request::DequeueEvents) {
+            if(r->id) {
+                applyEvent(r->event, r->id);
+            } else {
+                if(r->error) {
+                    msg.sprintf("Unable to get the control events: %s", strerror(r->error));
+                    errors.append(msg);
+                }
+                dequeued = true;
+            }
+            continue;
+        }
+
+        int c = controlById(r->id);
+        if(c < 0)
+            continue;
+
+        /* Results from before setControls() were not counted */
+        bool payload = ctrls[c].payload >= 0 &&
+                       (r->type == V4L2Request::Get || r->type == V4L2Request::Set);
+        if(payload && ctrls[c].busy)
+            ctrls[c].busy--;
+
+        switch(r->type) {
+            case V4L2Request::Get:
+                if(r->error) {
+                    msg.sprintf("Unable to get %s: %s", ctrls[c].info.ctrl.name,
+                                strerror(r->error));
+                    errors.append(msg);
+                } else if(payload ? applyPayload(c) : applyValue(c, r->value)) {
+                    if(refreshing)
+                        refreshChanged++;
+                    if(isMaster(c))
+                        masters.append(c);
+                }
+                break;
+            case V4L2Request::Query:
+                if(r->error) {
+                    msg.sprintf("Unable to get the status of %s: %s",
+                                ctrls[c].info.ctrl.name, strerror(r->error));
+                    errors.append(msg);
+                } else {
+                    ctrls[c].hwFlags = r->flags;
+                    applyStatus(c);
+                }
+                break;
+            case V4L2Request::Set:
+                if(r->error) {
+                    msg.sprintf("Unable to set %s: %s", ctrls[c].info.ctrl.name,
+                                strerror(r->error));
+                    errors.append(msg);
+                    /* The read back queued behind the write restores the value */
+                    valueChanged(c);
+                }
+                written.append(r->id);
+                break;
+            case V4L2Request::QueryMenu:
+                if(r->error) {
+                    msg.sprintf("Unable to get the menu of %s: %s", ctrls[c].info.ctrl.name,
+                                strerror(r->error));
+                    errors.append(msg);
+                }
+                if(!r->menu.isEmpty()) {
+                    ctrls[c].info.menu = r->menu;
+                    valueChanged(c);
+                }
+                break;
+        }
+
+        /* The edits made while the payload was on its way */
+        if(payload && !ctrls[c].busy && ctrls[c].dirty)
+            submitPayload(c);
+    }
+
+    /* The controls gated by a changed auto mode follow, a running refresh
+       waits for them */
+    for(int i = 0; i < masters.size(); i++) {
+        quint32 last = queryDependents(masters[i]);
+        if(refreshing && last) {
+            refreshSeq = last;
+            done = false;
+        }
+    }
+
+    if(done) {
+        refreshing = false;
+        emit refreshed(refreshShown, refreshChanged, refreshIoctls);
+    }
+
+    if(subscribeDone)
+        emit eventsSubscribed(subscribed);
+    if(dequeued)
+        emit eventsDequeued();
+
+    /* Editors write their next value from here, after the batch */
+    for(int i = 0; i < written.size(); i++)
+        emit writeDone(written[i]);
+
+    /* Reported after the batch is applied, a modal dialog here would run
+       the event loop in the middle of it and stack one per failure */
+    if(!errors.isEmpty()) {
+        QString msg = errors.first();
+        if(errors.size() > 1)
+            msg += QString(" (and %1 more errors)").arg(errors.size() - 1);
+        emit statusMessage(msg);
+    }
+}
@@ -0,0 +1,162 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef CONTROLMODEL_H
+#define CONTROLMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+
+#include "controlCache.h"
+#include "controlGraph.h"
+#include "deviceWorker.h"
+
+/* The state of every control of a device, kept in one flat array and
+   presented as a two level tree: control classes, then their controls.
+   All ioctls on the controls go through here and are run by the device
+   worker, results are applied when they come back. */
+class V4L2ControlModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        NameColumn,
+        ValueColumn,
+        UpdateColumn,
+        ResetColumn,
+        ColumnCount
+    };
+
+    V4L2ControlModel(V4L2DeviceWorker *worker, QObject *parent = 0);
+
+    void setControls(const QList<V4L2ControlInfo> &infos);
+    QList<V4L2ControlInfo> controlInfos() const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &child) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    /* Controls are addressed by their position in the flat array */
+    int count() const { return ctrls.size(); }
+    int control(const QModelIndex &index) const;
+    int controlById(__u32 id) const { return byId.value(id, -1); }
+    QModelIndex indexOf(int c, int column) const;
+    const V4L2ControlInfo &info(int c) const { return ctrls[c].info; }
+    int value(int c) const { return ctrls[c].info.value; }
+    qint64 value64(int c) const;
+    /* The payload of a string, array or compound control, NULL for the
+       others. It stays valid until the next setControls(). */
+    const char *payload(int c) const;
+    bool isEnabled(int c) const;
+    bool isReadable(int c) const;
+    bool isMaster(int c) const { return ctrls[c].flags & V4L2_CTRL_FLAG_UPDATE; }
+
+    bool writeValue(int c, qint64 val);
+    /* Several controls at once, the writes of one class given in a row
+       go out as one VIDIOC_S_EXT_CTRLS. Returns how many were written. */
+    int writeValues(const __u32 *ids, const __s32 *values, int n);
+    /* Change size bytes of the payload at offset and write all of it. An
+       edit made while the previous one is still on its way only marks the
+       payload, it is written once that one is done. */
+    bool writePayload(int c, int offset, const void *data, int size);
+    void updateStatus(int c, bool hwChanged = false);
+    void resetToDefault(int c);
+    void setDriverFlags(__u32 id, __u32 flags);
+    /* Subscribe to the control events of every control, see
+       eventsSubscribed() */
+    void subscribeEvents();
+    /* Read and apply the pending events, see eventsDequeued() */
+    void dequeueEvents();
+
+public slots:
+    void refresh(bool requeryFlags = false);
+    void resetAll();
+
+signals:
+    void refreshed(int controls, int changed, int ioctls);
+    /* The requests which failed in one batch of results, for the status
+       bar rather than a dialog per request */
+    void statusMessage(const QString &msg);
+    /* The result of a write of control id is in, an editor holds back
+       its next value until then */
+    void writeDone(__u32 id);
+    /* The number of controls the driver sends events for */
+    void eventsSubscribed(int count);
+    void eventsDequeued();
+
+private slots:
+    void completed(const QVector<V4L2Result> &res);
+
+private:
+    struct Control {
+        V4L2ControlInfo info;
+        __u32 hwFlags;      /* as last reported by the driver */
+        __u32 flags;        /* after V4L2ControlGraph::cleanup() */
+        int group;
+        int row;
+        int payload;        /* offset in pool, -1 without one */
+        int busy;           /* payload requests in flight */
+        bool dirty;         /* payload edited while busy */
+    };
+    struct Group {
+        QString name;
+        QVector<int> members;
+    };
+
+    V4L2DeviceWorker *worker;
+    QVector<Control> ctrls;
+    QVector<Group> groups;
+    QHash<__u32, int> byId;
+    V4L2ControlGraph graph;
+    /* Each payload is followed by the copy the worker reads or writes */
+    char *pool;
+
+    /* A refresh is done once the result of its last request is in */
+    bool refreshing;
+    quint32 refreshSeq;
+    int refreshShown;
+    int refreshChanged;
+    int refreshIoctls;
+
+    quint32 subscribeSeq;
+    int subscribed;
+
+    quint32 queryAllStatus();
+    QVector<int> dependents(int c) const;
+    quint32 queryDependents(int c);
+    void applyStatus(int c);
+    void applyEvent(const struct v4l2_event_ctrl &ev, __u32 id);
+    bool applyValue(int c, qint64 val);
+    bool applyPayload(int c);
+    bool isResettable(int c) const;
+    qint64 defaultValue(int c) const;
+    quint32 submitGet(int c);
+    quint32 submitSet(int c, qint64 val);
+    void submitPayload(int c);
+    void valueChanged(int c);
+};
+
+#endif
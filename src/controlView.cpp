@@ -0,0 +1,246 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <QApplication>
+#include <QHeaderView>
+#include <QLineEdit>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QStyleOptionButton>
+#include <QTimer>
+
+#include "controlModel.h"
+#include "controlView.h"
+#include "v4l2controls.h"
+
+/*
+ * V4L2ControlDelegate
+ */
+V4L2ControlDelegate::V4L2ControlDelegate(QObject *parent) :
+    QStyledItemDelegate(parent)
+{
+    /* Rows must fit a slider and its line edit */
+    QLineEdit le;
+    rowHeight = le.sizeHint().height() + 2;
+}
+
+QWidget *V4L2ControlDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem &,
+                                           const QModelIndex &index) const
+{
+    const V4L2ControlModel *model = qobject_cast<const V4L2ControlModel *>(index.model());
+    int c = model->control(index);
+    if(c < 0 || index.column() != V4L2ControlModel::ValueColumn)
+        return NULL;
+
+    V4L2Control *editor = V4L2Control::create(model->info(c), parent);
+    if(editor) {
+        editor->setAutoFillBackground(true);
+        QObject::connect(editor, SIGNAL(valueEdited()), this, SLOT(commitEditor()));
+        QObject::connect(editor, SIGNAL(statusMessage(const QString &)),
+                         this, SIGNAL(statusMessage(const QString &)));
+        QObject::connect(model, SIGNAL(writeDone(__u32)), editor, SLOT(writeDone(__u32)));
+    }
+    return editor;
+}
+
+void V4L2ControlDelegate::setEditorData(QWidget *editor, const QModelIndex &index) const
+{
+    const V4L2ControlModel *model = qobject_cast<const V4L2ControlModel *>(index.model());
+    V4L2Control *w = qobject_cast<V4L2Control *>(editor);
+    int c = model->control(index);
+    if(!w || c < 0)
+        return;
+
+    w->setInfo(model->info(c));
+    if(!w->isEditing()) {
+        if(model->payload(c))
+            w->setPayload(model->payload(c));
+        else if(w->getValue64() != model->value64(c))
+            w->setValue64(model->value64(c));
+    }
+    if(w->isEnabled() != model->isEnabled(c))
+        w->setEnabled(model->isEnabled(c));
+}
+
+void V4L2ControlDelegate::setModelData(QWidget *editor, QAbstractItemModel *model,
+                                       const QModelIndex &index) const
+{
+    V4L2ControlModel *m = qobject_cast<V4L2ControlModel *>(model);
+    V4L2Control *w = qobject_cast<V4L2Control *>(editor);
+    int c = m->control(index);
+    if(!w || c < 0)
+        return;
+
+    /* A payload edit is a few bytes of a buffer the model already has */
+    if(m->payload(c)) {
+        QByteArray data;
+        int offset;
+        if(w->takeEdit(offset, data))
+            m->writePayload(c, offset, data.constData(), data.size());
+        return;
+    }
+    model->setData(index, w->getValue64());
+}
+
+void V4L2ControlDelegate::updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option,
+                                               const QModelIndex &) const
+{
+    editor->setGeometry(option.rect);
+}
+
+void V4L2ControlDelegate::commitEditor()
+{
+    emit commitData(qobject_cast<QWidget *>(sender()));
+}
+
+void V4L2ControlDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                const QModelIndex &index) const
+{
+    if((index.column() != V4L2ControlModel::UpdateColumn &&
+        index.column() != V4L2ControlModel::ResetColumn) ||
+       index.data().isNull()) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    /* Buttons are only drawn, a widget per row would defeat the purpose */
+    QStyleOptionButton button;
+    button.rect = option.rect.adjusted(1, 1, -1, -1);
+    button.text = index.data().toString();
+    button.state = QStyle::State_Enabled | QStyle::State_Raised;
+    QApplication::style()->drawControl(QStyle::CE_PushButton, &button, painter);
+}
+
+QSize V4L2ControlDelegate::sizeHint(const QStyleOptionViewItem &option,
+                                    const QModelIndex &index) const
+{
+    QSize size = QStyledItemDelegate::sizeHint(option, index);
+    if(size.height() < rowHeight)
+        size.setHeight(rowHeight);
+    if(index.column() == V4L2ControlModel::UpdateColumn ||
+       index.column() == V4L2ControlModel::ResetColumn)
+        size.setWidth(size.width() + 16);
+    return size;
+}
+
+bool V4L2ControlDelegate::editorEvent(QEvent *event, QAbstractItemModel *model,
+                                      const QStyleOptionViewItem &option,
+                                      const QModelIndex &index)
+{
+    V4L2ControlModel *m = qobject_cast<V4L2ControlModel *>(model);
+    if(event->type() != QEvent::MouseButtonRelease || index.data().isNull() ||
+       !option.rect.contains(((QMouseEvent *)event)->pos()))
+        return QStyledItemDelegate::editorEvent(event, model, option, index);
+
+    int c = m->control(index);
+    if(c < 0)
+        return false;
+    switch(index.column()) {
+        case V4L2ControlModel::UpdateColumn:
+            m->updateStatus(c);
+            return true;
+        case V4L2ControlModel::ResetColumn:
+            m->resetToDefault(c);
+            return true;
+    }
+    return QStyledItemDelegate::editorEvent(event, model, option, index);
+}
+
+/*
+ * V4L2ControlView
+ */
+V4L2ControlView::V4L2ControlView(QWidget *parent) :
+    QTreeView(parent)
+{
+    V4L2ControlDelegate *delegate = new V4L2ControlDelegate(this);
+    setItemDelegate(delegate);
+    QObject::connect(delegate, SIGNAL(statusMessage(const QString &)),
+                     this, SIGNAL(statusMessage(const QString &)));
+    setUniformRowHeights(true);
+    setSelectionMode(QAbstractItemView::NoSelection);
+    setEditTriggers(QAbstractItemView::NoEditTriggers);
+    setRootIsDecorated(true);
+    header()->setStretchLastSection(false);
+
+    QObject::connect(this, SIGNAL(expanded(const QModelIndex &)),
+                     this, SLOT(updateEditors()));
+    QObject::connect(this, SIGNAL(collapsed(const QModelIndex &)),
+                     this, SLOT(updateEditors()));
+}
+
+void V4L2ControlView::setModel(QAbstractItemModel *model)
+{
+    QTreeView::setModel(model);
+    header()->setSectionResizeMode(V4L2ControlModel::NameColumn, QHeaderView::ResizeToContents);
+    header()->setSectionResizeMode(V4L2ControlModel::ValueColumn, QHeaderView::Stretch);
+    header()->setSectionResizeMode(V4L2ControlModel::UpdateColumn, QHeaderView::ResizeToContents);
+    header()->setSectionResizeMode(V4L2ControlModel::ResetColumn, QHeaderView::ResizeToContents);
+    QObject::connect(model, SIGNAL(modelReset()), this, SLOT(modelReset()));
+    modelReset();
+}
+
+void V4L2ControlView::modelReset()
+{
+    /* The editors went away with the old rows */
+    editors.clear();
+    for(int i = 0; i < model()->rowCount(); i++)
+        setFirstColumnSpanned(i, QModelIndex(), true);
+    expandAll();
+    QTimer::singleShot(0, this, SLOT(updateEditors()));
+}
+
+void V4L2ControlView::resizeEvent(QResizeEvent *event)
+{
+    QTreeView::resizeEvent(event);
+    updateEditors();
+}
+
+void V4L2ControlView::scrollContentsBy(int dx, int dy)
+{
+    QTreeView::scrollContentsBy(dx, dy);
+    updateEditors();
+}
+
+/* Open editors for the control rows on screen, close all the others */
+void V4L2ControlView::updateEditors()
+{
+    QList<QPersistentModelIndex> visible;
+    int height = viewport()->height();
+
+    if(!model())
+        return;
+
+    QModelIndex index = indexAt(QPoint(0, 0));
+    while(index.isValid() && visualRect(index).top() < height) {
+        if(index.parent().isValid())
+            visible.append(index.sibling(index.row(), V4L2ControlModel::ValueColumn));
+        index = indexBelow(index);
+    }
+
+    QList<QPersistentModelIndex>::iterator it;
+    for(it = editors.begin(); it != editors.end(); it++) {
+        if(!visible.contains(*it))
+            closePersistentEditor(*it);
+    }
+    for(it = visible.begin(); it != visible.end(); it++) {
+        if(!editors.contains(*it))
+            openPersistentEditor(*it);
+    }
+    editors = visible;
+}
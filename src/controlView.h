@@ -0,0 +1,86 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef CONTROLVIEW_H
+#define CONTROLVIEW_H
+
+#include <QList>
+#include <QPersistentModelIndex>
+#include <QStyledItemDelegate>
+#include <QTreeView>
+
+/* Creates the V4L2Control editors and draws the Update/Reset buttons */
+class V4L2ControlDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    V4L2ControlDelegate(QObject *parent = 0);
+
+    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option,
+                          const QModelIndex &index) const;
+    void setEditorData(QWidget *editor, const QModelIndex &index) const;
+    void setModelData(QWidget *editor, QAbstractItemModel *model,
+                      const QModelIndex &index) const;
+    void updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option,
+                              const QModelIndex &index) const;
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+signals:
+    void statusMessage(const QString &msg);
+
+protected:
+    bool editorEvent(QEvent *event, QAbstractItemModel *model,
+                     const QStyleOptionViewItem &option, const QModelIndex &index);
+
+private slots:
+    void commitEditor();
+
+private:
+    int rowHeight;
+};
+
+/* Tree of controls which only keeps editors for the rows on screen, so
+   that devices with hundreds of controls stay cheap to show */
+class V4L2ControlView : public QTreeView
+{
+    Q_OBJECT
+
+public:
+    V4L2ControlView(QWidget *parent = 0);
+    void setModel(QAbstractItemModel *model);
+
+signals:
+    void statusMessage(const QString &msg);
+
+protected:
+    void resizeEvent(QResizeEvent *event);
+    void scrollContentsBy(int dx, int dy);
+
+private slots:
+    void modelReset();
+    void updateEditors();
+
+private:
+    QList<QPersistentModelIndex> editors;
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <cstring>
+#include <libv4l2.h>
+
+#include <QElapsedTimer>
+#include <QThreadPool>
+
+#include "deviceProbe.h"
+#include "v4l2core.h"
+#include "v4l2controls.h"
+
+/* Probing is mostly waiting on the driver, not on the CPU */
+#define MAX_PROBE_THREADS 16
+
+V4L2DeviceProbe::V4L2DeviceProbe(const QByteArray &fileName) :
+    fileName(fileName), fd(-1), fromCache(false),
+    openTime(0), capTime(0), enumTime(0), buildTime(0)
+{
+    memset(&cap, 0, sizeof(cap));
+}
+
+void V4L2DeviceProbe::run()
+{
+    QElapsedTimer clock;
+
+    clock.start();
+    fd = v4l2_open(fileName.constData(), O_RDWR, 0);
+    openTime = clock.nsecsElapsed();
+    if(fd < 0) {
+        errorTitle = "v4l2ucp: Unable to open file";
+        error.sprintf("Unable to open file %s\n%s", fileName.constData(), strerror(errno));
+        return;
+    }
+
+    clock.restart();
+    if(core_ioctl(fd, VIDIOC_QUERYCAP, &cap) == -1) {
+        capTime = clock.nsecsElapsed();
+        errorTitle = "v4l2ucp: Not a V4L2 device";
+        error.sprintf("%s is not a V4L2 device", fileName.constData());
+        v4l2_close(fd);
+        fd = -1;
+        return;
+    }
+    capTime = clock.nsecsElapsed();
+
+    /* With a cache hit the window checks it against the device later */
+    clock.restart();
+    fromCache = ControlCache::load(cap, infos);
+    if(!fromCache)
+        enumerateControls(fd, infos, true, &warnings);
+    enumTime = clock.nsecsElapsed();
+}
+
+void V4L2DeviceProbe::enumerateControls(int fd, QList<V4L2ControlInfo> &list, bool withMenus,
+                                        QStringList *warnings)
+{
+    struct v4l2_query_ext_ctrl qc;
+    V4L2ControlInfo info;
+
+    list.clear();
+
+    /* The extended query also finds the 64 bit, string, array and compound
+       controls, with their real ranges and sizes */
+    memset(&qc, 0, sizeof(qc));
+    qc.id = V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    while(core_ioctl(fd, VIDIOC_QUERY_EXT_CTRL, &qc) == 0) {
+        info.setExt(qc);
+        info.value = info.ctrl.default_value;
+        info.value64 = qc.default_value;
+        list.append(info);
+        qc.id |= V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    }
+
+    if(list.isEmpty()) {
+        struct control_store store;
+        struct v4l2_queryctrl ctrl;
+
+        store_init(&store);
+        if(store_enumerate(fd, &store) < 0 && warnings)
+            warnings->append("Out of memory while enumerating the controls");
+        for(int i = 0; i < store.count; i++) {
+            store_query(&store, i, &ctrl);
+            info.setQuery(ctrl);
+            info.value = store.value[i];
+            info.value64 = store.value[i];
+            list.append(info);
+        }
+        store_free(&store);
+    }
+
+    if(withMenus)
+        queryMenus(fd, list, warnings);
+}
+
+void V4L2DeviceProbe::queryMenus(int fd, QList<V4L2ControlInfo> &list, QStringList *warnings)
+{
+    QList<V4L2ControlInfo>::iterator it;
+    for(it = list.begin(); it != list.end(); it++) {
+        if((it->ctrl.type == V4L2_CTRL_TYPE_MENU ||
+            it->ctrl.type == V4L2_CTRL_TYPE_INTEGER_MENU) &&
+           !(it->ctrl.flags & V4L2_CTRL_FLAG_DISABLED))
+            it->menu = V4L2MenuControl::queryMenu(fd, it->ctrl, warnings);
+    }
+}
+
+namespace {
+class ProbeTask : public QRunnable
+{
+public:
+    ProbeTask(V4L2DeviceProbe *probe) : probe(probe) {}
+    void run() { probe->run(); }
+
+private:
+    V4L2DeviceProbe *probe;
+};
+}
+
+QList<V4L2DeviceProbe> V4L2DeviceProbe::probeAll(const QList<QByteArray> &files)
+{
+    QList<V4L2DeviceProbe> probes;
+    QList<QByteArray>::const_iterator it;
+    for(it = files.begin(); it != files.end(); it++)
+        probes.append(V4L2DeviceProbe(*it));
+
+    if(probes.size() == 1) {
+        probes[0].run();
+        return probes;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMin(probes.size(), MAX_PROBE_THREADS));
+    for(int i = 0; i < probes.size(); i++)
+        pool.start(new ProbeTask(&probes[i]));
+    pool.waitForDone();
+    return probes;
+}
+
+/*
+ * V4L2EnumerateTask
+ */
+V4L2EnumerateTask::V4L2EnumerateTask(int fd, const QList<V4L2ControlInfo> &cached) :
+    QObject(), infos(cached), changed(false), time(0), fd(fd)
+{
+    setAutoDelete(false);
+}
+
+void V4L2EnumerateTask::run()
+{
+    QElapsedTimer clock;
+    QList<V4L2ControlInfo> live;
+
+    clock.start();
+    V4L2DeviceProbe::enumerateControls(fd, live, false, NULL);
+
+    changed = live.size() != infos.size();
+    for(int i = 0; !changed && i < live.size(); i++)
+        changed = !ControlCache::sameDescriptor(live[i], infos[i]);
+
+    if(changed) {
+        V4L2DeviceProbe::queryMenus(fd, live, &warnings);
+        infos = live;
+    } else {
+        /* Keep the cached menus, take the flags the driver reports now */
+        for(int i = 0; i < live.size(); i++) {
+            infos[i].ctrl.flags = live[i].ctrl.flags;
+            infos[i].ext.flags = live[i].ext.flags;
+        }
+    }
+    time = clock.nsecsElapsed();
+    emit finished();
+}
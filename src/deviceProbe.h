@@ -0,0 +1,89 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef DEVICEPROBE_H
+#define DEVICEPROBE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QRunnable>
+#include <QStringList>
+
+#include "controlCache.h"
+
+/* What a window needs to know about its device before it can be built.
+   It is gathered without touching any widget, so that several devices
+   can be probed in parallel and only the window is built on the GUI
+   thread. */
+struct V4L2DeviceProbe {
+    QByteArray fileName;
+    int fd;
+    struct v4l2_capability cap;
+    QList<V4L2ControlInfo> infos;
+    bool fromCache;
+    /* Set when the device can not be used */
+    QString errorTitle;
+    QString error;
+    /* Shown once the window is up */
+    QStringList warnings;
+    /* Time spent in each step, in ns */
+    qint64 openTime;
+    qint64 capTime;
+    qint64 enumTime;
+    qint64 buildTime;
+
+    V4L2DeviceProbe(const QByteArray &fileName = QByteArray());
+
+    /* Open the device, query its capabilities and load its controls from
+       the cache or the driver. Safe to call from any thread. */
+    void run();
+
+    static void enumerateControls(int fd, QList<V4L2ControlInfo> &list, bool withMenus,
+                                  QStringList *warnings);
+    static void queryMenus(int fd, QList<V4L2ControlInfo> &list, QStringList *warnings);
+
+    /* Probe all files at once, each on a thread of its own */
+    static QList<V4L2DeviceProbe> probeAll(const QList<QByteArray> &files);
+};
+
+/* Enumerates the controls of an open device and compares them with the
+   cached ones, menus are only queried when they differ. Runs on the
+   thread of the worker which owns the fd, see submitTask(). */
+class V4L2EnumerateTask : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    V4L2EnumerateTask(int fd, const QList<V4L2ControlInfo> &cached);
+    void run();
+
+    QList<V4L2ControlInfo> infos;
+    QStringList warnings;
+    bool changed;
+    qint64 time;
+
+signals:
+    void finished();
+
+private:
+    int fd;
+};
+
+#endif
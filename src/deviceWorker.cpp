@@ -0,0 +1,415 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <cstring>
+#include <libv4l2.h>
+
+#include "deviceWorker.h"
+#include "v4l2controls.h"
+#include "v4l2core.h"
+
+/* Largest number of controls merged into one extended control ioctl */
+#define MAX_BATCH 1024
+
+V4L2DeviceWorker::V4L2DeviceWorker(int fd, int timeout) :
+    QThread(), fd(fd), timeout(timeout), nextSeq(0), stalledState(false),
+    head(0), tail(0), extQuery(true)
+{
+    qRegisterMetaType<QVector<V4L2Result> >("QVector<V4L2Result>");
+    clock.start();
+    watchdog.setInterval(100);
+    QObject::connect(&watchdog, SIGNAL(timeout()), this, SLOT(checkDeadlines()));
+    /* The thread object itself lives in the GUI thread */
+    QObject::connect(this, SIGNAL(results(const QVector<V4L2Result> &)),
+                     this, SLOT(completed(const QVector<V4L2Result> &)),
+                     Qt::QueuedConnection);
+}
+
+quint32 V4L2DeviceWorker::submit(V4L2Request::Type type, __u32 id, __s32 value, int timeout)
+{
+    V4L2Request req;
+    req.type = type;
+    req.id = id;
+    req.value = value;
+    req.value64 = false;
+    req.ptr = NULL;
+    req.size = 0;
+    req.timeout = timeout;
+    return enqueue(req);
+}
+
+quint32 V4L2DeviceWorker::submit64(V4L2Request::Type type, __u32 id, __s64 value)
+{
+    V4L2Request req;
+    req.type = type;
+    req.id = id;
+    req.value = value;
+    req.value64 = true;
+    req.ptr = NULL;
+    req.size = 0;
+    req.timeout = 0;
+    return enqueue(req);
+}
+
+quint32 V4L2DeviceWorker::submitPayload(V4L2Request::Type type, __u32 id, void *ptr, __u32 size)
+{
+    V4L2Request req;
+    req.type = type;
+    req.id = id;
+    req.value = 0;
+    req.value64 = false;
+    req.ptr = ptr;
+    req.size = size;
+    req.timeout = 0;
+    return enqueue(req);
+}
+
+quint32 V4L2DeviceWorker::submitTask(QRunnable *task)
+{
+    V4L2Request req;
+    req.type = V4L2Request::Task;
+    req.id = 0;
+    req.value = 0;
+    req.value64 = false;
+    req.ptr = task;
+    req.size = 0;
+    req.timeout = 0;
+    return enqueue(req);
+}
+
+char *V4L2DeviceWorker::allocPayloads(int size)
+{
+    payloads.append(QByteArray(size, '\0'));
+    return payloads.last().data();
+}
+
+quint32 V4L2DeviceWorker::enqueue(V4L2Request &req)
+{
+    req.seq = ++nextSeq;
+    if(req.timeout <= 0)
+        req.timeout = timeout;
+
+    if(req.type != V4L2Request::Quit) {
+        deadlines.insert(req.seq, clock.elapsed() + req.timeout);
+        if(!watchdog.isActive())
+            watchdog.start();
+    }
+
+    /* Keep the order when the ring is full, the rest goes in later */
+    if(!overflow.isEmpty() || !push(req))
+        overflow.append(req);
+    return req.seq;
+}
+
+void V4L2DeviceWorker::shutdown(int timeout)
+{
+    watchdog.stop();
+    submit(V4L2Request::Quit, 0);
+    if(wait(timeout)) {
+        delete this;
+        return;
+    }
+
+    QObject::connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+    if(isFinished())
+        deleteLater();
+}
+
+bool V4L2DeviceWorker::push(const V4L2Request &req)
+{
+    quint32 h = head.loadAcquire();
+    if(h - tail.loadAcquire() == QueueSize)
+        return false;
+    ring[h & (QueueSize - 1)] = req;
+    head.storeRelease(h + 1);
+    wake.release();
+    return true;
+}
+
+bool V4L2DeviceWorker::pop(V4L2Request &req)
+{
+    quint32 t = tail.loadAcquire();
+    if(t == head.loadAcquire())
+        return false;
+    req = ring[t & (QueueSize - 1)];
+    tail.storeRelease(t + 1);
+    return true;
+}
+
+void V4L2DeviceWorker::flushOverflow()
+{
+    while(!overflow.isEmpty() && push(overflow.first()))
+        overflow.removeFirst();
+}
+
+void V4L2DeviceWorker::run()
+{
+    bool quit = false;
+
+    while(!quit) {
+        QVector<V4L2Request> batch;
+        V4L2Request req;
+
+        /* Take everything queued so far, it is merged where possible */
+        while(pop(req)) {
+            if(req.type == V4L2Request::Quit) {
+                quit = true;
+                break;
+            }
+            batch.append(req);
+        }
+
+        if(!batch.isEmpty()) {
+            QVector<V4L2Result> res;
+            res.reserve(batch.size());
+            process(batch, res);
+            emit results(res);
+        } else if(!quit) {
+            /* Only sleep after seeing an empty ring, a push after that
+               leaves a token in the semaphore so no wakeup is lost */
+            wake.acquire();
+        }
+    }
+
+    v4l2_close(fd);
+}
+
+void V4L2DeviceWorker::process(const QVector<V4L2Request> &batch, QVector<V4L2Result> &res)
+{
+    int i = 0;
+    while(i < batch.size()) {
+        if(batch[i].type == V4L2Request::Get || batch[i].type == V4L2Request::Set) {
+            i = runExt(batch, i, res);
+        } else {
+            runSingle(batch[i], res);
+            i++;
+        }
+    }
+}
+
+/* Merge the run of gets or sets starting at first into one extended
+   control ioctl and return the index after the run. A run ends at another
+   request type, another control class or a control already in the run. */
+int V4L2DeviceWorker::runExt(const QVector<V4L2Request> &batch, int first,
+                             QVector<V4L2Result> &res)
+{
+    V4L2Request::Type type = batch[first].type;
+    __u32 cls = V4L2_CTRL_ID2CLASS(batch[first].id);
+    QVector<struct v4l2_ext_control> values;
+    int end = first;
+
+    while(end < batch.size() && end - first < MAX_BATCH &&
+          batch[end].type == type && V4L2_CTRL_ID2CLASS(batch[end].id) == cls) {
+        int i;
+        for(i = first; i < end && batch[i].id != batch[end].id; i++)
+            ;
+        if(i < end)
+            break;
+
+        struct v4l2_ext_control c;
+        memset(&c, 0, sizeof(c));
+        c.id = batch[end].id;
+        if(batch[end].ptr) {
+            c.size = batch[end].size;
+            c.ptr = batch[end].ptr;
+        } else if(batch[end].value64) {
+            c.value64 = batch[end].value;
+        } else {
+            c.value = batch[end].value;
+        }
+        values.append(c);
+        end++;
+    }
+
+    if(values.size() == 1) {
+        runSingle(batch[first], res);
+        return end;
+    }
+
+    struct v4l2_ext_controls ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.ctrl_class = cls;
+    ext.count = values.size();
+    ext.controls = values.data();
+
+    int start = res.size();
+    int ret = core_ioctl(fd, type == V4L2Request::Get ? VIDIOC_G_EXT_CTRLS :
+                                                        VIDIOC_S_EXT_CTRLS, &ext);
+    if(ret == -1) {
+        /* Old driver, or one control failed. Going one by one tells which. */
+        for(int i = first; i < end; i++)
+            runSingle(batch[i], res);
+        res[start].ioctls++;
+        return end;
+    }
+
+    for(int i = first; i < end; i++) {
+        V4L2Result r;
+        r.seq = batch[i].seq;
+        r.type = type;
+        r.id = batch[i].id;
+        r.value = batch[i].value64 ? values[i - first].value64 : values[i - first].value;
+        r.flags = 0;
+        r.error = 0;
+        r.ioctls = i == first ? 1 : 0;
+        res.append(r);
+    }
+    return end;
+}
+
+void V4L2DeviceWorker::runSingle(const V4L2Request &req, QVector<V4L2Result> &res)
+{
+    V4L2Result r;
+    r.seq = req.seq;
+    r.type = req.type;
+    r.id = req.id;
+    r.value = req.value;
+    r.flags = 0;
+    r.error = 0;
+    r.ioctls = 1;
+
+    if(req.type == V4L2Request::Query) {
+        /* Compound controls are only known to the extended query */
+        if(extQuery) {
+            struct v4l2_query_ext_ctrl qc;
+            memset(&qc, 0, sizeof(qc));
+            qc.id = req.id;
+            if(core_ioctl(fd, VIDIOC_QUERY_EXT_CTRL, &qc) == 0) {
+                r.flags = qc.flags;
+                res.append(r);
+                return;
+            }
+            if(errno != ENOTTY) {
+                r.error = errno;
+                res.append(r);
+                return;
+            }
+            extQuery = false;
+            r.ioctls++;
+        }
+        struct v4l2_queryctrl ctrl;
+        memset(&ctrl, 0, sizeof(ctrl));
+        ctrl.id = req.id;
+        if(core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == -1)
+            r.error = errno;
+        else
+            r.flags = ctrl.flags;
+    } else if(req.type == V4L2Request::Task) {
+        /* Its ioctls are its own business */
+        r.ioctls = 0;
+        static_cast<QRunnable *>(req.ptr)->run();
+    } else if(req.type == V4L2Request::QueryMenu) {
+        struct v4l2_queryctrl ctrl;
+        memset(&ctrl, 0, sizeof(ctrl));
+        ctrl.id = req.id;
+        if(core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == -1) {
+            r.error = errno;
+        } else {
+            /* Items the driver skips are shown as Unknown */
+            QStringList warnings;
+            r.menu = V4L2MenuControl::queryMenu(fd, ctrl, &warnings);
+            r.ioctls += r.menu.size();
+            if(!warnings.isEmpty())
+                r.error = EINVAL;
+        }
+    } else if(req.type == V4L2Request::Subscribe) {
+        struct v4l2_event_subscription sub;
+        memset(&sub, 0, sizeof(sub));
+        sub.type = V4L2_EVENT_CTRL;
+        sub.id = req.id;
+        if(core_ioctl(fd, VIDIOC_SUBSCRIBE_EVENT, &sub) == -1)
+            r.error = errno;
+    } else if(req.type == V4L2Request::DequeueEvents) {
+        struct v4l2_event ev;
+        r.id = 0;
+        r.ioctls = 0;
+        for(;;) {
+            r.ioctls++;
+            if(core_ioctl(fd, VIDIOC_DQEVENT, &ev) == -1) {
+                if(errno != ENOENT)
+                    r.error = errno;
+                break;
+            }
+            if(ev.type == V4L2_EVENT_CTRL) {
+                V4L2Result e = r;
+                e.id = ev.id;
+                e.event = ev.u.ctrl;
+                e.ioctls = 0;
+                res.append(e);
+            }
+            if(ev.pending == 0)
+                break;
+        }
+    } else if(req.ptr || req.value64) {
+        struct v4l2_ext_control c;
+        memset(&c, 0, sizeof(c));
+        c.id = req.id;
+        if(req.ptr) {
+            c.size = req.size;
+            c.ptr = req.ptr;
+        } else {
+            c.value64 = req.value;
+        }
+        if(ext_ctrls(fd, req.type == V4L2Request::Get ? VIDIOC_G_EXT_CTRLS :
+                                                        VIDIOC_S_EXT_CTRLS, &c, 1, NULL) == -1)
+            r.error = errno;
+        else if(req.type == V4L2Request::Get && !req.ptr)
+            r.value = c.value64;
+    } else {
+        struct v4l2_control ctl;
+        ctl.id = req.id;
+        ctl.value = req.value;
+        if(core_ioctl(fd, req.type == V4L2Request::Get ? VIDIOC_G_CTRL :
+                                                         VIDIOC_S_CTRL, &ctl) == -1)
+            r.error = errno;
+        else if(req.type == V4L2Request::Get)
+            r.value = ctl.value;
+    }
+    res.append(r);
+}
+
+void V4L2DeviceWorker::completed(const QVector<V4L2Result> &res)
+{
+    QVector<V4L2Result>::const_iterator it;
+    for(it = res.begin(); it != res.end(); it++)
+        deadlines.remove(it->seq);
+
+    flushOverflow();
+    checkDeadlines();
+    if(deadlines.isEmpty())
+        watchdog.stop();
+}
+
+/* The device is stalled while any request is past its deadline */
+void V4L2DeviceWorker::checkDeadlines()
+{
+    qint64 now = clock.elapsed();
+    bool overdue = false;
+
+    QMap<quint32, qint64>::const_iterator it;
+    for(it = deadlines.begin(); !overdue && it != deadlines.end(); it++)
+        overdue = it.value() < now;
+
+    if(overdue != stalledState) {
+        stalledState = overdue;
+        emit stalled(overdue);
+    }
+}
@@ -0,0 +1,158 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef DEVICEWORKER_H
+#define DEVICEWORKER_H
+
+#include <linux/types.h>          /* for videodev2.h */
+#include <linux/videodev2.h>
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QMetaType>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+/* One control operation for V4L2DeviceWorker */
+struct V4L2Request {
+    enum Type {
+        Get,        /* read the value */
+        Set,        /* write value */
+        Query,      /* read the flags */
+        QueryMenu,  /* read the range and the menu items again */
+        Subscribe,  /* to the V4L2_EVENT_CTRL of the control */
+        DequeueEvents, /* all pending events, one result each */
+        Task,       /* run the QRunnable at ptr */
+        Quit
+    };
+    Type type;
+    quint32 seq;
+    __u32 id;
+    __s64 value;
+    bool value64;   /* value is a V4L2_CTRL_TYPE_INTEGER64 one */
+    void *ptr;      /* payload of a string, array or compound control */
+    __u32 size;
+    int timeout;    /* in ms, 0 for the worker default */
+};
+
+struct V4L2Result {
+    quint32 seq;
+    int type;       /* V4L2Request::Type */
+    __u32 id;
+    __s64 value;    /* read for Get, written for Set, the payload of those
+                       with one is at the ptr of the request */
+    __u32 flags;    /* for Query */
+    int error;      /* errno, 0 on success */
+    int ioctls;     /* ioctls issued for this request, shared ones are
+                       counted on the first request of a batch */
+    /* For DequeueEvents the event of control id, the last result of the
+       request has id 0 and no event */
+    struct v4l2_event_ctrl event;
+    QStringList menu;   /* for QueryMenu */
+};
+
+Q_DECLARE_METATYPE(V4L2Result)
+Q_DECLARE_METATYPE(QVector<V4L2Result>)
+
+/* Owns the file descriptor of one device and runs its control ioctls on a
+   thread of its own, so that a slow or hung driver only stalls the window
+   of that device. Requests are posted through a lock free single producer
+   ring, adjacent gets or sets of one control class are merged into one
+   extended control ioctl, and results come back through a queued signal.
+   Only the GUI thread may call submit(). */
+class V4L2DeviceWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    V4L2DeviceWorker(int fd, int timeout = 2000);
+
+    quint32 submit(V4L2Request::Type type, __u32 id, __s32 value = 0, int timeout = 0);
+    quint32 submit64(V4L2Request::Type type, __u32 id, __s64 value = 0);
+    /* The size bytes at ptr are read or written by the worker thread, they
+       must be left alone until the result is in */
+    quint32 submitPayload(V4L2Request::Type type, __u32 id, void *ptr, __u32 size);
+    /* Run task on the worker thread between the other requests, for work
+       on the fd which is more than one control. It is not deleted. */
+    quint32 submitTask(QRunnable *task);
+    /* Room for the payloads of the device. Blocks are never moved or freed
+       before the worker, as queued requests may still point into them. */
+    char *allocPayloads(int size);
+    bool isStalled() const { return stalledState; }
+    int pending() const { return deadlines.size(); }
+
+    /* Stop the thread and close the fd. A thread stuck in the driver is
+       left behind and deletes itself once the ioctl returns. */
+    void shutdown(int timeout = 1000);
+
+signals:
+    /* Emitted from the worker thread, connect with a queued connection */
+    void results(const QVector<V4L2Result> &res);
+    /* A request ran past its timeout, or the device caught up again */
+    void stalled(bool stalled);
+
+protected:
+    void run();
+
+private slots:
+    void completed(const QVector<V4L2Result> &res);
+    void checkDeadlines();
+
+private:
+    enum { QueueSize = 256 };
+
+    int fd;
+    int timeout;
+
+    /* Written by the GUI thread only */
+    quint32 nextSeq;
+    QList<V4L2Request> overflow;
+    QMap<quint32, qint64> deadlines;
+    QElapsedTimer clock;
+    QTimer watchdog;
+    bool stalledState;
+
+    /* The ring, head is advanced by the GUI thread, tail by the worker */
+    V4L2Request ring[QueueSize];
+    QAtomicInteger<quint32> head;
+    QAtomicInteger<quint32> tail;
+    QSemaphore wake;
+
+    QList<QByteArray> payloads;
+    /* Written by the worker thread only */
+    bool extQuery;
+
+    quint32 enqueue(V4L2Request &req);
+    bool push(const V4L2Request &req);
+    bool pop(V4L2Request &req);
+    void flushOverflow();
+
+    void process(const QVector<V4L2Request> &batch, QVector<V4L2Result> &res);
+    int runExt(const QVector<V4L2Request> &batch, int first, QVector<V4L2Result> &res);
+    void runSingle(const V4L2Request &req, QVector<V4L2Result> &res);
+};
+
+#endif
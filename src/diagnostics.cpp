@@ -0,0 +1,163 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QVector>
+
+#include "controlModel.h"
+#include "diagnostics.h"
+#include "v4l2core.h"
+
+enum {
+    IoctlColumn,
+    ControlColumn,
+    CallsColumn,
+    ErrorsColumn,
+    TotalColumn,
+    MeanColumn,
+    P50Column,
+    P99Column,
+    MaxColumn,
+    ColumnCount
+};
+
+/* Numeric columns sort by value, not text */
+namespace {
+class StatItem : public QTreeWidgetItem
+{
+public:
+    bool operator<(const QTreeWidgetItem &other) const
+    {
+        int col = treeWidget()->sortColumn();
+        if(col < CallsColumn)
+            return QTreeWidgetItem::operator<(other);
+        return data(col, Qt::UserRole).toDouble() <
+               other.data(col, Qt::UserRole).toDouble();
+    }
+};
+}
+
+DiagnosticsWindow::DiagnosticsWindow(const V4L2ControlModel *model, QWidget *parent) :
+    QWidget(parent, Qt::Window), model(model)
+{
+    setWindowTitle("v4l2ucp: Diagnostics");
+
+    QStringList headers;
+    headers << "ioctl" << "Control" << "Calls" << "Errors" << "Total ms"
+            << "Mean us" << "p50 us" << "p99 us" << "Max us";
+    tree = new QTreeWidget(this);
+    tree->setColumnCount(ColumnCount);
+    tree->setHeaderLabels(headers);
+    tree->setRootIsDecorated(false);
+    tree->setSortingEnabled(true);
+    tree->sortByColumn(TotalColumn, Qt::DescendingOrder);
+    tree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    summary = new QLabel(this);
+    QPushButton *reset = new QPushButton("Reset", this);
+    QPushButton *close = new QPushButton("Close", this);
+    QObject::connect(reset, SIGNAL(clicked()), this, SLOT(resetStats()));
+    QObject::connect(close, SIGNAL(clicked()), this, SLOT(close()));
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(summary, 1);
+    buttons->addWidget(reset);
+    buttons->addWidget(close);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(tree);
+    layout->addLayout(buttons);
+    resize(720, 400);
+
+    QObject::connect(&timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    timer.start(1000);
+    refresh();
+}
+
+QString DiagnosticsWindow::controlName(unsigned long request, __u32 id) const
+{
+    if(id == 0)
+        return QString();
+    if(request == VIDIOC_G_EXT_CTRLS || request == VIDIOC_S_EXT_CTRLS ||
+       request == VIDIOC_TRY_EXT_CTRLS) {
+        if(id == V4L2_CTRL_ID2CLASS(id))
+            return QString().sprintf("class 0x%08x", id);
+    }
+    int c = model ? model->controlById(id) : -1;
+    if(c >= 0)
+        return QString((const char *)model->info(c).ctrl.name);
+    return QString().sprintf("0x%08x", id);
+}
+
+void DiagnosticsWindow::refresh()
+{
+    QVector<struct ioctl_stat> stats(stats_snapshot(NULL, 0));
+    int n = stats_snapshot(stats.data(), stats.size());
+    if(n < stats.size())
+        stats.resize(n);
+
+    unsigned long calls = 0;
+    double total = 0;
+
+    /* Rebuilding keeps the sort order, items are cheap at this size */
+    tree->setSortingEnabled(false);
+    tree->clear();
+    for(int i = 0; i < stats.size(); i++) {
+        const struct ioctl_stat &st = stats[i];
+        double values[ColumnCount];
+        values[CallsColumn] = st.count;
+        values[ErrorsColumn] = st.errors;
+        values[TotalColumn] = st.total_ns / 1e6;
+        values[MeanColumn] = st.count ? st.total_ns / 1e3 / st.count : 0;
+        values[P50Column] = stats_percentile(&st, 0.5) / 1e3;
+        values[P99Column] = stats_percentile(&st, 0.99) / 1e3;
+        values[MaxColumn] = st.max_ns / 1e3;
+
+        StatItem *item = new StatItem;
+        item->setText(IoctlColumn, st.request ? ioctl_name(st.request) : "other");
+        item->setText(ControlColumn, controlName(st.request, st.id));
+        for(int col = CallsColumn; col < ColumnCount; col++) {
+            item->setData(col, Qt::UserRole, values[col]);
+            if(col == CallsColumn || col == ErrorsColumn)
+                item->setText(col, QString::number((qulonglong)values[col]));
+            else
+                item->setText(col, QString::number(values[col], 'f', col == TotalColumn ? 3 : 1));
+            item->setTextAlignment(col, Qt::AlignRight);
+        }
+        tree->addTopLevelItem(item);
+
+        calls += st.count;
+        total += st.total_ns / 1e6;
+    }
+    tree->setSortingEnabled(true);
+
+    QString msg;
+    msg.sprintf("%lu ioctls, %.1f ms in the driver", calls, total);
+    summary->setText(msg);
+}
+
+void DiagnosticsWindow::resetStats()
+{
+    stats_reset();
+    refresh();
+}
@@ -0,0 +1,55 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <QTimer>
+#include <QWidget>
+
+#include <linux/types.h>
+
+class QLabel;
+class QTreeWidget;
+class V4L2ControlModel;
+
+/* The ioctl counts and latencies recorded by core_ioctl(), for every
+   device of the process. Control names come from the model of the window
+   which opened it. */
+class DiagnosticsWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    DiagnosticsWindow(const V4L2ControlModel *model, QWidget *parent);
+
+public slots:
+    void refresh();
+    void resetStats();
+
+private:
+    const V4L2ControlModel *model;
+    QTreeWidget *tree;
+    QLabel *summary;
+    QTimer timer;
+
+    QString controlName(unsigned long request, __u32 id) const;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <QComboBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPainter>
+#include <QPushButton>
+#include <QSlider>
+#include <QVBoxLayout>
+#include <QVector>
+
+#include "focusAssist.h"
+
+#define HISTORY 200     /* frames in the graph */
+
+static const int areas[] = { 25, 50, 100 };
+
+class SharpnessGraph : public QWidget
+{
+public:
+    QVector<double> values;     /* oldest first */
+
+    SharpnessGraph(QWidget *parent) : QWidget(parent)
+    {
+        setMinimumSize(256, 60);
+        setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    }
+
+    void add(double value)
+    {
+        if(values.size() >= HISTORY)
+            values.remove(0);
+        values.append(value);
+    }
+
+protected:
+    void paintEvent(QPaintEvent *)
+    {
+        QPainter painter(this);
+        painter.fillRect(rect(), Qt::black);
+        if(values.size() < 2)
+            return;
+
+        /* Scaled to the sharpest frame shown, the peak is what counts */
+        double top = 1;
+        for(int i = 0; i < values.size(); i++)
+            if(values[i] > top)
+                top = values[i];
+
+        painter.setPen(Qt::green);
+        int h = height() - 1;
+        QPointF previous;
+        for(int i = 0; i < values.size(); i++) {
+            QPointF p((double)i * (width() - 1) / (HISTORY - 1), h - values[i] * h / top);
+            if(i)
+                painter.drawLine(previous, p);
+            previous = p;
+        }
+    }
+};
+
+FocusAssist::FocusAssist(QWidget *parent) :
+    QWidget(parent), minimum(0), maximum(-1), step(1), enabled(false),
+    sweeping(false), last(0), fresh(false)
+{
+    graph = new SharpnessGraph(this);
+    sharpnessValue = new QLabel(this);
+    areaCombo = new QComboBox(this);
+    areaCombo->addItem("Centre quarter");
+    areaCombo->addItem("Centre half");
+    areaCombo->addItem("Whole frame");
+    areaCombo->setCurrentIndex(1);
+    slider = new QSlider(Qt::Horizontal, this);
+    focusValue = new QLabel(this);
+    focusValue->setMinimumWidth(focusValue->fontMetrics().width("00000"));
+    sweep = new QPushButton("Sweep and pick best", this);
+    QObject::connect(slider, SIGNAL(valueChanged(int)), this, SLOT(sliderChanged(int)));
+    QObject::connect(areaCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(areaSelected(int)));
+    QObject::connect(sweep, SIGNAL(clicked()), this, SLOT(sweepClicked()));
+
+    QFormLayout *form = new QFormLayout;
+    form->addRow("Sharpness", sharpnessValue);
+    form->addRow("Area", areaCombo);
+    QHBoxLayout *focus = new QHBoxLayout;
+    focus->addWidget(new QLabel("Focus", this));
+    focus->addWidget(slider, 1);
+    focus->addWidget(focusValue);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(new QLabel("Focus assist", this));
+    layout->addWidget(graph);
+    layout->addLayout(form);
+    layout->addLayout(focus);
+    layout->addWidget(sweep);
+
+    slider->setEnabled(false);
+    sweep->setEnabled(false);
+    focusValue->setText("-");
+    QObject::connect(&timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    timer.start(100);
+}
+
+void FocusAssist::setControl(int minimum, int maximum, int step, bool enabled)
+{
+    if(step < 1)
+        step = 1;
+    if(minimum == this->minimum && maximum == this->maximum &&
+       step == this->step && enabled == this->enabled)
+        return;
+    this->minimum = minimum;
+    this->maximum = maximum;
+    this->step = step;
+    this->enabled = enabled;
+
+    /* The slider moves in steps of the control */
+    slider->blockSignals(true);
+    slider->setRange(0, maximum >= minimum ? (maximum - minimum) / step : 0);
+    slider->blockSignals(false);
+    slider->setEnabled(enabled && !sweeping);
+    sweep->setEnabled(maximum > minimum);
+    if(maximum < minimum)
+        focusValue->setText("-");
+}
+
+int FocusAssist::area() const
+{
+    return areas[areaCombo->currentIndex()];
+}
+
+void FocusAssist::setSharpness(double value)
+{
+    last = value;
+    graph->add(value);
+    fresh = true;
+    if(isHidden())
+        show();
+}
+
+void FocusAssist::showFocus(int value)
+{
+    if(maximum < minimum || slider->isSliderDown())
+        return;
+    slider->blockSignals(true);
+    slider->setValue((value - minimum) / step);
+    slider->blockSignals(false);
+    focusValue->setNum(value);
+}
+
+void FocusAssist::setSweeping(bool on)
+{
+    sweeping = on;
+    sweep->setText(on ? "Stop sweep" : "Sweep and pick best");
+    slider->setEnabled(enabled && !on);
+}
+
+void FocusAssist::clear()
+{
+    if(sweeping) {
+        setSweeping(false);
+        emit sweepToggled(false);
+    }
+    graph->values.clear();
+    last = 0;
+    fresh = true;
+    hide();
+}
+
+void FocusAssist::refresh()
+{
+    if(!fresh)
+        return;
+    fresh = false;
+
+    QString text;
+    text.sprintf("%.1f", last);
+    sharpnessValue->setText(text);
+    graph->update();
+}
+
+void FocusAssist::sliderChanged(int position)
+{
+    int value = minimum + position * step;
+    focusValue->setNum(value);
+    emit focusMoved(value);
+}
+
+void FocusAssist::areaSelected(int index)
+{
+    graph->values.clear();
+    emit areaChanged(areas[index]);
+}
+
+void FocusAssist::sweepClicked()
+{
+    setSweeping(!sweeping);
+    emit sweepToggled(sweeping);
+}
@@ -0,0 +1,77 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef FOCUSASSIST_H
+#define FOCUSASSIST_H
+
+#include <QTimer>
+#include <QWidget>
+
+class QComboBox;
+class QLabel;
+class QPushButton;
+class QSlider;
+class SharpnessGraph;
+
+/* The sharpness of the preview as a number and a graph of the last
+   frames, beside a slider for the absolute focus, and a button to sweep
+   the focus range for the sharpest value. Repaints at most ten times a
+   second like the frame statistics. */
+class FocusAssist : public QWidget
+{
+    Q_OBJECT
+
+public:
+    FocusAssist(QWidget *parent);
+    /* The focus control, maximum < minimum when the device has none */
+    void setControl(int minimum, int maximum, int step, bool enabled);
+    /* In percent of the frame, see PreviewThread::setFocusArea() */
+    int area() const;
+
+public slots:
+    void setSharpness(double value);
+    void showFocus(int value);
+    void setSweeping(bool on);
+    void clear();
+
+signals:
+    void focusMoved(int value);
+    void areaChanged(int percent);
+    void sweepToggled(bool on);
+
+private slots:
+    void refresh();
+    void sliderChanged(int position);
+    void areaSelected(int index);
+    void sweepClicked();
+
+private:
+    SharpnessGraph *graph;
+    QSlider *slider;
+    QLabel *focusValue, *sharpnessValue;
+    QComboBox *areaCombo;
+    QPushButton *sweep;
+    int minimum, maximum, step;
+    bool enabled, sweeping;
+    double last;
+    bool fresh;
+    QTimer timer;
+};
+
+#endif
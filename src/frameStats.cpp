@@ -0,0 +1,139 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <cstring>
+
+#include <QCheckBox>
+#include <QFormLayout>
+#include <QLabel>
+#include <QPainter>
+#include <QVBoxLayout>
+
+#include "frameStats.h"
+
+class HistogramView : public QWidget
+{
+public:
+    __u32 bins[256];
+
+    HistogramView(QWidget *parent) : QWidget(parent)
+    {
+        memset(bins, 0, sizeof(bins));
+        setMinimumSize(256, 100);
+        setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    }
+
+protected:
+    void paintEvent(QPaintEvent *)
+    {
+        QPainter painter(this);
+        painter.fillRect(rect(), Qt::black);
+
+        /* Scaled to the tallest bin inside, the clipped ends would
+           flatten everything else */
+        __u32 top = 1;
+        for(int i = 1; i < 255; i++)
+            if(bins[i] > top)
+                top = bins[i];
+
+        painter.setPen(Qt::lightGray);
+        int h = height();
+        for(int x = 0; x < width(); x++) {
+            int i = x * 256 / width();
+            int bar = bins[i] >= top ? h : (int)((qint64)bins[i] * h / top);
+            if(bar)
+                painter.drawLine(x, h - 1, x, h - bar);
+        }
+    }
+};
+
+FrameStatsPanel::FrameStatsPanel(QWidget *parent) :
+    QWidget(parent), fresh(false)
+{
+    memset(&last, 0, sizeof(last));
+    histogram = new HistogramView(this);
+    luma = new QLabel(this);
+    channels = new QLabel(this);
+    clipped = new QLabel(this);
+    black = new QLabel(this);
+    tuneExposure = new QCheckBox("Software exposure", this);
+    tuneWhiteBalance = new QCheckBox("Software white balance", this);
+    QObject::connect(tuneExposure, SIGNAL(toggled(bool)), this, SLOT(tuningToggled()));
+    QObject::connect(tuneWhiteBalance, SIGNAL(toggled(bool)), this, SLOT(tuningToggled()));
+
+    QFormLayout *form = new QFormLayout;
+    form->addRow("Mean luma", luma);
+    form->addRow("Red / green / blue", channels);
+    form->addRow("Clipped", clipped);
+    form->addRow("Black", black);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(new QLabel("Preview", this));
+    layout->addWidget(histogram);
+    layout->addLayout(form);
+    layout->addWidget(tuneExposure);
+    layout->addWidget(tuneWhiteBalance);
+    layout->addStretch(1);
+
+    QObject::connect(&timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    timer.start(100);
+    refresh();
+}
+
+void FrameStatsPanel::setStats(const frame_stats &stats)
+{
+    last = stats;
+    fresh = true;
+    if(isHidden())
+        show();
+}
+
+void FrameStatsPanel::clear()
+{
+    memset(&last, 0, sizeof(last));
+    fresh = true;
+    hide();
+}
+
+void FrameStatsPanel::refresh()
+{
+    if(!fresh)
+        return;
+    fresh = false;
+
+    memcpy(histogram->bins, last.histogram, sizeof(histogram->bins));
+    histogram->update();
+
+    QString text;
+    double pixels = last.pixels ? last.pixels : 1;
+    text.sprintf("%.1f", frame_stats_mean(&last, FRAME_LUMA));
+    luma->setText(text);
+    text.sprintf("%.1f / %.1f / %.1f", frame_stats_mean(&last, FRAME_RED),
+                 frame_stats_mean(&last, FRAME_GREEN), frame_stats_mean(&last, FRAME_BLUE));
+    channels->setText(text);
+    text.sprintf("%.2f %%", 100.0 * last.clipped / pixels);
+    clipped->setText(text);
+    text.sprintf("%.2f %%", 100.0 * last.histogram[0] / pixels);
+    black->setText(text);
+}
+
+void FrameStatsPanel::tuningToggled()
+{
+    emit tuningChanged(tuneExposure->isChecked(), tuneWhiteBalance->isChecked());
+}
@@ -0,0 +1,63 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <QTimer>
+#include <QWidget>
+
+#include "v4l2core.h"
+
+class QCheckBox;
+class QLabel;
+class HistogramView;
+
+/* The luma histogram, channel means and clipping of the preview, beside
+   the controls which change them. Frames come at the camera's rate, the
+   panel repaints at most ten times a second. */
+class FrameStatsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    FrameStatsPanel(QWidget *parent);
+
+public slots:
+    void setStats(const frame_stats &stats);
+    void clear();
+
+signals:
+    /* The software exposure and white balance were turned on or off */
+    void tuningChanged(bool exposure, bool whiteBalance);
+
+private slots:
+    void refresh();
+    void tuningToggled();
+
+private:
+    struct frame_stats last;
+    bool fresh;
+    HistogramView *histogram;
+    QLabel *luma, *channels, *clipped, *black;
+    QCheckBox *tuneExposure, *tuneWhiteBalance;
+    QTimer timer;
+};
+
+#endif
@@ -21,10 +21,10 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <libv4l2.h>
 
-#include <QScrollArea>
 #include <QFileDialog>
 #include <QString>
 #include <QLabel>
@@ -35,18 +35,51 @@
 #include <QMenu>
 #include <QTimer>
 #include <QSettings>
+#include <QStatusBar>
+#include <QSocketNotifier>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QElapsedTimer>
 
 #include "v4l2controls.h"
 #include "mainWindow.h"
 #include "previewSettings.h"
+#include "controlCache.h"
+#include "controlModel.h"
+#include "controlView.h"
+#include "deviceWorker.h"
+#include "deviceProbe.h"
+#include "diagnostics.h"
+#include "focusAssist.h"
+#include "frameStats.h"
+#include "previewWindow.h"
+#include "v4l2core.h"
+
+bool MainWindow::profileStartup = false;
 
 MainWindow::MainWindow(QWidget *parent, const char *name) :
     QMainWindow(parent),
     fd(-1),
-    previewProcess(NULL)
+    previewProcess(NULL),
+    diagnostics(NULL),
+    preview(NULL),
+    statsPanel(NULL),
+    tuner(NULL),
+    focusAssist(NULL),
+    sweep(NULL),
+    eventNotifier(NULL),
+    model(NULL),
+    view(NULL),
+    worker(NULL),
+    cachePending(false)
 {
     setWindowTitle(name);
 	setWindowIcon(QIcon(":/v4l2ucp.png"));
+
+    QSettings settings(APP_ORG, APP_NAME);
+    V4L2IntegerControl::setMaxWriteRate(
+        settings.value(SETTINGS_MAX_WRITE_RATE, V4L2IntegerControl::maxWriteRate()).toInt());
+
     QMenu *menu = new QMenu(this);
     menu->addAction("&Open", this, SLOT(fileOpen()), Qt::CTRL+Qt::Key_O);
     menu->addAction("&Close", this, SLOT(close()), Qt::CTRL+Qt::Key_W);
@@ -63,6 +96,7 @@ MainWindow::MainWindow(QWidget *parent, const char *name) :
 
     menu = new QMenu(this);
     updateActions[0] = menu->addAction("Disabled", this, SLOT(updateDisabled()));
+    updateActions[6] = menu->addAction("On change", this, SLOT(updateEvents()));
     menu->addSeparator();
     updateActions[1] = menu->addAction("1 sec", this, SLOT(update1Sec()));
     updateActions[2] = menu->addAction("5 sec", this, SLOT(update5Sec()));
@@ -73,7 +107,7 @@ MainWindow::MainWindow(QWidget *parent, const char *name) :
     menu->addAction("Update now", this, SLOT(timerShot()));
     menu->setTitle("&Update");
     menuBar()->addMenu(menu);
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setCheckable(true);
     }
@@ -86,6 +120,8 @@ MainWindow::MainWindow(QWidget *parent, const char *name) :
     menuBar()->addMenu(menu);
 
     menu = new QMenu(this);
+    menu->addAction("&Diagnostics", this, SLOT(showDiagnostics()));
+    menu->addSeparator();
     menu->addAction("&About", this, SLOT(about()));
     menu->addAction("About &Qt", this, SLOT(aboutQt()));
     menu->setTitle("&Help");
@@ -115,190 +151,197 @@ void MainWindow::fileOpen()
 
 MainWindow *MainWindow::openFile(const char *fileName)
 {
-    int fd = v4l2_open(fileName, O_RDWR, 0);
-    if(fd < 0) {
-        QString msg;
-	msg.sprintf("Unable to open file %s\n%s", fileName, strerror(errno));
-	QMessageBox::warning(NULL, "v4l2ucp: Unable to open file", msg, "OK");
-        return NULL;
-    }
-    
-    struct v4l2_capability cap;
-    if(v4l2_ioctl(fd, VIDIOC_QUERYCAP, &cap) == -1) {
-        QString msg;
-	msg.sprintf("%s is not a V4L2 device", fileName);
-	QMessageBox::warning(NULL, "v4l2ucp: Not a V4L2 device", msg, "OK");
+    V4L2DeviceProbe probe(fileName);
+    probe.run();
+    return create(probe);
+}
+
+MainWindow *MainWindow::create(V4L2DeviceProbe &probe)
+{
+    if(probe.fd < 0) {
+	QMessageBox::warning(NULL, probe.errorTitle, probe.error, "OK");
         return NULL;
     }
-    
+
+    QElapsedTimer clock;
+    clock.start();
     MainWindow *mw = new MainWindow();
-    mw->fd = fd;
+    mw->fd = probe.fd;
+    mw->device = probe.fileName;
+    mw->cap = probe.cap;
+    mw->infos = probe.infos;
+    mw->worker = new V4L2DeviceWorker(mw->fd);
+    mw->worker->start();
+    QObject::connect(mw->worker, SIGNAL(stalled(bool)),
+                     mw, SLOT(deviceStalled(bool)));
+    mw->model = new V4L2ControlModel(mw->worker, mw);
+    QObject::connect(mw->model, SIGNAL(refreshed(int, int, int)),
+                     mw, SLOT(showRefreshStats(int, int, int)));
+    QObject::connect(mw->model, SIGNAL(statusMessage(const QString &)),
+                     mw->statusBar(), SLOT(showMessage(const QString &)));
+    QObject::connect(mw->model, SIGNAL(eventsSubscribed(int)),
+                     mw, SLOT(eventsSubscribed(int)));
+    QObject::connect(mw->model, SIGNAL(eventsDequeued()),
+                     mw, SLOT(eventsDequeued()));
+    QObject::connect(mw->resetAllId, SIGNAL(triggered(bool)),
+                     mw->model, SLOT(resetAll()));
     QString str("v4l2ucp - ");
-    str.append(fileName);
+    str.append(probe.fileName);
     mw->setWindowTitle(str);
-    
-    QScrollArea *sa = new QScrollArea();
-    sa->setWidgetResizable(true);
 
-    QWidget *grid = new QWidget(sa);
-    sa->setWidget(grid);
+    if(probe.fromCache) {
+        /* Show what we knew last time, check it against the device later */
+        mw->buildControls();
+        QTimer::singleShot(0, mw, SLOT(reconcileCache()));
+    } else {
+        mw->buildControls();
+        mw->model->refresh();
+        mw->subscribeEvents();
+        /* Saved once the values are in */
+        mw->cachePending = true;
+    }
+
+    mw->setVisible(true);
+    probe.buildTime = clock.nsecsElapsed();
+
+    if(!probe.warnings.isEmpty())
+        QMessageBox::warning(mw, "Unable to get menu item", probe.warnings.join("\n"), "OK");
+    return mw;
+}
+
+/* Create the window contents on first use, then (re)load the controls */
+void MainWindow::buildControls()
+{
+    if(view) {
+        model->setControls(infos);
+        return;
+    }
+
+    QWidget *central = new QWidget();
+    QVBoxLayout *vbox = new QVBoxLayout(central);
 
-    QGridLayout *gridLayout = new QGridLayout(grid);
-    grid->setLayout(gridLayout);
+    QGridLayout *gridLayout = new QGridLayout();
+    vbox->addLayout(gridLayout);
     
-    QLabel *l = new QLabel("driver", grid);
+    QLabel *l = new QLabel("driver", central);
     gridLayout->addWidget(l, 0, 0);
-    l = new QLabel((const char *)cap.driver, grid);
+    l = new QLabel((const char *)cap.driver, central);
     gridLayout->addWidget(l, 0, 1);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l, 0, 2);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l, 0, 3);
-
-    l = new QLabel("card", grid);
-    gridLayout->addWidget(l);
-    l = new QLabel((const char *)cap.card, grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-
-    l = new QLabel("bus_info", grid);
-    gridLayout->addWidget(l);
-    l = new QLabel((const char *)cap.bus_info, grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-    
 
+    l = new QLabel("card", central);
+    gridLayout->addWidget(l, 1, 0);
+    l = new QLabel((const char *)cap.card, central);
+    gridLayout->addWidget(l, 1, 1);
+
+    l = new QLabel("bus_info", central);
+    gridLayout->addWidget(l, 2, 0);
+    l = new QLabel((const char *)cap.bus_info, central);
+    gridLayout->addWidget(l, 2, 1);
+
+    QString str;
     str.sprintf("%d.%d.%d", cap.version>>16, (cap.version>>8)&0xff,
                 cap.version&0xff);
-    l = new QLabel("version", grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(str, grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
+    l = new QLabel("version", central);
+    gridLayout->addWidget(l, 3, 0);
+    l = new QLabel(str, central);
+    gridLayout->addWidget(l, 3, 1);
     
     str.sprintf("0x%08x", cap.capabilities);
-    l = new QLabel("capabilities", grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(str, grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-    l = new QLabel(grid);
-    gridLayout->addWidget(l);
-
-    
-    struct v4l2_queryctrl ctrl;
-#ifdef V4L2_CTRL_FLAG_NEXT_CTRL
-    /* Try the extended control API first */
-    ctrl.id = V4L2_CTRL_FLAG_NEXT_CTRL;
-    if(0 == v4l2_ioctl (fd, VIDIOC_QUERYCTRL, &ctrl)) {
-	do {
-		mw->add_control(ctrl, fd, grid, gridLayout);
-		ctrl.id |= V4L2_CTRL_FLAG_NEXT_CTRL;
-	} while(0 == v4l2_ioctl (fd, VIDIOC_QUERYCTRL, &ctrl));
-    } else
-#endif
-    {
-	/* Fall back on the standard API */
-	/* Check all the standard controls */
-	for(int i=V4L2_CID_BASE; i<V4L2_CID_LASTP1; i++) {
-            ctrl.id = i;
-            if(v4l2_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0) {
-        	mw->add_control(ctrl, fd, grid, gridLayout);
-            }
-	}
-
-	/* Check any custom controls */
-	for(int i=V4L2_CID_PRIVATE_BASE; ; i++) {
-            ctrl.id = i;
-            if(v4l2_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0) {
-        	mw->add_control(ctrl, fd, grid, gridLayout);
-            } else {
-        	break;
-            }
-	}
-    }
-    
-    mw->setCentralWidget(sa);
-    mw->setVisible(true);
-    return mw;
+    l = new QLabel("capabilities", central);
+    gridLayout->addWidget(l, 4, 0);
+    l = new QLabel(str, central);
+    gridLayout->addWidget(l, 4, 1);
+    gridLayout->setColumnStretch(1, 1);
+
+    model->setControls(infos);
+    view = new V4L2ControlView(central);
+    view->setModel(model);
+    QObject::connect(view, SIGNAL(statusMessage(const QString &)),
+                     statusBar(), SLOT(showMessage(const QString &)));
+
+    /* Shown beside the controls while the preview runs */
+    statsPanel = new FrameStatsPanel(central);
+    statsPanel->hide();
+    QObject::connect(statsPanel, SIGNAL(tuningChanged(bool, bool)),
+                     this, SLOT(setTuning(bool, bool)));
+    focusAssist = new FocusAssist(central);
+    focusAssist->hide();
+    QObject::connect(focusAssist, SIGNAL(focusMoved(int)), this, SLOT(writeFocus(int)));
+    QObject::connect(focusAssist, SIGNAL(areaChanged(int)), this, SLOT(setFocusArea(int)));
+    QObject::connect(focusAssist, SIGNAL(sweepToggled(bool)), this, SLOT(sweepFocus(bool)));
+    QVBoxLayout *side = new QVBoxLayout();
+    side->addWidget(statsPanel, 1);
+    side->addWidget(focusAssist);
+    QHBoxLayout *hbox = new QHBoxLayout();
+    hbox->addWidget(view, 1);
+    hbox->addLayout(side);
+    vbox->addLayout(hbox, 1);
+
+    setCentralWidget(central);
 }
 
-MainWindow::~MainWindow()
+/* The window was built from the cache, make sure the device still has the
+   same controls and catch up with its current state. The enumeration runs
+   on the device worker, which owns the fd, in between the other requests
+   and before the fd is closed. cacheChecked() picks up the result. */
+void MainWindow::reconcileCache()
 {
-    if(fd >= 0)
-        v4l2_close(fd);
+    V4L2EnumerateTask *task = new V4L2EnumerateTask(fd, infos);
+    QObject::connect(task, SIGNAL(finished()), this, SLOT(cacheChecked()));
+    QObject::connect(task, SIGNAL(finished()), task, SLOT(deleteLater()));
+    worker->submitTask(task);
 }
 
-void MainWindow::add_control(struct v4l2_queryctrl &ctrl, int fd, QWidget *parent, QGridLayout *layout)
+void MainWindow::cacheChecked()
 {
-    QWidget *w = NULL;
-    
-    if(ctrl.flags & V4L2_CTRL_FLAG_DISABLED)
-        return;
-    
-    QLabel *l = new QLabel((const char *)ctrl.name, parent);
-    layout->addWidget(l);
-    
-    switch(ctrl.type) {
-        case V4L2_CTRL_TYPE_INTEGER:
-            w = new V4L2IntegerControl(fd, ctrl, parent, this);
-            break;
-        case V4L2_CTRL_TYPE_BOOLEAN:
-            w = new V4L2BooleanControl(fd, ctrl, parent, this);
-            break;
-        case V4L2_CTRL_TYPE_MENU:
-            w = new V4L2MenuControl(fd, ctrl, parent, this);
-            break;
-        case V4L2_CTRL_TYPE_BUTTON:
-            w = new V4L2ButtonControl(fd, ctrl, parent, this);
-            break;
-        case V4L2_CTRL_TYPE_INTEGER64:
-        case V4L2_CTRL_TYPE_CTRL_CLASS:
-        default:
-            break;
-    }
-    
-    if(!w) {
-        if (ctrl.type == V4L2_CTRL_TYPE_CTRL_CLASS)
-            layout->addWidget(new QLabel(parent));
-        else
-            layout->addWidget(new QLabel("Unknown control", parent));
-
-        layout->addWidget(new QLabel(parent));
-        layout->addWidget(new QLabel(parent));
+    V4L2EnumerateTask *task = qobject_cast<V4L2EnumerateTask *>(sender());
+    if(!task)
         return;
-    }
-    
-    layout->addWidget(w);
-    if(ctrl.flags & (V4L2_CTRL_FLAG_GRABBED|V4L2_CTRL_FLAG_READ_ONLY|V4L2_CTRL_FLAG_INACTIVE)) {
-        w->setEnabled(false);
-    }
 
-    QPushButton *pb;
-    pb = new QPushButton("Update", parent);
-    layout->addWidget(pb);
-    QObject::connect( pb, SIGNAL(clicked()), w, SLOT(updateStatus()) );
-    QObject::connect( this, SIGNAL(updateNow()), w, SLOT(updateStatus()) );
-    
-    if(ctrl.type == V4L2_CTRL_TYPE_BUTTON) {
-        l = new QLabel(parent);
-        layout->addWidget(l);
+    if(task->changed) {
+        ControlCache::invalidate(cap);
+        infos = task->infos;
+        buildControls();
     } else {
-        pb = new QPushButton("Reset", parent);
-        layout->addWidget(pb);
-        QObject::connect(pb, SIGNAL(clicked()), w, SLOT(resetToDefault()) );
-        QObject::connect(resetAllId, SIGNAL(triggered(bool)), w, SLOT(resetToDefault()) );
+        /* Only the state flags may differ from the cached ones */
+        QList<V4L2ControlInfo>::const_iterator it;
+        for(it = task->infos.begin(); it != task->infos.end(); it++)
+            model->setDriverFlags(it->ctrl.id, it->ctrl.flags);
     }
+
+    if(profileStartup) {
+        printf("%s: cache checked in %.1f ms%s\n", device.constData(),
+               task->time / 1e6, task->changed ? ", controls changed" : "");
+        fflush(stdout);
+    }
+
+    model->refresh();
+    subscribeEvents();
+    cachePending = true;
+
+    if(!task->warnings.isEmpty())
+        QMessageBox::warning(this, "Unable to get menu item", task->warnings.join("\n"), "OK");
+}
+
+/* Remember the descriptors and the values currently shown */
+void MainWindow::saveCache()
+{
+    infos = model->controlInfos();
+    ControlCache::save(cap, infos);
+}
+
+MainWindow::~MainWindow()
+{
+    if(model && model->count())
+        saveCache();
+    delete eventNotifier;
+    /* The worker owns the fd from now on and closes it */
+    if(worker)
+        worker->shutdown();
+    else if(fd >= 0)
+        v4l2_close(fd);
+    delete tuner;
+    delete sweep;
 }
 
 void MainWindow::about()
@@ -328,9 +371,18 @@ void MainWindow::aboutQt()
     QMessageBox::aboutQt(this);
 }
 
+void MainWindow::showDiagnostics()
+{
+    if(!diagnostics)
+        diagnostics = new DiagnosticsWindow(model, this);
+    diagnostics->show();
+    diagnostics->raise();
+    diagnostics->activateWindow();
+}
+
 void MainWindow::updateDisabled()
 {
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setChecked(false);
     }
@@ -340,7 +392,7 @@ void MainWindow::updateDisabled()
 
 void MainWindow::update1Sec()
 {
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setChecked(false);
     }
@@ -352,7 +404,7 @@ void MainWindow::update1Sec()
 
 void MainWindow::update5Sec()
 {
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setChecked(false);
     }
@@ -364,7 +416,7 @@ void MainWindow::update5Sec()
 
 void MainWindow::update10Sec()
 {
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setChecked(false);
     }
@@ -376,7 +428,7 @@ void MainWindow::update10Sec()
 
 void MainWindow::update20Sec()
 {
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setChecked(false);
     }
@@ -388,7 +440,7 @@ void MainWindow::update20Sec()
 
 void MainWindow::update30Sec()
 {
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < 7; i++)
     {
         updateActions[i]->setChecked(false);
     }
@@ -398,12 +450,266 @@ void MainWindow::update30Sec()
     timer.start();
 }
 
+void MainWindow::updateEvents()
+{
+    for (int i = 0; i < 7; i++)
+    {
+        updateActions[i]->setChecked(false);
+    }
+    updateActions[6]->setChecked(true);
+    timer.stop();
+    /* Catch up with whatever happened while we were not listening */
+    model->refresh();
+}
+
+/* Ask the driver to notify us of value, flags and range changes of every
+   control, so that we do not need to poll. The worker subscribes, drivers
+   which do not support control events are left to the update timer. */
+void MainWindow::subscribeEvents()
+{
+    model->subscribeEvents();
+}
+
+void MainWindow::eventsSubscribed(int count)
+{
+    if(!count) {
+        updateActions[6]->setEnabled(false);
+        return;
+    }
+    if(eventNotifier)
+        return;
+
+    /* Only tells that events are pending, the worker dequeues them */
+    eventNotifier = new QSocketNotifier(fd, QSocketNotifier::Exception, this);
+    QObject::connect(eventNotifier, SIGNAL(activated(int)),
+                     this, SLOT(eventPending()));
+    QObject::connect(updateActions[6], SIGNAL(toggled(bool)),
+                     eventNotifier, SLOT(setEnabled(bool)));
+    updateEvents();
+}
+
+/* The notifier would fire again and again until the events are read, it
+   stays off while the worker reads them */
+void MainWindow::eventPending()
+{
+    eventNotifier->setEnabled(false);
+    model->dequeueEvents();
+}
+
+void MainWindow::eventsDequeued()
+{
+    if(eventNotifier && updateActions[6]->isChecked())
+        eventNotifier->setEnabled(true);
+}
+
 void MainWindow::timerShot()
 {
-    emit(updateNow());
+    /* Do not pile up requests behind a device which does not answer */
+    if(!worker->isStalled())
+        model->refresh();
+}
+
+void MainWindow::showRefreshStats(int controls, int changed, int ioctls)
+{
+    QString msg;
+    msg.sprintf("Refreshed %d controls, %d changed, %d ioctls",
+                controls, changed, ioctls);
+    statusBar()->showMessage(msg);
+
+    if(cachePending) {
+        cachePending = false;
+        saveCache();
+    }
+}
+
+/* Grey out the window while a request to the device is overdue, the other
+   windows are not affected as every device has its own worker */
+void MainWindow::deviceStalled(bool stalled)
+{
+    if(centralWidget())
+        centralWidget()->setEnabled(!stalled);
+    resetMenu->setEnabled(!stalled);
+    if(stalled) {
+        QString msg;
+        msg.sprintf("Device is not responding, %d requests pending",
+                    worker->pending());
+        statusBar()->showMessage(msg);
+    } else {
+        statusBar()->showMessage("Device is responding again", 5000);
+    }
 }
 
 void MainWindow::startPreview()
+{
+    QSettings settings(APP_ORG, APP_NAME);
+    if(settings.value(SETTINGS_EXTERNAL_PLAYER, false).toBool()) {
+        startExternalPreview();
+        return;
+    }
+
+    if(!preview) {
+        preview = new PreviewWindow(device, this);
+        QObject::connect(preview, SIGNAL(firstFrame(int)), this, SLOT(showFirstFrame(int)));
+        if(statsPanel) {
+            QObject::connect(preview, SIGNAL(frameStats(const frame_stats &)),
+                             statsPanel, SLOT(setStats(const frame_stats &)));
+            QObject::connect(preview, SIGNAL(stopped()), statsPanel, SLOT(clear()));
+        }
+        QObject::connect(preview, SIGNAL(frameStats(const frame_stats &)),
+                         this, SLOT(tuneFrame(const frame_stats &)));
+        QObject::connect(preview, SIGNAL(sharpness(double)), this, SLOT(focusFrame(double)));
+        if(focusAssist)
+            QObject::connect(preview, SIGNAL(stopped()), focusAssist, SLOT(clear()));
+    }
+    if(focusAssist)
+        preview->setFocusArea(focusAssist->area());
+    if(preview->start()) {
+        preview->show();
+        preview->raise();
+        preview->activateWindow();
+    }
+}
+
+void MainWindow::showFirstFrame(int ms)
+{
+    QString msg;
+    msg.sprintf("Preview: first frame after %d ms", ms);
+    statusBar()->showMessage(msg, 5000);
+    if(profileStartup) {
+        printf("%s: first preview frame in %d ms\n", device.constData(), ms);
+        fflush(stdout);
+    }
+}
+
+void MainWindow::setTuning(bool exposure, bool whiteBalance)
+{
+    if(!exposure && !whiteBalance) {
+        delete tuner;
+        tuner = NULL;
+        return;
+    }
+    if(!tuner) {
+        QSettings settings(APP_ORG, APP_NAME);
+        tuner = new struct tuner;
+        tuner_init(tuner);
+        tuner->target = settings.value(SETTINGS_TUNE_TARGET, tuner->target).toDouble();
+        tuner->delay = settings.value(SETTINGS_TUNE_DELAY, tuner->delay).toInt();
+        tuner->max_frames = settings.value(SETTINGS_TUNE_MAX_FRAMES, tuner->max_frames).toInt();
+        tuner->log = stderr;
+        for(int c = 0; c < model->count(); c++)
+            tuner_add_control(tuner, &model->info(c).ctrl, model->value(c));
+        tuneClock.start();
+    }
+    tuner->exposure = exposure;
+    tuner->white_balance = whiteBalance;
+}
+
+/* The writes go through the model in one batch. The tuner sorts them by
+   id, so the worker merges those of a control class into one
+   S_EXT_CTRLS, the flags and values are read back after all of them. */
+void MainWindow::tuneFrame(const frame_stats &stats)
+{
+    if(!tuner)
+        return;
+
+    /* The user may have moved them since */
+    for(int i = 0; i < TUNE_CONTROLS; i++) {
+        int c = tuner->ctrl[i].id ? model->controlById(tuner->ctrl[i].id) : -1;
+        if(c >= 0)
+            tuner->ctrl[i].value = model->value(c);
+    }
+
+    __u32 ids[TUNE_CONTROLS];
+    __s32 values[TUNE_CONTROLS];
+    int converged = tuner->converged;
+    int n = tuner_frame(tuner, &stats, tuneClock.elapsed(), ids, values);
+    model->writeValues(ids, values, n);
+
+    if(tuner->converged != converged) {
+        QString msg;
+        /* tuner->ioctls counts the S_EXT_CTRLS, not the read backs */
+        msg.sprintf("Tuned in %d frames, %.0f ms, %d writes", tuner->converge_frames,
+                    tuner->converge_ms, tuner->ioctls);
+        statusBar()->showMessage(msg, 5000);
+    }
+}
+
+/* Every frame of the preview. The sweep writes one focus value a frame
+   through the model, like the tuner, without waiting for it to show. */
+void MainWindow::focusFrame(double sharpness)
+{
+    int c = model->controlById(V4L2_CID_FOCUS_ABSOLUTE);
+    if(focusAssist) {
+        if(c >= 0) {
+            const struct v4l2_queryctrl &q = model->info(c).ctrl;
+            focusAssist->setControl(q.minimum, q.maximum, q.step, model->isEnabled(c));
+            focusAssist->showFocus(model->value(c));
+        } else {
+            focusAssist->setControl(0, -1, 1, false);
+        }
+        focusAssist->setSharpness(sharpness);
+    }
+    if(!sweep || c < 0)
+        return;
+
+    __s32 value;
+    int action = focus_sweep_frame(sweep, sharpness, &value);
+    if(action != FOCUS_IDLE)
+        model->writeValue(c, value);
+    if(action == FOCUS_DONE) {
+        QString msg;
+        msg.sprintf("Focus %d, sharpness %.1f, found in %d frames, %lld ms", value,
+                    sweep->best_score, sweep->frames, (long long)sweepClock.elapsed());
+        statusBar()->showMessage(msg, 5000);
+        delete sweep;
+        sweep = NULL;
+        if(focusAssist)
+            focusAssist->setSweeping(false);
+    }
+}
+
+void MainWindow::writeFocus(int value)
+{
+    int c = model->controlById(V4L2_CID_FOCUS_ABSOLUTE);
+    if(c >= 0)
+        model->writeValue(c, value);
+}
+
+void MainWindow::setFocusArea(int percent)
+{
+    if(preview)
+        preview->setFocusArea(percent);
+}
+
+/* The frames must keep coming for the sweep, it only runs with the
+   preview. The delay is the tuner's, both wait for the same camera. */
+void MainWindow::sweepFocus(bool on)
+{
+    delete sweep;
+    sweep = NULL;
+    if(!on)
+        return;
+
+    int c = model->controlById(V4L2_CID_FOCUS_ABSOLUTE);
+    if(c < 0 || !preview || !preview->running()) {
+        if(focusAssist)
+            focusAssist->setSweeping(false);
+        return;
+    }
+    /* The auto focus would fight the sweep */
+    int a = model->controlById(V4L2_CID_FOCUS_AUTO);
+    if(a >= 0 && model->value(a))
+        model->writeValue(a, 0);
+
+    QSettings settings(APP_ORG, APP_NAME);
+    sweep = new struct focus_sweep;
+    focus_sweep_init(sweep, &model->info(c).ctrl, model->value(c));
+    sweep->delay = settings.value(SETTINGS_TUNE_DELAY, sweep->delay).toInt();
+    sweep->log = stderr;
+    sweepClock.start();
+}
+
+void MainWindow::startExternalPreview()
 {
     if (previewProcess && previewProcess->state() != QProcess::NotRunning)
     {
@@ -17,11 +17,26 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
  */
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QTimer>
 #include <QMenu>
 #include <QGridLayout>
 #include <QProcess>
+#include <QList>
+
+#include "controlCache.h"
+#include "v4l2core.h"
+
+class QSocketNotifier;
+class DiagnosticsWindow;
+class FocusAssist;
+class FrameStatsPanel;
+class PreviewWindow;
+class V4L2ControlModel;
+class V4L2ControlView;
+class V4L2DeviceWorker;
+struct V4L2DeviceProbe;
 
 class MainWindow : public QMainWindow
 {
@@ -35,29 +50,67 @@ public slots:
     void update10Sec();
     void update20Sec();
     void update30Sec();
+    void updateEvents();
+    void eventsSubscribed(int count);
+    void eventPending();
+    void eventsDequeued();
+    void reconcileCache();
+    void cacheChecked();
+    void showRefreshStats(int controls, int changed, int ioctls);
+    void deviceStalled(bool stalled);
     void timerShot();
     void about();
     void aboutQt();
+    void showDiagnostics();
     void startPreview();
+    void showFirstFrame(int ms);
+    void setTuning(bool exposure, bool whiteBalance);
+    void tuneFrame(const frame_stats &stats);
+    void focusFrame(double sharpness);
+    void writeFocus(int value);
+    void setFocusArea(int percent);
+    void sweepFocus(bool on);
     void configurePreview();
     void previewProcError(QProcess::ProcessError er);
     void previewFinished(int exitCode, QProcess::ExitStatus status);
-   
-signals:
-    void updateNow();
 
 public:
     static MainWindow *openFile(const char *fileName);
+    /* Build the window for a device probed beforehand, see probeAll() */
+    static MainWindow *create(V4L2DeviceProbe &probe);
+    /* Report how long the checks run after startup take */
+    static void setProfileStartup(bool on) { profileStartup = on; }
     ~MainWindow();
 
 private:
     QMenu *updateMenu, *resetMenu;
     int fd;
+    QByteArray device;
+    struct v4l2_capability cap;
+    QList<V4L2ControlInfo> infos;
     QAction *resetAllId;
-    QAction *updateActions[6];
+    QAction *updateActions[7];
     QTimer timer;
     QProcess *previewProcess;
+    DiagnosticsWindow *diagnostics;
+    PreviewWindow *preview;
+    FrameStatsPanel *statsPanel;
+    struct tuner *tuner;
+    QElapsedTimer tuneClock;
+    FocusAssist *focusAssist;
+    struct focus_sweep *sweep;
+    QElapsedTimer sweepClock;
+    QSocketNotifier *eventNotifier;
+    V4L2ControlModel *model;
+    V4L2ControlView *view;
+    V4L2DeviceWorker *worker;
+    bool cachePending;
     
+    static bool profileStartup;
+
     MainWindow(QWidget *parent=0, const char *name=0);
-    void add_control(struct v4l2_queryctrl &ctrl, int fd, QWidget *parent, QGridLayout *);
+    void buildControls();
+    void saveCache();
+    void subscribeEvents();
+    void startExternalPreview();
 };
@@ -51,12 +51,17 @@ void PreviewSettingsDialog::connectSignals()
         this, SLOT(delArgItemClicked()));
     QObject::connect(ui.defaultsBut, SIGNAL(clicked()),
         this, SLOT(defaultsClicked()));
+    QObject::connect(ui.externalCheck, SIGNAL(toggled(bool)),
+        this, SLOT(externalToggled(bool)));
 }
 
 void PreviewSettingsDialog::loadSettings()
 {
     QSettings settings(APP_ORG, APP_NAME);
 
+    ui.externalCheck->setChecked(settings.value(SETTINGS_EXTERNAL_PLAYER, false).toBool());
+    externalToggled(ui.externalCheck->isChecked());
+
     if (settings.contains(SETTINGS_APP_BINARY_NAME))
     {
         ui.appNameEdit->setText(settings.value(SETTINGS_APP_BINARY_NAME).toString());
@@ -109,6 +114,7 @@ void PreviewSettingsDialog::saveSettings()
 {
     QSettings settings(APP_ORG, APP_NAME);
 
+    settings.setValue(SETTINGS_EXTERNAL_PLAYER, ui.externalCheck->isChecked());
     settings.setValue(SETTINGS_APP_BINARY_NAME, ui.appNameEdit->text());
     QList<QVariant> varList;
     QList<QVariant>::iterator begin, end;
@@ -214,7 +220,21 @@ void PreviewSettingsDialog::defaultsClicked()
     ui.argEdit->clear();
     ui.envEdit->clear();
     ui.appNameEdit->setText("mplayer");
+    ui.externalCheck->setChecked(false);
 
     item = new QListWidgetItem("LD_PRELOAD=/usr/lib/libv4l/v4l2convert.so", ui.envList);
     item = new QListWidgetItem("tv://", ui.argList);
 }
+
+void PreviewSettingsDialog::externalToggled(bool on)
+{
+    ui.appNameEdit->setEnabled(on);
+    ui.envList->setEnabled(on);
+    ui.envEdit->setEnabled(on);
+    ui.addEnvBut->setEnabled(on);
+    ui.removeEnvBut->setEnabled(on);
+    ui.argList->setEnabled(on);
+    ui.argEdit->setEnabled(on);
+    ui.addArgBut->setEnabled(on);
+    ui.removeArgBut->setEnabled(on);
+}
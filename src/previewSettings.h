@@ -22,9 +22,14 @@
 
 #define APP_ORG "v4l2ucp"
 #define APP_NAME "v4l2ucp"
+#define SETTINGS_EXTERNAL_PLAYER "preview/external_player"
 #define SETTINGS_APP_BINARY_NAME "preview/app_binary_name"
 #define SETTINGS_ENV_LIST "preview/env_list"
 #define SETTINGS_ARG_LIST "preview/arg_list"
+#define SETTINGS_MAX_WRITE_RATE "controls/max_write_rate"
+#define SETTINGS_TUNE_TARGET "tuner/target_luma"
+#define SETTINGS_TUNE_DELAY "tuner/delay"
+#define SETTINGS_TUNE_MAX_FRAMES "tuner/max_frames"
 
 class QListWidgetItem;
 
@@ -42,6 +47,7 @@ class PreviewSettingsDialog : public QDialog
         void delEnvItemClicked();
         void delArgItemClicked();
         void defaultsClicked();
+        void externalToggled(bool on);
 
     public:
 
@@ -0,0 +1,355 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <QCloseEvent>
+#include <QCoreApplication>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPainter>
+#include <QVBoxLayout>
+
+#include "previewWindow.h"
+
+#define PREVIEW_BUFFERS 4
+#define STATS_ROW_STEP 2
+
+/* The latest frame, scaled to fit and keeping its aspect ratio */
+class FrameView : public QWidget
+{
+public:
+    QImage image;
+
+    FrameView(QWidget *parent) : QWidget(parent)
+    {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+        setMinimumSize(160, 120);
+    }
+
+protected:
+    void paintEvent(QPaintEvent *)
+    {
+        QPainter painter(this);
+        if(image.isNull()) {
+            painter.fillRect(rect(), Qt::black);
+            return;
+        }
+        QSize size = image.size().scaled(this->size(), Qt::KeepAspectRatio);
+        QRect target(QPoint((width() - size.width()) / 2,
+                            (height() - size.height()) / 2), size);
+        QVector<QRect> border = QRegion(rect()).subtracted(target).rects();
+        for(int i = 0; i < border.size(); i++)
+            painter.fillRect(border[i], Qt::black);
+        painter.drawImage(target, image);
+    }
+};
+
+static QString fourcc(__u32 f)
+{
+    return QString().sprintf("%c%c%c%c", f & 0xff, (f >> 8) & 0xff,
+                             (f >> 16) & 0xff, (f >> 24) & 0xff);
+}
+
+/* The layout of the image for frame_stats_collect(), 0 when it has none */
+static __u32 statsFormat(const QImage &image)
+{
+    switch(image.format()) {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        return V4L2_PIX_FMT_BGR32;
+#endif
+    case QImage::Format_RGB888:
+        return V4L2_PIX_FMT_RGB24;
+    case QImage::Format_Grayscale8:
+        return V4L2_PIX_FMT_GREY;
+    default:
+        return 0;
+    }
+}
+
+PreviewThread::PreviewThread(QObject *parent) :
+    QThread(parent), wrapFormat(QImage::Format_Invalid), next(0)
+{
+    qRegisterMetaType<frame_stats>("frame_stats");
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = -1;
+    for(int i = 0; i < STREAM_MAX_BUFFERS; i++) {
+        buffers[i].thread = this;
+        buffers[i].index = i;
+    }
+}
+
+PreviewThread::~PreviewThread()
+{
+    close();
+}
+
+bool PreviewThread::open(const QByteArray &device)
+{
+    if(stream_open(&stream, device.constData(), PREVIEW_BUFFERS) != 0)
+        return false;
+
+    struct v4l2_pix_format &pix = stream.pix;
+    int depth = 0;
+    wrapFormat = QImage::Format_Invalid;
+    switch(pix.pixelformat) {
+    case V4L2_PIX_FMT_RGB24:
+        wrapFormat = QImage::Format_RGB888;
+        depth = 3;
+        break;
+    case V4L2_PIX_FMT_GREY:
+        wrapFormat = QImage::Format_Grayscale8;
+        depth = 1;
+        break;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    /* Blue first in memory, what QImage keeps in a native 0xffRRGGBB */
+    case V4L2_PIX_FMT_BGR32:
+#ifdef V4L2_PIX_FMT_XBGR32
+    case V4L2_PIX_FMT_XBGR32:
+#endif
+        wrapFormat = QImage::Format_RGB32;
+        depth = 4;
+        break;
+    case V4L2_PIX_FMT_RGB565:
+        wrapFormat = QImage::Format_RGB16;
+        depth = 2;
+        break;
+#endif
+    case V4L2_PIX_FMT_MJPEG:
+    case V4L2_PIX_FMT_JPEG:
+        break;
+    default:
+        if(!frame_convertible(pix.pixelformat)) {
+            stream_close(&stream);
+            errno = EOPNOTSUPP;
+            return false;
+        }
+        for(int i = 0; i < 3; i++)
+            ring[i] = QImage(pix.width, pix.height, QImage::Format_RGB32);
+        next = 0;
+        break;
+    }
+    if(!pix.bytesperline)
+        pix.bytesperline = pix.width * depth;
+
+    quit.store(0);
+    start();
+    return true;
+}
+
+void PreviewThread::stop()
+{
+    quit.store(1);
+    wait();
+}
+
+void PreviewThread::close()
+{
+    stop();
+    stream_close(&stream);
+    for(int i = 0; i < 3; i++)
+        ring[i] = QImage();
+}
+
+void PreviewThread::release(void *info)
+{
+    Buffer *b = (Buffer *)info;
+    stream_queue(&b->thread->stream, b->index);
+}
+
+QImage PreviewThread::image(int index, __u32 bytesused)
+{
+    const struct v4l2_pix_format &pix = stream.pix;
+    const uchar *data = (const uchar *)stream.start[index];
+
+    if(zeroCopy()) {
+        return QImage(data, pix.width, pix.height, pix.bytesperline,
+                      wrapFormat, release, &buffers[index]);
+    }
+
+    QImage img;
+    if(pix.pixelformat == V4L2_PIX_FMT_MJPEG || pix.pixelformat == V4L2_PIX_FMT_JPEG) {
+        img.loadFromData(data, bytesused, "JPEG");
+    } else {
+        /* An image the GUI no longer holds, none means it is behind */
+        for(int i = 0; i < 3; i++) {
+            int r = (next + i) % 3;
+            if(ring[r].isDetached()) {
+                frame_to_rgb32(&pix, data, ring[r].bits(), ring[r].bytesPerLine());
+                img = ring[r];
+                next = (r + 1) % 3;
+                break;
+            }
+        }
+    }
+    stream_queue(&stream, index);
+    return img;
+}
+
+void PreviewThread::run()
+{
+    QElapsedTimer wall;
+    struct timespec cpu0, cpu1;
+    int frames = 0;
+
+    wall.start();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+    while(!quit.load()) {
+        __u32 bytesused = 0;
+        int index = stream_dequeue(&stream, 100, &bytesused);
+        if(index >= 0) {
+            QImage img = image(index, bytesused);
+            if(!img.isNull()) {
+                struct frame_stats st;
+                __u32 layout = statsFormat(img);
+                if(layout && frame_stats_collect(img.constBits(), img.width(), img.height(),
+                                                 img.bytesPerLine(), layout, STATS_ROW_STEP,
+                                                 FRAME_AUTO, &st) == 0)
+                    emit frameStats(st);
+                int area = focusArea.load();
+                if(layout && area > 0) {
+                    struct frame_roi roi;
+                    roi.width = img.width() * area / 100;
+                    roi.height = img.height() * area / 100;
+                    roi.x = (img.width() - roi.width) / 2;
+                    roi.y = (img.height() - roi.height) / 2;
+                    emit sharpness(frame_sharpness(img.constBits(), img.width(), img.height(),
+                                                   img.bytesPerLine(), layout, &roi, FRAME_AUTO));
+                }
+                emit frame(img);
+                frames++;
+            }
+        } else if(errno != EAGAIN && errno != EINTR) {
+            emit failed(errno);
+            break;
+        }
+
+        qint64 ms = wall.elapsed();
+        if(ms >= 1000) {
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+            double busy = (cpu1.tv_sec - cpu0.tv_sec) * 1e3 +
+                          (cpu1.tv_nsec - cpu0.tv_nsec) / 1e6;
+            emit statistics(frames * 1000.0 / ms, 100.0 * busy / ms);
+            frames = 0;
+            cpu0 = cpu1;
+            wall.restart();
+        }
+    }
+}
+
+PreviewWindow::PreviewWindow(const QByteArray &device, QWidget *parent) :
+    QWidget(parent, Qt::Window), device(device), waiting(false)
+{
+    setWindowTitle(QString("v4l2ucp: Preview ") + device);
+
+    thread = new PreviewThread(this);
+    view = new FrameView(this);
+    status = new QLabel(this);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(view, 1);
+    layout->addWidget(status);
+    resize(660, 540);
+
+    QObject::connect(thread, SIGNAL(frame(const QImage &)),
+                     this, SLOT(showFrame(const QImage &)));
+    QObject::connect(thread, SIGNAL(statistics(double, double)),
+                     this, SLOT(showStatistics(double, double)));
+    QObject::connect(thread, SIGNAL(frameStats(const frame_stats &)),
+                     this, SIGNAL(frameStats(const frame_stats &)));
+    QObject::connect(thread, SIGNAL(sharpness(double)), this, SIGNAL(sharpness(double)));
+    QObject::connect(thread, SIGNAL(failed(int)), this, SLOT(captureFailed(int)));
+}
+
+PreviewWindow::~PreviewWindow()
+{
+    stop();
+}
+
+bool PreviewWindow::start()
+{
+    if(thread->isRunning())
+        return true;
+    stop();
+
+    started.start();
+    waiting = true;
+    if(!thread->open(device)) {
+        int err = errno;
+        QString msg;
+        waiting = false;
+        if(err == EOPNOTSUPP)
+            msg.sprintf("Cannot preview %s, the %s pixel format is not supported",
+                        device.constData(), qPrintable(fourcc(thread->format().pixelformat)));
+        else
+            msg.sprintf("Cannot preview %s: %s", device.constData(), strerror(err));
+        QMessageBox::warning(this, "v4l2ucp: warning", msg, "OK");
+        return false;
+    }
+    showStatistics(0, 0);
+    return true;
+}
+
+void PreviewWindow::stop()
+{
+    thread->stop();
+    /* Frames still on their way here hold buffers of the driver */
+    QCoreApplication::removePostedEvents(this, QEvent::MetaCall);
+    view->image = QImage();
+    view->update();
+    thread->close();
+    emit stopped();
+}
+
+void PreviewWindow::showFrame(const QImage &image)
+{
+    view->image = image;
+    view->update();
+    if(waiting) {
+        waiting = false;
+        emit firstFrame(started.elapsed());
+    }
+}
+
+void PreviewWindow::showStatistics(double fps, double cpu)
+{
+    const struct v4l2_pix_format &pix = thread->format();
+    QString msg;
+    msg.sprintf("%ux%u %s, %s, %.1f fps, %.1f%% CPU", pix.width, pix.height,
+                qPrintable(fourcc(pix.pixelformat)),
+                thread->zeroCopy() ? "shown in place" : "converted", fps, cpu);
+    status->setText(msg);
+}
+
+void PreviewWindow::captureFailed(int err)
+{
+    stop();
+    QString msg;
+    msg.sprintf("Preview of %s stopped: %s", device.constData(), strerror(err));
+    QMessageBox::warning(this, "v4l2ucp: warning", msg, "OK");
+}
+
+void PreviewWindow::closeEvent(QCloseEvent *event)
+{
+    stop();
+    QWidget::closeEvent(event);
+}
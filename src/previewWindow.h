@@ -0,0 +1,130 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef PREVIEWWINDOW_H
+#define PREVIEWWINDOW_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QThread>
+#include <QWidget>
+
+#include "v4l2core.h"
+
+class QLabel;
+class FrameView;
+
+Q_DECLARE_METATYPE(frame_stats)
+
+/* Captures with mmap on its own fd. Formats QImage can show are wrapped
+   around the driver's buffer, which goes back to the driver when the
+   last copy of the image is gone. The others are converted here into a
+   small ring of images, a frame is dropped when the GUI still holds
+   every one of them. */
+class PreviewThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    PreviewThread(QObject *parent = NULL);
+    ~PreviewThread();
+
+    /* Open the device and start streaming, returns false with errno set */
+    bool open(const QByteArray &device);
+    /* End run(), the buffers stay mapped for the images still shown */
+    void stop();
+    /* Unmap the buffers, only once every frame sent has been destroyed */
+    void close();
+    const struct v4l2_pix_format &format() const { return stream.pix; }
+    bool zeroCopy() const { return wrapFormat != QImage::Format_Invalid; }
+    /* The centred part of the frame, in percent of its width and height,
+       whose sharpness is measured. 0 to not measure it. */
+    void setFocusArea(int percent) { focusArea.store(percent); }
+
+signals:
+    void frame(const QImage &image);
+    /* Every second: frames per second and the CPU share of this thread */
+    void statistics(double fps, double cpu);
+    /* Of every frame, on every other row */
+    void frameStats(const frame_stats &stats);
+    /* Of every frame, see frame_sharpness() */
+    void sharpness(double value);
+    void failed(int err);
+
+protected:
+    void run();
+
+private:
+    struct Buffer {
+        PreviewThread *thread;
+        int index;
+    };
+
+    struct stream stream;
+    Buffer buffers[STREAM_MAX_BUFFERS];
+    QImage::Format wrapFormat;
+    QImage ring[3];
+    int next;
+    QAtomicInt quit;
+    QAtomicInt focusArea;
+
+    QImage image(int index, __u32 bytesused);
+    static void release(void *info);
+};
+
+class PreviewWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    PreviewWindow(const QByteArray &device, QWidget *parent);
+    ~PreviewWindow();
+
+    /* Start or restart capturing, returns false after telling the user */
+    bool start();
+    bool running() const { return thread->isRunning(); }
+    void setFocusArea(int percent) { thread->setFocusArea(percent); }
+
+signals:
+    /* The time from start() to the first frame shown */
+    void firstFrame(int ms);
+    void frameStats(const frame_stats &stats);
+    void sharpness(double value);
+    void stopped();
+
+public slots:
+    void stop();
+    void showFrame(const QImage &image);
+    void showStatistics(double fps, double cpu);
+    void captureFailed(int err);
+
+protected:
+    void closeEvent(QCloseEvent *event);
+
+private:
+    QByteArray device;
+    PreviewThread *thread;
+    FrameView *view;
+    QLabel *status;
+    QElapsedTimer started;
+    bool waiting;
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <libv4l2.h>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QSlider>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QTreeView>
+
+#include "controlModel.h"
+#include "controlView.h"
+#include "deviceProbe.h"
+#include "deviceWorker.h"
+#include "ucpBench.h"
+
+/* How long a case waits for the worker to answer, in ms */
+#define SETTLE_TIMEOUT 10000
+
+/* One second of mouse moves at 125 Hz */
+#define DRAG_MOVES 125
+#define DRAG_INTERVAL 8
+
+namespace {
+/* What a MainWindow holds for its device. The editors are put in a plain
+   tree view, which commits them through the delegate like the window's,
+   but opens only the ones asked for. */
+class Session
+{
+public:
+    Session() : worker(NULL), model(NULL), view(NULL) {}
+    ~Session();
+
+    bool open(const char *device);
+    bool settle();
+
+    V4L2DeviceWorker *worker;
+    V4L2ControlModel *model;
+    QTreeView *view;
+};
+}
+
+static QApplication *app;
+
+/* Run the event loop for ms, so that timers and results come in */
+static void wait(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+Session::~Session()
+{
+    delete view;
+    /* Like ~MainWindow, the worker closes the fd */
+    if(worker)
+        worker->shutdown();
+    delete model;
+}
+
+/* MainWindow::create() without a cache hit */
+bool Session::open(const char *device)
+{
+    V4L2DeviceProbe probe(device);
+    probe.run();
+    if(probe.fd < 0)
+        return false;
+    /* Nothing writes to the cache of the test mode, see ucp_init() */
+    if(probe.fromCache) {
+        v4l2_close(probe.fd);
+        return false;
+    }
+
+    worker = new V4L2DeviceWorker(probe.fd);
+    worker->start();
+    model = new V4L2ControlModel(worker);
+    model->setControls(probe.infos);
+    view = new QTreeView();
+    view->setItemDelegate(new V4L2ControlDelegate(view));
+    view->setModel(model);
+
+    model->refresh();
+    model->subscribeEvents();
+    return settle();
+}
+
+/* Wait until the worker has answered every request and the model has
+   applied the results, including the requests those led to */
+bool Session::settle()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    for(;;) {
+        while(worker->pending()) {
+            if(clock.elapsed() > SETTLE_TIMEOUT)
+                return false;
+            /* The watchdog of the worker wakes us while it waits */
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        /* The model's copy of the last results is queued behind the
+           worker's own */
+        QCoreApplication::processEvents();
+        if(!worker->pending())
+            return true;
+    }
+}
+
+void ucp_init(int *argc, char **argv)
+{
+    if(qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    /* Keeps the control cache of the user out of the open case */
+    QStandardPaths::setTestModeEnabled(true);
+    app = new QApplication(*argc, argv);
+}
+
+int ucp_open(const char *device)
+{
+    Session s;
+
+    return s.open(device) ? 0 : -1;
+}
+
+int ucp_refresh(const char *device, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    Session s;
+
+    if(!s.open(device))
+        return -1;
+    fake_reset_stats();
+    s.model->refresh();
+    if(!s.settle())
+        return -1;
+    fake_get_stats(counts);
+    return 0;
+}
+
+int ucp_reset_all(const char *device, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    Session s;
+
+    if(!s.open(device))
+        return -1;
+    fake_reset_stats();
+    s.model->resetAll();
+    if(!s.settle())
+        return -1;
+    fake_get_stats(counts);
+    return 0;
+}
+
+int ucp_slider_drag(const char *device, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    Session s;
+
+    if(!s.open(device))
+        return -1;
+    int c = s.model->controlById(V4L2_CID_BRIGHTNESS);
+    if(c < 0)
+        return -1;
+    QModelIndex index = s.model->indexOf(c, V4L2ControlModel::ValueColumn);
+    s.view->openPersistentEditor(index);
+    QWidget *editor = s.view->indexWidget(index);
+    QSlider *slider = editor ? editor->findChild<QSlider *>() : NULL;
+    if(!slider)
+        return -1;
+
+    fake_reset_stats();
+    /* Moved by the mouse, the editor decides what gets written */
+    slider->setSliderDown(true);
+    for(int k = 0; k < DRAG_MOVES; k++) {
+        slider->setValue(slider->minimum() +
+                         k * (slider->maximum() - slider->minimum()) / (DRAG_MOVES - 1));
+        wait(DRAG_INTERVAL);
+    }
+    slider->setSliderDown(false);
+    if(!s.settle())
+        return -1;
+    fake_get_stats(counts);
+    return 0;
+}
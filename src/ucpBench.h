@@ -0,0 +1,51 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef UCPBENCH_H
+#define UCPBENCH_H
+
+#include "v4l2fake.h"
+
+/* The v4l2ucp cases of v4l2bench. They run the probe, the device worker,
+   the control model and the editors of the window, without showing one,
+   against the fake camera linked into the benchmark. Each returns -1 when
+   the device cannot be opened or does not answer. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Start Qt on the offscreen platform, before the first case */
+void ucp_init(int *argc, char **argv);
+
+/* Probe without a cache hit, build the model, the first refresh and the
+   event subscriptions */
+int ucp_open(const char *device);
+/* The refresh of the update timer */
+int ucp_refresh(const char *device, unsigned long counts[FAKE_IOCTL_COUNT]);
+int ucp_reset_all(const char *device, unsigned long counts[FAKE_IOCTL_COUNT]);
+/* One second of dragging the brightness slider, through the coalescing
+   of its editor */
+int ucp_slider_drag(const char *device, unsigned long counts[FAKE_IOCTL_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
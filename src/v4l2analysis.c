@@ -0,0 +1,551 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <string.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ANALYSIS_X86 1
+#include <immintrin.h>
+#endif
+
+#include "v4l2core.h"
+
+/* Luma with 7 bit weights, small enough for _mm256_maddubs_epi16() */
+#define LUMA(r, g, b) ((38 * (r) + 75 * (g) + 15 * (b) + 64) >> 7)
+
+/* Four histograms, one per pixel of a group of four, so that runs of
+   equal pixels do not wait on their own increments */
+typedef __u32 histograms[4][256];
+
+static void merge(histograms h, struct frame_stats *st)
+{
+    int i;
+
+    for(i=0; i<256; i++) {
+        st->histogram[i] += h[0][i] + h[1][i] + h[2][i] + h[3][i];
+    }
+}
+
+/* Pixels as 0xffRRGGBB words, blue first in memory */
+static void bgr32_row_c(const unsigned char *p, int width, histograms h,
+                        struct frame_stats *st)
+{
+    int x, r, g, b;
+
+    for(x=0; x<width; x++, p+=4) {
+        b = p[0];
+        g = p[1];
+        r = p[2];
+        h[x & 3][LUMA(r, g, b)]++;
+        st->sum[0] += r;
+        st->sum[1] += g;
+        st->sum[2] += b;
+        st->clipped += r == 255 || g == 255 || b == 255;
+    }
+}
+
+static void rgb24_row_c(const unsigned char *p, int width, histograms h,
+                        struct frame_stats *st)
+{
+    int x, r, g, b;
+
+    for(x=0; x<width; x++, p+=3) {
+        r = p[0];
+        g = p[1];
+        b = p[2];
+        h[x & 3][LUMA(r, g, b)]++;
+        st->sum[0] += r;
+        st->sum[1] += g;
+        st->sum[2] += b;
+        st->clipped += r == 255 || g == 255 || b == 255;
+    }
+}
+
+static void grey_row_c(const unsigned char *p, int width, histograms h,
+                       struct frame_stats *st)
+{
+    int x;
+
+    for(x=0; x<width; x++) {
+        h[x & 3][p[x]]++;
+        st->sum[0] += p[x];
+        st->clipped += p[x] == 255;
+    }
+    st->sum[1] = st->sum[2] = st->sum[0];
+}
+
+/* The luma bytes of a vector step, in any order */
+static inline void count(const unsigned char *luma, int n, histograms h)
+{
+    int i;
+
+    for(i=0; i<n; i+=4) {
+        h[0][luma[i]]++;
+        h[1][luma[i + 1]]++;
+        h[2][luma[i + 2]]++;
+        h[3][luma[i + 3]]++;
+    }
+}
+
+#ifdef ANALYSIS_X86
+/* 4 pixels: their luma in the even dwords, sums of the channels in the
+   two qwords of each accumulator, clipped pixels counted in *clipped */
+__attribute__((target("sse2")))
+static inline __m128i sse2_luma4(__m128i v)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i coef = _mm_setr_epi16(15, 75, 38, 0, 15, 75, 38, 0);
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), coef);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), coef);
+    __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+
+    lo = _mm_and_si128(_mm_add_epi32(lo, _mm_srli_epi64(lo, 32)), mask);
+    hi = _mm_and_si128(_mm_add_epi32(hi, _mm_srli_epi64(hi, 32)), mask);
+    /* Pixels 0, 2, 1, 3 */
+    return _mm_srli_epi32(_mm_add_epi32(_mm_or_si128(lo, _mm_slli_epi64(hi, 32)),
+                                        _mm_set1_epi32(64)), 7);
+}
+
+__attribute__((target("sse2")))
+static void bgr32_row_sse2(const unsigned char *p, int width, histograms h,
+                           struct frame_stats *st)
+{
+    __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi8((char)0xff);
+    __m128i byte = _mm_set1_epi32(0xff), rgb = _mm_set1_epi32(0xffffff);
+    __m128i sr = zero, sg = zero, sb = zero, v[4], l01, l23;
+    unsigned char luma[16] __attribute__((aligned(16)));
+    __u64 s[2];
+    int x, i, kept = 0;
+
+    for(x=0; x+16<=width; x+=16) {
+        for(i=0; i<4; i++) {
+            v[i] = _mm_loadu_si128((const __m128i *)(p + 4 * (x + 4 * i)));
+            sb = _mm_add_epi64(sb, _mm_sad_epu8(_mm_and_si128(v[i], byte), zero));
+            sg = _mm_add_epi64(sg, _mm_sad_epu8(_mm_and_si128(_mm_srli_epi32(v[i], 8), byte), zero));
+            sr = _mm_add_epi64(sr, _mm_sad_epu8(_mm_and_si128(_mm_srli_epi32(v[i], 16), byte), zero));
+            kept += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(
+                _mm_cmpeq_epi32(_mm_and_si128(_mm_cmpeq_epi8(v[i], ones), rgb), zero))));
+        }
+        l01 = _mm_packs_epi32(sse2_luma4(v[0]), sse2_luma4(v[1]));
+        l23 = _mm_packs_epi32(sse2_luma4(v[2]), sse2_luma4(v[3]));
+        _mm_store_si128((__m128i *)luma, _mm_packus_epi16(l01, l23));
+        count(luma, 16, h);
+    }
+    _mm_storeu_si128((__m128i *)s, sr);
+    st->sum[0] += s[0] + s[1];
+    _mm_storeu_si128((__m128i *)s, sg);
+    st->sum[1] += s[0] + s[1];
+    _mm_storeu_si128((__m128i *)s, sb);
+    st->sum[2] += s[0] + s[1];
+    st->clipped += x - kept;
+    bgr32_row_c(p + 4 * x, width - x, h, st);
+}
+
+/* 8 pixels a register, 32 a step */
+__attribute__((target("avx2")))
+static inline __m256i avx2_luma8(__m256i v)
+{
+    __m256i coef = _mm256_set1_epi32(0x00264b0f);     /* 15, 75, 38, 0 */
+    __m256i sum = _mm256_madd_epi16(_mm256_maddubs_epi16(v, coef), _mm256_set1_epi16(1));
+
+    return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(64)), 7);
+}
+
+__attribute__((target("avx2")))
+static void bgr32_row_avx2(const unsigned char *p, int width, histograms h,
+                           struct frame_stats *st)
+{
+    __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi8((char)0xff);
+    __m256i byte = _mm256_set1_epi32(0xff), rgb = _mm256_set1_epi32(0xffffff);
+    __m256i sr = zero, sg = zero, sb = zero, v[4], l01, l23;
+    unsigned char luma[32] __attribute__((aligned(32)));
+    __u64 s[4];
+    int x, i, kept = 0;
+
+    for(x=0; x+32<=width; x+=32) {
+        for(i=0; i<4; i++) {
+            v[i] = _mm256_loadu_si256((const __m256i *)(p + 4 * (x + 8 * i)));
+            sb = _mm256_add_epi64(sb, _mm256_sad_epu8(_mm256_and_si256(v[i], byte), zero));
+            sg = _mm256_add_epi64(sg, _mm256_sad_epu8(_mm256_and_si256(_mm256_srli_epi32(v[i], 8), byte), zero));
+            sr = _mm256_add_epi64(sr, _mm256_sad_epu8(_mm256_and_si256(_mm256_srli_epi32(v[i], 16), byte), zero));
+            kept += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_cmpeq_epi8(v[i], ones), rgb), zero))));
+        }
+        /* The packs mix the lanes, the histogram does not mind */
+        l01 = _mm256_packs_epi32(avx2_luma8(v[0]), avx2_luma8(v[1]));
+        l23 = _mm256_packs_epi32(avx2_luma8(v[2]), avx2_luma8(v[3]));
+        _mm256_store_si256((__m256i *)luma, _mm256_packus_epi16(l01, l23));
+        count(luma, 32, h);
+    }
+    _mm256_storeu_si256((__m256i *)s, sr);
+    st->sum[0] += s[0] + s[1] + s[2] + s[3];
+    _mm256_storeu_si256((__m256i *)s, sg);
+    st->sum[1] += s[0] + s[1] + s[2] + s[3];
+    _mm256_storeu_si256((__m256i *)s, sb);
+    st->sum[2] += s[0] + s[1] + s[2] + s[3];
+    st->clipped += x - kept;
+    bgr32_row_sse2(p + 4 * x, width - x, h, st);
+}
+#endif
+
+typedef void (*stats_row)(const unsigned char *p, int width, histograms h,
+                          struct frame_stats *st);
+
+static stats_row bgr32_row(int kernel)
+{
+#ifdef ANALYSIS_X86
+    if(kernel == FRAME_AUTO) {
+        kernel = frame_kernel_supported(FRAME_AVX2) ? FRAME_AVX2 : FRAME_SSE2;
+    }
+    if(kernel == FRAME_AVX2 && frame_kernel_supported(FRAME_AVX2)) {
+        return bgr32_row_avx2;
+    }
+    if(kernel == FRAME_SSE2 && frame_kernel_supported(FRAME_SSE2)) {
+        return bgr32_row_sse2;
+    }
+#endif
+    return bgr32_row_c;
+}
+
+int frame_stats_collect(const unsigned char *p, int width, int height, int stride,
+                        __u32 pixelformat, int row_step, int kernel, struct frame_stats *st)
+{
+    histograms h;
+    stats_row row;
+    int y;
+
+    memset(st, 0, sizeof(*st));
+    switch(pixelformat) {
+    case V4L2_PIX_FMT_BGR32:
+        row = bgr32_row(kernel);
+        break;
+    case V4L2_PIX_FMT_RGB24:
+        row = rgb24_row_c;
+        break;
+    case V4L2_PIX_FMT_GREY:
+        row = grey_row_c;
+        break;
+    default:
+        return -1;
+    }
+    if(row_step < 1) {
+        row_step = 1;
+    }
+
+    memset(h, 0, sizeof(h));
+    for(y=0; y<height; y+=row_step) {
+        row(p + y * stride, width, h, st);
+        st->pixels += width;
+    }
+    merge(h, st);
+    return 0;
+}
+
+double frame_stats_mean(const struct frame_stats *st, int channel)
+{
+    unsigned long long sum = 0;
+    int i;
+
+    if(!st->pixels) {
+        return 0;
+    }
+    if(channel < 3) {
+        return (double)st->sum[channel] / st->pixels;
+    }
+    for(i=0; i<256; i++) {
+        sum += (unsigned long long)i * st->histogram[i];
+    }
+    return (double)sum / st->pixels;
+}
+
+/* Focus: the 4 neighbour Laplacian 4 c - l - r - u - d of one 8 bit
+   channel, its sum and sum of squares. Rows are at least 1 pixel inside
+   the frame, so the kernels read their neighbours without checks. */
+struct laplace_sums {
+    __s64 sum;
+    __u64 squares;
+};
+
+/* The vector kernels keep 32 bit sums of squares, at most 2 * 1020^2
+   per lane and step, so they flush them every this many pixels */
+#define LAPLACE_CHUNK 4096
+
+#define LAPLACE(p, o, px, stride) \
+    (4 * (p)[o] - (p)[(o) - (px)] - (p)[(o) + (px)] - (p)[(o) - (stride)] - (p)[(o) + (stride)])
+
+/* Green, second byte of 0xffRRGGBB */
+static void bgr32_laplace_c(const unsigned char *p, int stride, int n,
+                            struct laplace_sums *ls)
+{
+    int x, l;
+
+    for(x=0; x<n; x++, p+=4) {
+        l = LAPLACE(p, 1, 4, stride);
+        ls->sum += l;
+        ls->squares += l * l;
+    }
+}
+
+static void rgb24_laplace_c(const unsigned char *p, int stride, int n,
+                            struct laplace_sums *ls)
+{
+    int x, l;
+
+    for(x=0; x<n; x++, p+=3) {
+        l = LAPLACE(p, 1, 3, stride);
+        ls->sum += l;
+        ls->squares += l * l;
+    }
+}
+
+static void grey_laplace_c(const unsigned char *p, int stride, int n,
+                           struct laplace_sums *ls)
+{
+    int x, l;
+
+    for(x=0; x<n; x++, p++) {
+        l = LAPLACE(p, 0, 1, stride);
+        ls->sum += l;
+        ls->squares += l * l;
+    }
+}
+
+#ifdef ANALYSIS_X86
+/* The Laplacian of 8 pixels in 16 bit lanes, added to the 32 bit sums */
+__attribute__((target("sse2")))
+static inline void sse2_laplace(__m128i c, __m128i l, __m128i r, __m128i u, __m128i d,
+                                __m128i *sum, __m128i *squares)
+{
+    __m128i lap = _mm_sub_epi16(_mm_slli_epi16(c, 2),
+                                _mm_add_epi16(_mm_add_epi16(l, r), _mm_add_epi16(u, d)));
+
+    *sum = _mm_add_epi32(*sum, _mm_madd_epi16(lap, _mm_set1_epi16(1)));
+    *squares = _mm_add_epi32(*squares, _mm_madd_epi16(lap, lap));
+}
+
+__attribute__((target("sse2")))
+static void sse2_flush(__m128i sum, __m128i squares, struct laplace_sums *ls)
+{
+    __s32 s[4];
+    __u32 q[4];
+
+    _mm_storeu_si128((__m128i *)s, sum);
+    _mm_storeu_si128((__m128i *)q, squares);
+    ls->sum += (__s64)s[0] + s[1] + s[2] + s[3];
+    ls->squares += (__u64)q[0] + q[1] + q[2] + q[3];
+}
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_green8(const unsigned char *p)
+{
+    __m128i byte = _mm_set1_epi32(0xff);
+    __m128i a = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i *)p), 8), byte);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i *)(p + 16)), 8), byte);
+
+    return _mm_packs_epi32(a, b);
+}
+
+__attribute__((target("sse2")))
+static void bgr32_laplace_sse2(const unsigned char *p, int stride, int n,
+                               struct laplace_sums *ls)
+{
+    __m128i sum, squares;
+    const unsigned char *q;
+    int x = 0, end;
+
+    while(x + 8 <= n) {
+        sum = squares = _mm_setzero_si128();
+        for(end=x+LAPLACE_CHUNK; x+8<=n && x<end; x+=8) {
+            q = p + 4 * x;
+            sse2_laplace(sse2_green8(q), sse2_green8(q - 4), sse2_green8(q + 4),
+                         sse2_green8(q - stride), sse2_green8(q + stride), &sum, &squares);
+        }
+        sse2_flush(sum, squares, ls);
+    }
+    bgr32_laplace_c(p + 4 * x, stride, n - x, ls);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_grey8(const unsigned char *p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+}
+
+__attribute__((target("sse2")))
+static void grey_laplace_sse2(const unsigned char *p, int stride, int n,
+                              struct laplace_sums *ls)
+{
+    __m128i sum, squares;
+    const unsigned char *q;
+    int x = 0, end;
+
+    while(x + 8 <= n) {
+        sum = squares = _mm_setzero_si128();
+        for(end=x+LAPLACE_CHUNK; x+8<=n && x<end; x+=8) {
+            q = p + x;
+            sse2_laplace(sse2_grey8(q), sse2_grey8(q - 1), sse2_grey8(q + 1),
+                         sse2_grey8(q - stride), sse2_grey8(q + stride), &sum, &squares);
+        }
+        sse2_flush(sum, squares, ls);
+    }
+    grey_laplace_c(p + x, stride, n - x, ls);
+}
+
+/* 16 pixels a step. The packs of the green mix the lanes the same way
+   for every neighbour, the sums do not mind. */
+__attribute__((target("avx2")))
+static inline void avx2_laplace(__m256i c, __m256i l, __m256i r, __m256i u, __m256i d,
+                                __m256i *sum, __m256i *squares)
+{
+    __m256i lap = _mm256_sub_epi16(_mm256_slli_epi16(c, 2),
+                                   _mm256_add_epi16(_mm256_add_epi16(l, r),
+                                                    _mm256_add_epi16(u, d)));
+
+    *sum = _mm256_add_epi32(*sum, _mm256_madd_epi16(lap, _mm256_set1_epi16(1)));
+    *squares = _mm256_add_epi32(*squares, _mm256_madd_epi16(lap, lap));
+}
+
+__attribute__((target("avx2")))
+static void avx2_flush(__m256i sum, __m256i squares, struct laplace_sums *ls)
+{
+    __s32 s[8];
+    __u32 q[8];
+    int i;
+
+    _mm256_storeu_si256((__m256i *)s, sum);
+    _mm256_storeu_si256((__m256i *)q, squares);
+    for(i=0; i<8; i++) {
+        ls->sum += s[i];
+        ls->squares += q[i];
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_green16(const unsigned char *p)
+{
+    __m256i byte = _mm256_set1_epi32(0xff);
+    __m256i a = _mm256_and_si256(_mm256_srli_epi32(_mm256_loadu_si256((const __m256i *)p), 8), byte);
+    __m256i b = _mm256_and_si256(_mm256_srli_epi32(_mm256_loadu_si256((const __m256i *)(p + 32)), 8), byte);
+
+    return _mm256_packs_epi32(a, b);
+}
+
+__attribute__((target("avx2")))
+static void bgr32_laplace_avx2(const unsigned char *p, int stride, int n,
+                               struct laplace_sums *ls)
+{
+    __m256i sum, squares;
+    const unsigned char *q;
+    int x = 0, end;
+
+    while(x + 16 <= n) {
+        sum = squares = _mm256_setzero_si256();
+        for(end=x+LAPLACE_CHUNK; x+16<=n && x<end; x+=16) {
+            q = p + 4 * x;
+            avx2_laplace(avx2_green16(q), avx2_green16(q - 4), avx2_green16(q + 4),
+                         avx2_green16(q - stride), avx2_green16(q + stride), &sum, &squares);
+        }
+        avx2_flush(sum, squares, ls);
+    }
+    bgr32_laplace_sse2(p + 4 * x, stride, n - x, ls);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_grey16(const unsigned char *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+__attribute__((target("avx2")))
+static void grey_laplace_avx2(const unsigned char *p, int stride, int n,
+                              struct laplace_sums *ls)
+{
+    __m256i sum, squares;
+    const unsigned char *q;
+    int x = 0, end;
+
+    while(x + 16 <= n) {
+        sum = squares = _mm256_setzero_si256();
+        for(end=x+LAPLACE_CHUNK; x+16<=n && x<end; x+=16) {
+            q = p + x;
+            avx2_laplace(avx2_grey16(q), avx2_grey16(q - 1), avx2_grey16(q + 1),
+                         avx2_grey16(q - stride), avx2_grey16(q + stride), &sum, &squares);
+        }
+        avx2_flush(sum, squares, ls);
+    }
+    grey_laplace_sse2(p + x, stride, n - x, ls);
+}
+#endif
+
+typedef void (*laplace_row)(const unsigned char *p, int stride, int n,
+                            struct laplace_sums *ls);
+
+static laplace_row choose_laplace(__u32 pixelformat, int kernel)
+{
+    int bgr32 = pixelformat == V4L2_PIX_FMT_BGR32;
+
+    if(!bgr32 && pixelformat != V4L2_PIX_FMT_GREY) {
+        return pixelformat == V4L2_PIX_FMT_RGB24 ? rgb24_laplace_c : NULL;
+    }
+#ifdef ANALYSIS_X86
+    if(kernel == FRAME_AUTO) {
+        kernel = frame_kernel_supported(FRAME_AVX2) ? FRAME_AVX2 : FRAME_SSE2;
+    }
+    if(kernel == FRAME_AVX2 && frame_kernel_supported(FRAME_AVX2)) {
+        return bgr32 ? bgr32_laplace_avx2 : grey_laplace_avx2;
+    }
+    if(kernel == FRAME_SSE2 && frame_kernel_supported(FRAME_SSE2)) {
+        return bgr32 ? bgr32_laplace_sse2 : grey_laplace_sse2;
+    }
+#endif
+    return bgr32 ? bgr32_laplace_c : grey_laplace_c;
+}
+
+double frame_sharpness(const unsigned char *p, int width, int height, int stride,
+                       __u32 pixelformat, const struct frame_roi *roi, int kernel)
+{
+    struct laplace_sums ls = { 0, 0 };
+    laplace_row row = choose_laplace(pixelformat, kernel);
+    int bpp = pixelformat == V4L2_PIX_FMT_BGR32 ? 4 : pixelformat == V4L2_PIX_FMT_RGB24 ? 3 : 1;
+    int x0 = 1, y0 = 1, x1 = width - 1, y1 = height - 1, y;
+    double n, mean;
+
+    if(!row) {
+        return -1;
+    }
+    /* The border has no neighbours */
+    if(roi) {
+        x0 = roi->x > x0 ? roi->x : x0;
+        y0 = roi->y > y0 ? roi->y : y0;
+        x1 = roi->x + roi->width < x1 ? roi->x + roi->width : x1;
+        y1 = roi->y + roi->height < y1 ? roi->y + roi->height : y1;
+    }
+    if(x1 <= x0 || y1 <= y0) {
+        return 0;
+    }
+
+    for(y=y0; y<y1; y++) {
+        row(p + y * stride + x0 * bpp, stride, x1 - x0, &ls);
+    }
+    n = (double)(x1 - x0) * (y1 - y0);
+    mean = ls.sum / n;
+    return ls.squares / n - mean * mean;
+}
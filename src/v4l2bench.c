@@ -0,0 +1,302 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ucpBench.h"
+#include "v4l2fake.h"
+
+/* Measures the control paths of v4l2ucp and v4l2ctrl against the fake
+   camera of v4l2fake.c. The v4l2ucp cases run its control model and
+   device worker in this process, see ucpBench.cpp, the v4l2ctrl cases run
+   the program with libv4l2fake.so preloaded. Every case prints one JSON
+   line with the ioctls of one run and the median and fastest wall time. */
+
+#define DEVICE "/dev/video0"
+#define MAX_ITERATIONS 1000
+
+struct bench {
+    const char *config;
+    const char *ctrl;       /* the v4l2ctrl binary */
+    const char *preload;    /* libv4l2fake.so */
+    char file[64];          /* settings written and read by v4l2ctrl */
+    char stats[64];
+    int iterations;
+};
+
+typedef int (*bench_fn)(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT]);
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * v4l2ucp
+ */
+
+/* V4L2DeviceProbe without a cache hit, then the first refresh and the
+   event subscriptions */
+static int bench_open(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    (void)b;
+    (void)counts;
+    return ucp_open(DEVICE);
+}
+
+/* The timer refresh, the worker reads one control class per ioctl */
+static int bench_refresh(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    (void)b;
+    return ucp_refresh(DEVICE, counts);
+}
+
+/* Reset All, V4L2ControlModel::resetAll() */
+static int bench_reset_all(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    (void)b;
+    return ucp_reset_all(DEVICE, counts);
+}
+
+static int bench_slider_drag(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    (void)b;
+    return ucp_slider_drag(DEVICE, counts);
+}
+
+/*
+ * v4l2ctrl
+ */
+static int run_ctrl(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT],
+                    const char *const *args)
+{
+    const char *argv[16];
+    char name[64];
+    unsigned long n;
+    FILE *file;
+    pid_t pid;
+    int i, status;
+
+    argv[0] = b->ctrl;
+    argv[1] = "-d";
+    argv[2] = DEVICE;
+    for(i=0; args[i] && i<12; i++) {
+        argv[i+3] = args[i];
+    }
+    argv[i+3] = NULL;
+
+    pid = fork();
+    if(pid < 0) {
+        return -1;
+    }
+    if(pid == 0) {
+        setenv("LD_PRELOAD", b->preload, 1);
+        setenv("V4L2FAKE_STATS", b->stats, 1);
+        if(b->config) {
+            setenv("V4L2FAKE_CONFIG", b->config, 1);
+        }
+        i = open("/dev/null", O_WRONLY);
+        dup2(i, 1);
+        dup2(i, 2);
+        execv(b->ctrl, (char *const *)argv);
+        _exit(127);
+    }
+    if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+       WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+
+    file = fopen(b->stats, "r");
+    if(!file) {
+        return -1;
+    }
+    memset(counts, 0, FAKE_IOCTL_COUNT * sizeof(*counts));
+    while(fscanf(file, "%63s %lu", name, &n) == 2) {
+        for(i=0; i<FAKE_IOCTL_COUNT; i++) {
+            if(!strcmp(name, fake_ioctl_names[i])) {
+                counts[i] = n;
+            }
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+static int bench_save(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    const char *args[] = { "-s", b->file, NULL };
+
+    return run_ctrl(b, counts, args);
+}
+
+static int bench_load(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    const char *args[] = { "-l", b->file, NULL };
+
+    return run_ctrl(b, counts, args);
+}
+
+static int bench_load_atomic(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    const char *args[] = { "-a", "-l", b->file, NULL };
+
+    return run_ctrl(b, counts, args);
+}
+
+static int bench_load_changed(struct bench *b, unsigned long counts[FAKE_IOCTL_COUNT])
+{
+    const char *args[] = { "-m", "-l", b->file, NULL };
+
+    return run_ctrl(b, counts, args);
+}
+
+static const struct {
+    const char *name;
+    bench_fn fn;
+    int external;           /* runs v4l2ctrl */
+} cases[] = {
+    { "open", bench_open, 0 },
+    { "refresh", bench_refresh, 0 },
+    { "reset_all", bench_reset_all, 0 },
+    { "slider_drag", bench_slider_drag, 0 },
+    { "ctrl_save", bench_save, 1 },
+    { "ctrl_load", bench_load, 1 },
+    { "ctrl_load_atomic", bench_load_atomic, 1 },
+    { "ctrl_load_changed", bench_load_changed, 1 },
+};
+
+static int time_cmp(const void *a, const void *b)
+{
+    long long ta = *(const long long *)a, tb = *(const long long *)b;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+static void run_case(struct bench *b, int c)
+{
+    unsigned long counts[FAKE_IOCTL_COUNT], total = 0;
+    long long times[MAX_ITERATIONS], start;
+    int i;
+
+    printf("{\"case\":\"%s\",\"controls\":%d,", cases[c].name, fake_control_count());
+    if(cases[c].external && access(b->ctrl, X_OK)) {
+        printf("\"skipped\":\"%s not found\"}\n", b->ctrl);
+        return;
+    }
+    for(i=0; i<b->iterations; i++) {
+        /* The in process cases count only what they measure */
+        fake_reset_stats();
+        start = now_ns();
+        if(cases[c].fn(b, counts)) {
+            printf("\"failed\":true}\n");
+            return;
+        }
+        times[i] = now_ns() - start;
+        if(cases[c].fn == bench_open) {
+            fake_get_stats(counts);
+        }
+    }
+    qsort(times, b->iterations, sizeof(times[0]), time_cmp);
+
+    for(i=0; i<FAKE_IOCTL_COUNT; i++) {
+        total += counts[i];
+    }
+    printf("\"iterations\":%d,\"ioctls\":%lu,\"median_ms\":%.3f,\"min_ms\":%.3f,"
+           "\"by_ioctl\":{", b->iterations, total,
+           times[b->iterations / 2] / 1e6, times[0] / 1e6);
+    for(i=0; i<FAKE_IOCTL_COUNT; i++) {
+        printf("%s\"%s\":%lu", i ? "," : "", fake_ioctl_names[i], counts[i]);
+    }
+    printf("}}\n");
+}
+
+void usage(const char *argv0)
+{
+    printf("Usage: %s [-c config] [-n iterations] [-x v4l2ctrl] [-P libv4l2fake.so]\n", argv0);
+    printf("       %s -h\n", argv0);
+    printf("-c to configure the fake device, see v4l2fake.h.\n");
+    printf("-n to run each case this many times, 5 by default.\n");
+    printf("-x to name the v4l2ctrl program. Defaults to ./v4l2ctrl.\n");
+    printf("-P to name the fake device library. Defaults to ./libv4l2fake.so.\n");
+    printf("-h to print this message.\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct bench b;
+    unsigned int c;
+    int i, fd;
+
+    /* Takes the Qt arguments out of argv */
+    ucp_init(&argc, argv);
+
+    memset(&b, 0, sizeof(b));
+    b.ctrl = "./v4l2ctrl";
+    b.preload = "./libv4l2fake.so";
+    b.iterations = 5;
+    for(i=1; i<argc; i++) {
+        if(!strcmp(argv[i], "-c") && i<argc-1) {
+            b.config = argv[++i];
+        } else if(!strcmp(argv[i], "-n") && i<argc-1) {
+            b.iterations = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-x") && i<argc-1) {
+            b.ctrl = argv[++i];
+        } else if(!strcmp(argv[i], "-P") && i<argc-1) {
+            b.preload = argv[++i];
+        } else if(!strcmp(argv[i], "-h")) {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(b.iterations < 1 || b.iterations > MAX_ITERATIONS) {
+        fprintf(stderr, "The number of iterations must be 1 to %d\n", MAX_ITERATIONS);
+        return EXIT_FAILURE;
+    }
+    if(fake_configure(b.config)) {
+        return EXIT_FAILURE;
+    }
+
+    /* The settings file the load cases read */
+    snprintf(b.file, sizeof(b.file), "/tmp/v4l2bench-%d.cfg", (int)getpid());
+    snprintf(b.stats, sizeof(b.stats), "/tmp/v4l2bench-%d.stats", (int)getpid());
+    fd = open(b.file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd >= 0) {
+        close(fd);
+    }
+
+    for(c=0; c<sizeof(cases)/sizeof(cases[0]); c++) {
+        run_case(&b, c);
+    }
+
+    unlink(b.file);
+    unlink(b.stats);
+    return EXIT_SUCCESS;
+}
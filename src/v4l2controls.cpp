@@ -23,163 +23,56 @@
 #include <libv4l2.h>
 
 #include <QPushButton>
-#include <QLabel>
+#include <QRegExp>
+#include <QSpinBox>
 #include <QValidator>
 #include <QMessageBox>
 
-#include "mainWindow.h"
 #include "v4l2controls.h"
+#include "v4l2core.h"
 
-int V4L2Control::exposure_auto = V4L2_EXPOSURE_MANUAL;
-int V4L2Control::focus_auto = 0;
-int V4L2Control::hue_auto = 0;
-int V4L2Control::whitebalance_auto = 0;
+int V4L2IntegerControl::max_write_rate = 30;
 
-V4L2Control::V4L2Control(int fd, const struct v4l2_queryctrl &ctrl,
-                         QWidget *parent, MainWindow *mw) :
-    QWidget(parent), cid(ctrl.id), default_value(ctrl.default_value), mw(mw)
+V4L2Control::V4L2Control(const struct v4l2_queryctrl &ctrl, QWidget *parent) :
+    QWidget(parent), cid(ctrl.id), default_value(ctrl.default_value)
 {
-    this->fd = fd;
     strncpy(name, (const char *)ctrl.name, sizeof(name));
     name[sizeof(name)-1] = '\0';
     this->setLayout(&layout);
+    layout.setContentsMargins(0, 0, 0, 0);
 }
 
-void V4L2Control::cacheValue(const struct v4l2_control &c)
-{
-    switch (c.id) {
-    case V4L2_CID_EXPOSURE_AUTO:
-        exposure_auto = c.value;
-        break;
-    case V4L2_CID_FOCUS_AUTO:
-        focus_auto = c.value;
-        break;
-    case V4L2_CID_HUE_AUTO:
-        hue_auto = c.value;
-        break;
-    case V4L2_CID_AUTO_WHITE_BALANCE:
-        whitebalance_auto = c.value;
-        break;
-    }
-}
-
-void V4L2Control::queryCleanup(struct v4l2_queryctrl *ctrl)
-{
-    switch (ctrl->id) {
-    case V4L2_CID_EXPOSURE_ABSOLUTE:
-        switch (exposure_auto) {
-            case V4L2_EXPOSURE_AUTO:
-            case V4L2_EXPOSURE_APERTURE_PRIORITY:
-                ctrl->flags |= V4L2_CTRL_FLAG_GRABBED;
-                break;
-        }
-        break;
-
-    case V4L2_CID_IRIS_RELATIVE:
-        ctrl->flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
-        /* Fall through */
-    case V4L2_CID_IRIS_ABSOLUTE:
-        switch (exposure_auto) {
-            case V4L2_EXPOSURE_AUTO:
-            case V4L2_EXPOSURE_SHUTTER_PRIORITY:
-                ctrl->flags |= V4L2_CTRL_FLAG_GRABBED;
-                break;
-        }
-        break;
-
-    case V4L2_CID_FOCUS_RELATIVE:
-        ctrl->flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
-        /* Fall through */
-    case V4L2_CID_FOCUS_ABSOLUTE:
-        if (focus_auto)
-            ctrl->flags |= V4L2_CTRL_FLAG_GRABBED;
-        break;
-
-    case V4L2_CID_HUE:
-        if (hue_auto)
-            ctrl->flags |= V4L2_CTRL_FLAG_GRABBED;
-        break;
-
-    case V4L2_CID_WHITE_BALANCE_TEMPERATURE:
-    case V4L2_CID_BLUE_BALANCE:
-    case V4L2_CID_RED_BALANCE:
-        if (whitebalance_auto)
-            ctrl->flags |= V4L2_CTRL_FLAG_GRABBED;
-        break;
-
-    case V4L2_CID_EXPOSURE_AUTO:
-    case V4L2_CID_FOCUS_AUTO:
-    case V4L2_CID_HUE_AUTO:
-    case V4L2_CID_AUTO_WHITE_BALANCE:
-        ctrl->flags |= V4L2_CTRL_FLAG_UPDATE;
-        break;
-
-    case V4L2_CID_PAN_RELATIVE:
-    case V4L2_CID_TILT_RELATIVE:
-    case V4L2_CID_ZOOM_RELATIVE:
-        ctrl->flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
-        break;
-    }
-}
-
-void V4L2Control::updateHardware()
+void V4L2Control::writeDone(__u32 id)
 {
-    struct v4l2_control c;
-    c.id = cid;
-    c.value = getValue();
-    if(v4l2_ioctl(fd, VIDIOC_S_CTRL, &c) == -1) {
-        QString msg;
-	msg.sprintf("Unable to set %s\n%s", name, strerror(errno));
-	QMessageBox::warning(this, "Unable to set control", msg, "OK");
-	updateStatus(false);
-    } else
-        updateStatus(true);
+    if(id == (__u32)cid)
+        written();
 }
 
-void V4L2Control::updateStatus(bool hwChanged)
+V4L2Control *V4L2Control::create(const V4L2ControlInfo &info, QWidget *parent)
 {
-    struct v4l2_queryctrl ctrl = { 0 };
-    ctrl.id = cid;
-    if(v4l2_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == -1) {
-        QString msg;
-	msg.sprintf("Unable to get the status of %s\n%s", name,
-	            strerror(errno));
-	QMessageBox::warning(this, "Unable to get control status", msg, "OK");
-    } else {
-        queryCleanup(&ctrl);
-        setEnabled(!(ctrl.flags & (V4L2_CTRL_FLAG_GRABBED|V4L2_CTRL_FLAG_READ_ONLY|V4L2_CTRL_FLAG_INACTIVE)));
+    if(info.hasPayload()) {
+        if(info.ext.type == V4L2_CTRL_TYPE_STRING && !info.ext.nr_of_dims)
+            return new V4L2StringControl(info, parent);
+        return new V4L2ArrayControl(info, parent);
     }
 
-    if (hwChanged && (ctrl.flags & V4L2_CTRL_FLAG_UPDATE))
-        mw->timerShot();
-
-#ifdef V4L2_CTRL_FLAG_WRITE_ONLY
-    if(ctrl.flags & V4L2_CTRL_FLAG_WRITE_ONLY)
-        return;
-#endif
-
-    if(ctrl.type == V4L2_CTRL_TYPE_BUTTON)
-        return;
-
-    struct v4l2_control c;
-    c.id = cid;
-    if(v4l2_ioctl(fd, VIDIOC_G_CTRL, &c) == -1) {
-        QString msg;
-	msg.sprintf("Unable to get %s\n%s", name,
-	            strerror(errno));
-	QMessageBox::warning(this, "Unable to get control", msg, "OK");
-    } else {
-        cacheValue(c);
-        if(c.value != getValue())
-	    setValue(c.value);
-    }
-}
-
-void V4L2Control::resetToDefault()
-{
-    if(isEnabled()) {
-        setValue(default_value);
-        updateHardware();
+    switch(info.ctrl.type) {
+        case V4L2_CTRL_TYPE_INTEGER:
+            return new V4L2IntegerControl(info.ctrl, parent);
+        case V4L2_CTRL_TYPE_BOOLEAN:
+            return new V4L2BooleanControl(info.ctrl, parent);
+        case V4L2_CTRL_TYPE_MENU:
+        case V4L2_CTRL_TYPE_INTEGER_MENU:
+            return new V4L2MenuControl(info.ctrl, info.menu, parent);
+        case V4L2_CTRL_TYPE_BUTTON:
+            return new V4L2ButtonControl(info.ctrl, parent);
+        case V4L2_CTRL_TYPE_INTEGER64:
+            return new V4L2Integer64Control(info, parent);
+        case V4L2_CTRL_TYPE_BITMASK:
+            return new V4L2BitmaskControl(info.ctrl, parent);
+        case V4L2_CTRL_TYPE_CTRL_CLASS:
+        default:
+            return NULL;
     }
 }
 
@@ -187,9 +80,10 @@ void V4L2Control::resetToDefault()
  * V4L2IntegerControl
  */
 V4L2IntegerControl::V4L2IntegerControl
-    (int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw) :
-    V4L2Control(fd, ctrl, parent, mw),
-    minimum(ctrl.minimum), maximum(ctrl.maximum), step(ctrl.step)
+    (const struct v4l2_queryctrl &ctrl, QWidget *parent) :
+    V4L2Control(ctrl, parent),
+    minimum(ctrl.minimum), maximum(ctrl.maximum), step(ctrl.step),
+    pending(false), inFlight(false), writes(0), coalesced(0)
 {
     int pageStep = (maximum-minimum)/10;
     if(step > pageStep)
@@ -207,16 +101,56 @@ V4L2IntegerControl::V4L2IntegerControl
     defStr.setNum(default_value);
     le = new QLineEdit(this);
     le->setText(defStr);
-    le->setValidator(new QIntValidator(minimum, maximum, this));
+    validator = new QIntValidator(minimum, maximum, this);
+    le->setValidator(validator);
     this->layout.addWidget(le);
     
     QObject::connect( sl, SIGNAL(valueChanged(int)),
                       this, SLOT(SetValueFromSlider()) );
     QObject::connect( sl, SIGNAL(sliderReleased()),
-                      this, SLOT(SetValueFromSlider()) );
+                      this, SLOT(SliderReleased()) );
     QObject::connect( le, SIGNAL(returnPressed()),
                       this, SLOT(SetValueFromText()) );
-    updateStatus();
+
+    writeTimer.setSingleShot(true);
+    QObject::connect( &writeTimer, SIGNAL(timeout()),
+                      this, SLOT(flushWrite()) );
+}
+
+void V4L2IntegerControl::setMaxWriteRate(int rate)
+{
+    max_write_rate = rate < 0 ? 0 : rate;
+}
+
+int V4L2IntegerControl::maxWriteRate()
+{
+    return max_write_rate;
+}
+
+bool V4L2IntegerControl::isEditing() const
+{
+    return sl->isSliderDown() || pending;
+}
+
+void V4L2IntegerControl::setInfo(const V4L2ControlInfo &info)
+{
+    const struct v4l2_queryctrl &ctrl = info.ctrl;
+    default_value = ctrl.default_value;
+    if(ctrl.minimum == minimum && ctrl.maximum == maximum && ctrl.step == step)
+        return;
+
+    minimum = ctrl.minimum;
+    maximum = ctrl.maximum;
+    step = ctrl.step;
+
+    int pageStep = (maximum-minimum)/10;
+    if(step > pageStep)
+        pageStep = step;
+    sl->blockSignals(true);
+    sl->setRange(minimum, maximum);
+    sl->setPageStep(pageStep);
+    sl->blockSignals(false);
+    validator->setRange(minimum, maximum);
 }
 
 void V4L2IntegerControl::setValue(int val)
@@ -251,14 +185,73 @@ int V4L2IntegerControl::getValue()
 void V4L2IntegerControl::SetValueFromSlider()
 {
     setValue(sl->value());
-    updateHardware();
+    if(!sl->isSliderDown()) {
+        /* Keyboard and page steps are written right away */
+        pending = true;
+        flushWrite();
+        return;
+    }
+
+    /* A value that was never written is replaced by the newer one */
+    if(pending)
+        coalesced++;
+    pending = true;
+
+    int interval = max_write_rate > 0 ? 1000 / max_write_rate : 0;
+    if(!lastWrite.isValid() || lastWrite.elapsed() >= interval)
+        flushWrite();
+    else if(!writeTimer.isActive())
+        writeTimer.start(interval - lastWrite.elapsed());
+}
+
+void V4L2IntegerControl::SliderReleased()
+{
+    /* The value the slider stopped at always reaches the device */
+    writeTimer.stop();
+    setValue(sl->value());
+    pending = true;
+    flushWrite();
+
+    if(coalesced > 0) {
+        QString msg;
+        msg.sprintf("%s: %d writes, %d intermediate values coalesced",
+                    name, writes, coalesced);
+        emit statusMessage(msg);
+    }
+    writes = 0;
+    coalesced = 0;
+    lastWrite.invalidate();
+}
+
+/* At most one write is queued to the device worker. While it is, the
+   value stays pending and is replaced by newer ones, written() sends the
+   last of them. A device slower than the rate limit sees fewer writes
+   instead of a growing queue. */
+void V4L2IntegerControl::flushWrite()
+{
+    if(!pending || inFlight)
+        return;
+    pending = false;
+    inFlight = true;
+    writes++;
+    emit valueEdited();
+    lastWrite.start();
+}
+
+void V4L2IntegerControl::written()
+{
+    inFlight = false;
+    /* Otherwise the rate limit is still running, its timer writes */
+    if(!writeTimer.isActive())
+        flushWrite();
 }
 
 void V4L2IntegerControl::SetValueFromText()
 {
     if(le->hasAcceptableInput()) {
         setValue(le->text().toInt());
-        updateHardware();
+        pending = true;
+        flushWrite();
     } else {
         SetValueFromSlider();
     }
@@ -268,13 +261,12 @@ void V4L2IntegerControl::SetValueFromText()
  * V4L2BooleanControl
  */
 V4L2BooleanControl::V4L2BooleanControl
-    (int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw) :
-    V4L2Control(fd, ctrl, parent, mw),
+    (const struct v4l2_queryctrl &ctrl, QWidget *parent) :
+    V4L2Control(ctrl, parent),
     cb(new QCheckBox(this))
 {
     this->layout.addWidget(cb);
-    QObject::connect( cb, SIGNAL(clicked()), this, SLOT(updateHardware()) );
-    updateStatus();
+    QObject::connect( cb, SIGNAL(clicked()), this, SIGNAL(valueEdited()) );
 }
 
 void V4L2BooleanControl::setValue(int val)
@@ -291,60 +283,410 @@ int V4L2BooleanControl::getValue()
  * V4L2MenuControl
  */
 V4L2MenuControl::V4L2MenuControl
-    (int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw) :
-    V4L2Control(fd, ctrl, parent, mw)
+    (const struct v4l2_queryctrl &ctrl, const QStringList &items,
+     QWidget *parent) :
+    V4L2Control(ctrl, parent), items(items), minimum(ctrl.minimum)
 {
     cb = new QComboBox(this);
     this->layout.addWidget(cb);
-    
+    cb->addItems(items);
+    cb->setCurrentIndex(default_value - minimum);
+    QObject::connect( cb, SIGNAL(activated(int)),
+                      this, SLOT(menuActivated(int)) );
+}
+
+QStringList V4L2MenuControl::queryMenu(int fd, const struct v4l2_queryctrl &ctrl,
+                                       QStringList *warnings)
+{
+    QStringList items;
     for(int i=ctrl.minimum; i<=ctrl.maximum; i++) {
         struct v4l2_querymenu qm;
         qm.id = ctrl.id;
         qm.index = i;
-        if(v4l2_ioctl(fd, VIDIOC_QUERYMENU, &qm) == 0) {
-            cb->insertItem(i, (const char *)qm.name);
+        if(core_ioctl(fd, VIDIOC_QUERYMENU, &qm) == 0) {
+            if(ctrl.type == V4L2_CTRL_TYPE_INTEGER_MENU)
+                items.append(QString::number((qlonglong)qm.value));
+            else
+                items.append((const char *)qm.name);
         } else {
             QString msg;
             msg.sprintf("Unable to get menu item for %s, index=%d\n"
-	                "Will use Unknown", name, qm.index);
-            QMessageBox::warning(this, "Unable to get menu item", msg, "OK");
-            cb->insertItem(i, "Unknown");
+	                "Will use Unknown", ctrl.name, qm.index);
+            if(warnings)
+                warnings->append(msg);
+            else
+                QMessageBox::warning(NULL, "Unable to get menu item", msg, "OK");
+            items.append("Unknown");
         }
     }
-    cb->setCurrentIndex(default_value);
-    QObject::connect( cb, SIGNAL(activated(int)),
-                      this, SLOT(menuActivated(int)) );
-    updateStatus();
+    return items;
+}
+
+void V4L2MenuControl::setInfo(const V4L2ControlInfo &info)
+{
+    default_value = info.ctrl.default_value;
+    if(info.menu == items && info.ctrl.minimum == minimum)
+        return;
+
+    int val = getValue();
+    items = info.menu;
+    minimum = info.ctrl.minimum;
+    cb->clear();
+    cb->addItems(items);
+    setValue(val);
 }
 
 void V4L2MenuControl::setValue(int val)
 {
-    cb->setCurrentIndex(val);
+    cb->setCurrentIndex(val - minimum);
 }
 
 int V4L2MenuControl::getValue()
 {
-    return cb->currentIndex();
+    return cb->currentIndex() + minimum;
 }
 
-void V4L2MenuControl::menuActivated(int val)
+void V4L2MenuControl::menuActivated(int)
 {
-    setValue(val);
-    updateHardware();
+    emit valueEdited();
 }
 
 /*
  * V4L2ButtonControl
  */
 V4L2ButtonControl::V4L2ButtonControl
-    (int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw) :
-    V4L2Control(fd, ctrl, parent, mw)
+    (const struct v4l2_queryctrl &ctrl, QWidget *parent) :
+    V4L2Control(ctrl, parent)
 {
     QPushButton *pb = new QPushButton((const char *)ctrl.name, this);
     this->layout.addWidget(pb);
-    QObject::connect( pb, SIGNAL(clicked()), this, SLOT(updateHardware()) );
+    QObject::connect( pb, SIGNAL(clicked()), this, SIGNAL(valueEdited()) );
+}
+
+/*
+ * V4L2Integer64Control
+ */
+V4L2Integer64Control::V4L2Integer64Control
+    (const V4L2ControlInfo &info, QWidget *parent) :
+    V4L2Control(info.ctrl, parent),
+    minimum(info.ext.minimum), maximum(info.ext.maximum), step(info.ext.step),
+    value(info.ext.default_value)
+{
+    le = new QLineEdit(this);
+    le->setValidator(new QRegExpValidator(QRegExp("-?[0-9]{1,19}"), this));
+    le->setText(QString::number(value));
+    this->layout.addWidget(le);
+    QObject::connect( le, SIGNAL(returnPressed()),
+                      this, SLOT(SetValueFromText()) );
+}
+
+void V4L2Integer64Control::setInfo(const V4L2ControlInfo &info)
+{
+    minimum = info.ext.minimum;
+    maximum = info.ext.maximum;
+    step = info.ext.step;
+}
+
+bool V4L2Integer64Control::isEditing() const
+{
+    return le->isModified();
+}
+
+void V4L2Integer64Control::setValue64(qint64 val)
+{
+    if(val < minimum)
+        val = minimum;
+    if(val > maximum)
+        val = maximum;
+    if(step > 1) {
+        /* Unsigned, the range may not fit in 63 bits */
+        quint64 mod = ((quint64)val - (quint64)minimum) % step;
+        if(mod > step/2 && (quint64)maximum - (quint64)val >= step-mod) {
+            val += step-mod;
+        } else {
+            val -= mod;
+        }
+    }
+    value = val;
+    le->setText(QString::number(val));
+    le->setModified(false);
 }
 
-void V4L2ButtonControl::resetToDefault()
+void V4L2Integer64Control::SetValueFromText()
 {
+    bool ok;
+    qint64 val = le->text().toLongLong(&ok);
+    if(!ok) {
+        setValue64(value);
+        return;
+    }
+    setValue64(val);
+    emit valueEdited();
+}
+
+/*
+ * V4L2BitmaskControl
+ */
+V4L2BitmaskControl::V4L2BitmaskControl
+    (const struct v4l2_queryctrl &ctrl, QWidget *parent) :
+    V4L2Control(ctrl, parent), mask(ctrl.maximum), value(0)
+{
+    le = new QLineEdit(this);
+    le->setValidator(new QRegExpValidator(QRegExp("(0x)?[0-9a-fA-F]{1,8}"), this));
+    this->layout.addWidget(le);
+    setValue(default_value);
+    QObject::connect( le, SIGNAL(returnPressed()),
+                      this, SLOT(SetValueFromText()) );
+}
+
+void V4L2BitmaskControl::setInfo(const V4L2ControlInfo &info)
+{
+    mask = info.ctrl.maximum;
+}
+
+bool V4L2BitmaskControl::isEditing() const
+{
+    return le->isModified();
+}
+
+void V4L2BitmaskControl::setValue(int val)
+{
+    QString str;
+    value = (__u32)val & mask;
+    str.sprintf("0x%08x", value);
+    le->setText(str);
+    le->setModified(false);
+}
+
+void V4L2BitmaskControl::SetValueFromText()
+{
+    QString str = le->text();
+    bool ok;
+    if(str.startsWith("0x"))
+        str = str.mid(2);
+    __u32 val = str.toUInt(&ok, 16);
+    if(!ok) {
+        setValue(value);
+        return;
+    }
+    setValue(val);
+    emit valueEdited();
+}
+
+/*
+ * V4L2StringControl
+ */
+V4L2StringControl::V4L2StringControl
+    (const V4L2ControlInfo &info, QWidget *parent) :
+    V4L2Control(info.ctrl, parent), size(info.ext.elem_size)
+{
+    le = new QLineEdit(this);
+    le->setMaxLength(info.ext.maximum);
+    this->layout.addWidget(le);
+    QObject::connect( le, SIGNAL(returnPressed()),
+                      this, SLOT(SetValueFromText()) );
+}
+
+bool V4L2StringControl::isEditing() const
+{
+    return le->isModified();
+}
+
+void V4L2StringControl::setPayload(const char *data)
+{
+    QString str = QString::fromUtf8(data, qstrnlen(data, size));
+    if(str != le->text())
+        le->setText(str);
+    le->setModified(false);
+}
+
+bool V4L2StringControl::takeEdit(int &offset, QByteArray &data)
+{
+    if(edit.isEmpty())
+        return false;
+    offset = 0;
+    data = edit;
+    edit.clear();
+    return true;
+}
+
+void V4L2StringControl::SetValueFromText()
+{
+    /* Always NUL terminated, the rest of the buffer is left as it is */
+    edit = le->text().toUtf8().left(size - 1);
+    edit.append('\0');
+    le->setModified(false);
+    emit valueEdited();
+}
+
+/*
+ * V4L2ArrayControl
+ */
+V4L2ArrayControl::V4L2ArrayControl
+    (const V4L2ControlInfo &info, QWidget *parent) :
+    V4L2Control(info.ctrl, parent),
+    type(info.ext.type), elemSize(info.ext.elem_size), elems(info.ext.elems),
+    minimum(info.ext.minimum), maximum(info.ext.maximum),
+    payload(NULL), editOffset(0)
+{
+    QString shape;
+    for(__u32 i = 0; i < info.ext.nr_of_dims; i++) {
+        if(i)
+            shape += " x ";
+        shape += QString::number(info.ext.dims[i]);
+    }
+
+    index = new QSpinBox(this);
+    index->setRange(0, elems - 1);
+    index->setToolTip(shape.isEmpty() ? QString("Element") : "Element of " + shape);
+    index->setVisible(elems > 1);
+    this->layout.addWidget(index);
+
+    le = new QLineEdit(this);
+    if(isNumeric())
+        le->setValidator(new QRegExpValidator(QRegExp("-?[0-9]{1,20}"), this));
+    else
+        le->setValidator(new QRegExpValidator(QRegExp("([0-9a-fA-F]{2})*"), this));
+    this->layout.addWidget(le);
+
+    QObject::connect( index, SIGNAL(valueChanged(int)),
+                      this, SLOT(showElement()) );
+    QObject::connect( le, SIGNAL(returnPressed()),
+                      this, SLOT(SetValueFromText()) );
+}
+
+bool V4L2ArrayControl::isNumeric() const
+{
+    switch(type) {
+        case V4L2_CTRL_TYPE_U8:
+            return elemSize == 1;
+        case V4L2_CTRL_TYPE_U16:
+            return elemSize == 2;
+        case V4L2_CTRL_TYPE_U32:
+        case V4L2_CTRL_TYPE_INTEGER:
+        case V4L2_CTRL_TYPE_BOOLEAN:
+        case V4L2_CTRL_TYPE_MENU:
+        case V4L2_CTRL_TYPE_INTEGER_MENU:
+        case V4L2_CTRL_TYPE_BITMASK:
+            return elemSize == 4;
+        case V4L2_CTRL_TYPE_INTEGER64:
+            return elemSize == 8;
+    }
+    return false;
+}
+
+QString V4L2ArrayControl::elementText(const char *p) const
+{
+    if(!isNumeric())
+        return QByteArray(p, elemSize).toHex();
+
+    switch(type) {
+        case V4L2_CTRL_TYPE_U8: {
+            quint8 v;
+            memcpy(&v, p, sizeof(v));
+            return QString::number(v);
+        }
+        case V4L2_CTRL_TYPE_U16: {
+            quint16 v;
+            memcpy(&v, p, sizeof(v));
+            return QString::number(v);
+        }
+        case V4L2_CTRL_TYPE_U32:
+        case V4L2_CTRL_TYPE_BITMASK: {
+            quint32 v;
+            memcpy(&v, p, sizeof(v));
+            return QString::number(v);
+        }
+        case V4L2_CTRL_TYPE_INTEGER64: {
+            qint64 v;
+            memcpy(&v, p, sizeof(v));
+            return QString::number(v);
+        }
+    }
+    qint32 v;
+    memcpy(&v, p, sizeof(v));
+    return QString::number(v);
+}
+
+bool V4L2ArrayControl::parseElement(const QString &text, QByteArray &out) const
+{
+    if(!isNumeric()) {
+        out = QByteArray::fromHex(text.toLatin1());
+        return out.size() == elemSize;
+    }
+
+    bool ok;
+    qint64 val = text.toLongLong(&ok);
+    if(!ok)
+        return false;
+    if(val < minimum)
+        val = minimum;
+    if(val > maximum)
+        val = maximum;
+
+    /* Narrowed first, so that the bytes are right on any endianness */
+    quint8 v8 = val;
+    quint16 v16 = val;
+    quint32 v32 = val;
+    switch(elemSize) {
+        case 1:
+            out = QByteArray((const char *)&v8, 1);
+            break;
+        case 2:
+            out = QByteArray((const char *)&v16, 2);
+            break;
+        case 4:
+            out = QByteArray((const char *)&v32, 4);
+            break;
+        default:
+            out = QByteArray((const char *)&val, 8);
+            break;
+    }
+    return true;
+}
+
+bool V4L2ArrayControl::isEditing() const
+{
+    return le->isModified();
+}
+
+void V4L2ArrayControl::setPayload(const char *data)
+{
+    payload = data;
+    showElement();
+}
+
+void V4L2ArrayControl::showElement()
+{
+    if(!payload) {
+        le->clear();
+        return;
+    }
+    le->setText(elementText(payload + index->value() * elemSize));
+    le->setModified(false);
+}
+
+bool V4L2ArrayControl::takeEdit(int &offset, QByteArray &data)
+{
+    if(edit.isEmpty())
+        return false;
+    offset = editOffset;
+    data = edit;
+    edit.clear();
+    return true;
+}
+
+/* Only the element changes, the model writes the whole payload from the
+   buffer it already has */
+void V4L2ArrayControl::SetValueFromText()
+{
+    QByteArray bytes;
+    if(!payload || !parseElement(le->text(), bytes)) {
+        showElement();
+        return;
+    }
+    editOffset = index->value() * elemSize;
+    edit = bytes;
+    le->setModified(false);
+    emit valueEdited();
 }
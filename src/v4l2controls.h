@@ -21,84 +21,115 @@
 #include <linux/types.h>          /* for videodev2.h */
 #include <linux/videodev2.h>
 
-#ifndef V4L2_CID_IRIS_ABSOLUTE
-#define V4L2_CID_IRIS_ABSOLUTE			(V4L2_CID_CAMERA_CLASS_BASE+17)
-#define V4L2_CID_IRIS_RELATIVE			(V4L2_CID_CAMERA_CLASS_BASE+18)
-#endif
-
 #include <QHBoxLayout>
 #include <QCheckBox>
 #include <QSlider>
 #include <QComboBox>
 #include <QLineEdit>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "controlCache.h"
 
-class MainWindow;
+class QIntValidator;
+class QSpinBox;
 
+/* Editor widgets for the value column of the control view. They only
+   display and edit a value, V4L2ControlModel talks to the device. */
 class V4L2Control : public QWidget
 {
     Q_OBJECT
 public slots:
-    void updateHardware();
-    virtual void updateStatus(bool hwChanged=false);
-    virtual void resetToDefault();
     virtual void setValue(int val) = 0;
+    /* The model finished a write of control id */
+    void writeDone(__u32 id);
+
+signals:
+    /* The user changed the value, it should be written to the device */
+    void valueEdited();
+    /* Something worth a line in the status bar */
+    void statusMessage(const QString &msg);
 
 public:
     virtual int getValue() = 0;
+    /* 64 bit integers go through these, the others only need the above */
+    virtual qint64 getValue64() { return getValue(); }
+    virtual void setValue64(qint64 val) { setValue(val); }
+    /* Strings, arrays and compound controls show a payload owned by the
+       model instead of a value. An edit is handed out by takeEdit() as
+       the bytes which changed and their offset. */
+    virtual void setPayload(const char *) {}
+    virtual bool takeEdit(int &, QByteArray &) { return false; }
+    /* Called when the range or the menu of the control changed */
+    virtual void setInfo(const V4L2ControlInfo &) {};
+    /* True while the user is in the middle of changing the value, the
+       device state must not be pushed back into the editor then */
+    virtual bool isEditing() const { return false; }
+
+    static V4L2Control *create(const V4L2ControlInfo &info, QWidget *parent);
 
 protected:
-    V4L2Control(int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw);
-    int fd;
+    V4L2Control(const struct v4l2_queryctrl &ctrl, QWidget *parent);
+    /* The write of this control is done, see writeDone() */
+    virtual void written() {}
     int cid;
     int default_value;
     char name[32];
     QHBoxLayout layout;
-
-private:
-    MainWindow *mw;
-
-    /* Not pretty we use these to keep track of the value of some special
-       ctrls which impact the writability of other ctrls for queryCleanup(). */
-    static int exposure_auto;
-    static int focus_auto;
-    static int hue_auto;
-    static int whitebalance_auto;
-    void cacheValue(const struct v4l2_control &c);
-    /* This function sets various flags for well known (UVC) controls, these
-       flags should really be set by the driver, but for older driver versions
-       this does not happen. */
-    void queryCleanup(struct v4l2_queryctrl *ctrl);
 };
 
 class V4L2IntegerControl : public V4L2Control
 {
     Q_OBJECT
 public:
-    V4L2IntegerControl(int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw);
+    V4L2IntegerControl(const struct v4l2_queryctrl &ctrl, QWidget *parent);
 
 public slots:
     void setValue(int val);
 
 public:
     int getValue();
+    void setInfo(const V4L2ControlInfo &info);
+    bool isEditing() const;
+
+    /* Upper bound on the writes per second while a slider is dragged,
+       0 writes every value */
+    static void setMaxWriteRate(int rate);
+    static int maxWriteRate();
 
 private slots:
     void SetValueFromSlider(void);
     void SetValueFromText(void);
+    void SliderReleased(void);
+    void flushWrite(void);
 
 private:
+    void written();
+
     int minimum;
     int maximum;
     int step;
     QSlider *sl;
     QLineEdit *le;
+    QIntValidator *validator;
+
+    /* Slider drags are coalesced, only the latest value is written */
+    QTimer writeTimer;
+    QElapsedTimer lastWrite;
+    bool pending;
+    bool inFlight;          /* a write is queued, its result not in yet */
+    int writes;
+    int coalesced;
+
+    static int max_write_rate;
 };
 
 class V4L2BooleanControl : public V4L2Control
 {
     Q_OBJECT
 public:
-    V4L2BooleanControl(int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw);
+    V4L2BooleanControl(const struct v4l2_queryctrl &ctrl, QWidget *parent);
 
 public slots:
     void setValue(int val);
@@ -114,16 +145,25 @@ class V4L2MenuControl : public V4L2Control
 {
     Q_OBJECT
 public:
-    V4L2MenuControl(int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw);
+    V4L2MenuControl(const struct v4l2_queryctrl &ctrl, const QStringList &items,
+                    QWidget *parent);
+    /* Failures are added to warnings when given, off the GUI thread they
+       must be, otherwise they are shown right away */
+    static QStringList queryMenu(int fd, const struct v4l2_queryctrl &ctrl,
+                                 QStringList *warnings = NULL);
 
 public slots:
     void setValue(int val);
 
 public:
     int getValue();
+    void setInfo(const V4L2ControlInfo &info);
 
 private:
     QComboBox *cb;
+    /* Item k of the menu is the value minimum + k, as in the model */
+    QStringList items;
+    int minimum;
 
 private slots:
     void menuActivated(int val);
@@ -132,13 +172,122 @@ private slots:
 class V4L2ButtonControl : public V4L2Control
 {
     Q_OBJECT
+public:
+    V4L2ButtonControl(const struct v4l2_queryctrl &ctrl, QWidget *parent);
+
+public slots:
+    void setValue(int) {};
+    int getValue() { return 0; };
+};
+
+class V4L2Integer64Control : public V4L2Control
+{
+    Q_OBJECT
+public:
+    V4L2Integer64Control(const V4L2ControlInfo &info, QWidget *parent);
+
 public slots:
-    void resetToDefault();
+    void setValue(int val) { setValue64(val); }
 
 public:
-    V4L2ButtonControl(int fd, const struct v4l2_queryctrl &ctrl, QWidget *parent, MainWindow *mw);
+    int getValue() { return value; }
+    qint64 getValue64() { return value; }
+    void setValue64(qint64 val);
+    void setInfo(const V4L2ControlInfo &info);
+    bool isEditing() const;
+
+private slots:
+    void SetValueFromText(void);
+
+private:
+    qint64 minimum;
+    qint64 maximum;
+    quint64 step;
+    qint64 value;
+    QLineEdit *le;
+};
+
+class V4L2BitmaskControl : public V4L2Control
+{
+    Q_OBJECT
+public:
+    V4L2BitmaskControl(const struct v4l2_queryctrl &ctrl, QWidget *parent);
+
+public slots:
+    void setValue(int val);
+
+public:
+    int getValue() { return value; }
+    void setInfo(const V4L2ControlInfo &info);
+    bool isEditing() const;
+
+private slots:
+    void SetValueFromText(void);
+
+private:
+    __u32 mask;
+    __u32 value;
+    QLineEdit *le;
+};
+
+class V4L2StringControl : public V4L2Control
+{
+    Q_OBJECT
+public:
+    V4L2StringControl(const V4L2ControlInfo &info, QWidget *parent);
 
 public slots:
     void setValue(int) {};
+
+public:
     int getValue() { return 0; };
+    void setPayload(const char *data);
+    bool takeEdit(int &offset, QByteArray &data);
+    bool isEditing() const;
+
+private slots:
+    void SetValueFromText(void);
+
+private:
+    int size;
+    QLineEdit *le;
+    QByteArray edit;
+};
+
+/* One element at a time: an index, then the value of that element, as a
+   number for the integer types and as hex bytes for anything else */
+class V4L2ArrayControl : public V4L2Control
+{
+    Q_OBJECT
+public:
+    V4L2ArrayControl(const V4L2ControlInfo &info, QWidget *parent);
+
+public slots:
+    void setValue(int) {};
+
+public:
+    int getValue() { return 0; };
+    void setPayload(const char *data);
+    bool takeEdit(int &offset, QByteArray &data);
+    bool isEditing() const;
+
+private slots:
+    void showElement(void);
+    void SetValueFromText(void);
+
+private:
+    __u32 type;
+    int elemSize;
+    int elems;
+    qint64 minimum;
+    qint64 maximum;
+    const char *payload;
+    QSpinBox *index;
+    QLineEdit *le;
+    int editOffset;
+    QByteArray edit;
+
+    bool isNumeric() const;
+    QString elementText(const char *p) const;
+    bool parseElement(const QString &text, QByteArray &out) const;
 };
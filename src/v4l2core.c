@@ -0,0 +1,437 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <libv4l2.h>
+
+#include "v4l2core.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Controls which gate other controls of their class (the manual exposure
+   is ignored while auto exposure is on, etc.) */
+static const __u32 master_ids[] = {
+    V4L2_CID_EXPOSURE_AUTO,
+    V4L2_CID_FOCUS_AUTO,
+    V4L2_CID_HUE_AUTO,
+    V4L2_CID_AUTO_WHITE_BALANCE,
+    V4L2_CID_AUTOGAIN,
+    V4L2_CID_AUTOBRIGHTNESS,
+};
+
+const struct control_edge control_edges[] = {
+    { V4L2_CID_EXPOSURE_AUTO, V4L2_CID_EXPOSURE_ABSOLUTE },
+    { V4L2_CID_EXPOSURE_AUTO, V4L2_CID_IRIS_ABSOLUTE },
+    { V4L2_CID_EXPOSURE_AUTO, V4L2_CID_IRIS_RELATIVE },
+    { V4L2_CID_FOCUS_AUTO, V4L2_CID_FOCUS_ABSOLUTE },
+    { V4L2_CID_FOCUS_AUTO, V4L2_CID_FOCUS_RELATIVE },
+    { V4L2_CID_HUE_AUTO, V4L2_CID_HUE },
+    { V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CID_WHITE_BALANCE_TEMPERATURE },
+    { V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CID_BLUE_BALANCE },
+    { V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CID_RED_BALANCE },
+};
+const int control_edge_count = ARRAY_SIZE(control_edges);
+
+int is_master(__u32 id)
+{
+    unsigned int i;
+
+    for(i=0; i<ARRAY_SIZE(master_ids); i++) {
+        if(master_ids[i] == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int ext_ctrls(int fd, unsigned long req, struct v4l2_ext_control *c,
+              int count, __u32 *error_idx)
+{
+    struct v4l2_ext_controls ctrls;
+    int ret;
+
+    memset(&ctrls, 0, sizeof(ctrls));
+    ctrls.ctrl_class = V4L2_CTRL_ID2CLASS(c[0].id);
+    ctrls.count = count;
+    ctrls.controls = c;
+    ret = core_ioctl(fd, req, &ctrls);
+    if(error_idx) {
+        *error_idx = ctrls.error_idx;
+    }
+    return ret;
+}
+
+/*
+ * Auto modes
+ */
+void auto_modes_init(struct auto_modes *a)
+{
+    a->exposure = V4L2_EXPOSURE_MANUAL;
+    a->focus = 0;
+    a->hue = 0;
+    a->white_balance = 0;
+}
+
+int auto_modes_set(struct auto_modes *a, __u32 id, __s32 value)
+{
+    __s32 *v;
+
+    switch(id) {
+    case V4L2_CID_EXPOSURE_AUTO:
+        v = &a->exposure;
+        break;
+    case V4L2_CID_FOCUS_AUTO:
+        v = &a->focus;
+        break;
+    case V4L2_CID_HUE_AUTO:
+        v = &a->hue;
+        break;
+    case V4L2_CID_AUTO_WHITE_BALANCE:
+        v = &a->white_balance;
+        break;
+    default:
+        return 0;
+    }
+    if(*v == value) {
+        return 0;
+    }
+    *v = value;
+    return 1;
+}
+
+__u32 quirk_flags(__u32 id, __u32 flags, const struct auto_modes *a)
+{
+    switch (id) {
+    case V4L2_CID_EXPOSURE_ABSOLUTE:
+        switch (a->exposure) {
+            case V4L2_EXPOSURE_AUTO:
+            case V4L2_EXPOSURE_APERTURE_PRIORITY:
+                flags |= V4L2_CTRL_FLAG_GRABBED;
+                break;
+        }
+        break;
+
+    case V4L2_CID_IRIS_RELATIVE:
+        flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
+        /* Fall through */
+    case V4L2_CID_IRIS_ABSOLUTE:
+        switch (a->exposure) {
+            case V4L2_EXPOSURE_AUTO:
+            case V4L2_EXPOSURE_SHUTTER_PRIORITY:
+                flags |= V4L2_CTRL_FLAG_GRABBED;
+                break;
+        }
+        break;
+
+    case V4L2_CID_FOCUS_RELATIVE:
+        flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
+        /* Fall through */
+    case V4L2_CID_FOCUS_ABSOLUTE:
+        if (a->focus)
+            flags |= V4L2_CTRL_FLAG_GRABBED;
+        break;
+
+    case V4L2_CID_HUE:
+        if (a->hue)
+            flags |= V4L2_CTRL_FLAG_GRABBED;
+        break;
+
+    case V4L2_CID_WHITE_BALANCE_TEMPERATURE:
+    case V4L2_CID_BLUE_BALANCE:
+    case V4L2_CID_RED_BALANCE:
+        if (a->white_balance)
+            flags |= V4L2_CTRL_FLAG_GRABBED;
+        break;
+
+    case V4L2_CID_EXPOSURE_AUTO:
+    case V4L2_CID_FOCUS_AUTO:
+    case V4L2_CID_HUE_AUTO:
+    case V4L2_CID_AUTO_WHITE_BALANCE:
+        flags |= V4L2_CTRL_FLAG_UPDATE;
+        break;
+
+    case V4L2_CID_PAN_RELATIVE:
+    case V4L2_CID_TILT_RELATIVE:
+    case V4L2_CID_ZOOM_RELATIVE:
+        flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
+        break;
+    }
+    return flags;
+}
+
+/*
+ * Control store
+ */
+void store_init(struct control_store *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+void store_free(struct control_store *s)
+{
+    free(s->id);
+    free(s->type);
+    free(s->minimum);
+    free(s->maximum);
+    free(s->step);
+    free(s->default_value);
+    free(s->hw_flags);
+    free(s->flags);
+    free(s->value);
+    free(s->valid);
+    free(s->name);
+    store_init(s);
+}
+
+int store_find(const struct control_store *s, __u32 id)
+{
+    int i;
+
+    for(i=0; i<s->count; i++) {
+        if(s->id[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#define GROW(field) do { \
+        void *p = realloc(s->field, alloc * sizeof(*s->field)); \
+        if(!p) { \
+            return -1; \
+        } \
+        s->field = p; \
+    } while(0)
+
+static int store_grow(struct control_store *s)
+{
+    int alloc = s->alloc ? s->alloc * 2 : 64;
+
+    GROW(id);
+    GROW(type);
+    GROW(minimum);
+    GROW(maximum);
+    GROW(step);
+    GROW(default_value);
+    GROW(hw_flags);
+    GROW(flags);
+    GROW(value);
+    GROW(valid);
+    GROW(name);
+    s->alloc = alloc;
+    return 0;
+}
+
+#undef GROW
+
+int store_add(struct control_store *s, const struct v4l2_queryctrl *ctrl)
+{
+    int i = s->count;
+
+    if(i == s->alloc && store_grow(s)) {
+        return -1;
+    }
+    s->id[i] = ctrl->id;
+    s->type[i] = ctrl->type;
+    s->minimum[i] = ctrl->minimum;
+    s->maximum[i] = ctrl->maximum;
+    s->step[i] = ctrl->step;
+    s->default_value[i] = ctrl->default_value;
+    s->hw_flags[i] = ctrl->flags;
+    s->flags[i] = ctrl->flags;
+    s->value[i] = ctrl->default_value;
+    s->valid[i] = 0;
+    memcpy(s->name[i], ctrl->name, sizeof(s->name[i]));
+    s->name[i][sizeof(s->name[i])-1] = '\0';
+    s->count++;
+    return i;
+}
+
+void store_query(const struct control_store *s, int i, struct v4l2_queryctrl *ctrl)
+{
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->id = s->id[i];
+    ctrl->type = s->type[i];
+    memcpy(ctrl->name, s->name[i], sizeof(s->name[i]));
+    ctrl->minimum = s->minimum[i];
+    ctrl->maximum = s->maximum[i];
+    ctrl->step = s->step[i];
+    ctrl->default_value = s->default_value[i];
+    ctrl->flags = s->hw_flags[i];
+}
+
+int store_readable(const struct control_store *s, int i)
+{
+    if(s->hw_flags[i] & (V4L2_CTRL_FLAG_DISABLED | V4L2_CTRL_FLAG_WRITE_ONLY)) {
+        return 0;
+    }
+    switch(s->type[i]) {
+    case V4L2_CTRL_TYPE_INTEGER:
+    case V4L2_CTRL_TYPE_BOOLEAN:
+    case V4L2_CTRL_TYPE_MENU:
+    case V4L2_CTRL_TYPE_INTEGER_MENU:
+    case V4L2_CTRL_TYPE_BITMASK:
+        return 1;
+    }
+    return 0;
+}
+
+int store_enumerate(int fd, struct control_store *s)
+{
+    struct v4l2_queryctrl ctrl;
+    int i;
+
+    s->count = 0;
+    memset(&ctrl, 0, sizeof(ctrl));
+#ifdef V4L2_CTRL_FLAG_NEXT_CTRL
+    /* Try the extended control API first */
+    ctrl.id = V4L2_CTRL_FLAG_NEXT_CTRL;
+    if(0 == core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl)) {
+        do {
+            if(store_add(s, &ctrl) < 0) {
+                return -1;
+            }
+            ctrl.id |= V4L2_CTRL_FLAG_NEXT_CTRL;
+        } while(0 == core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl));
+        return s->count;
+    }
+#endif
+    /* Fall back on the standard API */
+    /* Check all the standard controls */
+    for(i=V4L2_CID_BASE; i<V4L2_CID_LASTP1; i++) {
+        ctrl.id = i;
+        if(core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0 &&
+           store_add(s, &ctrl) < 0) {
+            return -1;
+        }
+    }
+
+    /* Check any custom controls */
+    for(i=V4L2_CID_PRIVATE_BASE; ; i++) {
+        ctrl.id = i;
+        if(core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) != 0) {
+            break;
+        }
+        if(store_add(s, &ctrl) < 0) {
+            return -1;
+        }
+    }
+    return s->count;
+}
+
+/* One ioctl per run of controls of the same class, one per control for
+   the runs the driver refuses. Returns the number of failed controls. */
+static int store_io(int fd, struct control_store *s, const int *index,
+                    const __s32 *values, int n, int set)
+{
+    struct v4l2_ext_control *c;
+    struct v4l2_control ctl;
+    int *all = NULL;
+    int i, k, first, end, failed = 0, err = 0;
+
+    if(!index) {
+        all = malloc((s->count ? s->count : 1) * sizeof(*all));
+        if(!all) {
+            return n;
+        }
+        for(i=0, n=0; i<s->count; i++) {
+            if(store_readable(s, i)) {
+                all[n++] = i;
+            }
+        }
+        index = all;
+    }
+    c = calloc(n ? n : 1, sizeof(*c));
+    if(!c) {
+        free(all);
+        return n;
+    }
+    for(k=0; k<n; k++) {
+        c[k].id = s->id[index[k]];
+        c[k].value = set ? values[k] : 0;
+    }
+
+    for(first=0; first<n; first=end) {
+        for(end=first+1; end<n; end++) {
+            if(V4L2_CTRL_ID2CLASS(c[end].id) != V4L2_CTRL_ID2CLASS(c[first].id)) {
+                break;
+            }
+        }
+        if(ext_ctrls(fd, set ? VIDIOC_S_EXT_CTRLS : VIDIOC_G_EXT_CTRLS,
+                     c + first, end - first, NULL) == 0) {
+            for(k=first; k<end; k++) {
+                s->value[index[k]] = c[k].value;
+                s->valid[index[k]] = 1;
+            }
+            continue;
+        }
+        for(k=first; k<end; k++) {
+            ctl.id = c[k].id;
+            ctl.value = c[k].value;
+            if(core_ioctl(fd, set ? VIDIOC_S_CTRL : VIDIOC_G_CTRL, &ctl) == 0) {
+                s->value[index[k]] = ctl.value;
+                s->valid[index[k]] = 1;
+            } else {
+                s->valid[index[k]] = 0;
+                err = errno;
+                failed++;
+            }
+        }
+    }
+
+    free(c);
+    free(all);
+    if(failed) {
+        errno = err;
+    }
+    return failed;
+}
+
+int store_get(int fd, struct control_store *s, const int *index, int n)
+{
+    return store_io(fd, s, index, NULL, n, 0);
+}
+
+int store_set(int fd, struct control_store *s, const int *index,
+              const __s32 *values, int n)
+{
+    if(!index) {
+        return 0;
+    }
+    return store_io(fd, s, index, values, n, 1);
+}
+
+void store_apply_quirks(struct control_store *s)
+{
+    struct auto_modes a;
+    int i;
+
+    auto_modes_init(&a);
+    for(i=0; i<s->count; i++) {
+        auto_modes_set(&a, s->id[i], s->value[i]);
+    }
+    for(i=0; i<s->count; i++) {
+        s->flags[i] = quirk_flags(s->id[i], s->hw_flags[i], &a);
+    }
+}
@@ -0,0 +1,326 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef V4L2CORE_H
+#define V4L2CORE_H
+
+/* The device layer shared by v4l2ucp and v4l2ctrl: enumerating, reading
+   and writing controls, and what we know about well known controls. Plain
+   C with no Qt, for headless tools. */
+
+#include <stdio.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#ifndef V4L2_CID_IRIS_ABSOLUTE
+#define V4L2_CID_IRIS_ABSOLUTE			(V4L2_CID_CAMERA_CLASS_BASE+17)
+#define V4L2_CID_IRIS_RELATIVE			(V4L2_CID_CAMERA_CLASS_BASE+18)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The controls of one device, one array per field, in the order the
+   driver enumerates them */
+struct control_store {
+    int count;
+    int alloc;
+    __u32 *id;
+    __u32 *type;
+    __s32 *minimum;
+    __s32 *maximum;
+    __s32 *step;
+    __s32 *default_value;
+    __u32 *hw_flags;        /* as reported by the driver */
+    __u32 *flags;           /* with quirk_flags() applied */
+    __s32 *value;
+    char *valid;            /* value was read from or written to the
+                               device by the last store_get() or
+                               store_set() of the control */
+    char (*name)[32];
+};
+
+void store_init(struct control_store *s);
+void store_free(struct control_store *s);
+int store_find(const struct control_store *s, __u32 id);
+/* Append a control, returns its index or -1 when out of memory */
+int store_add(struct control_store *s, const struct v4l2_queryctrl *ctrl);
+void store_query(const struct control_store *s, int i, struct v4l2_queryctrl *ctrl);
+/* True for the enabled, readable controls with a 32 bit value */
+int store_readable(const struct control_store *s, int i);
+
+/* Enumerate every control, values are set to the defaults. Returns the
+   number of controls or -1. */
+int store_enumerate(int fd, struct control_store *s);
+/* Read or write the n controls at index with one extended control ioctl
+   per control class, going one by one when that fails. A NULL index
+   reads every readable control. Returns the number of controls which
+   failed, errno tells why the last one did; valid tells which. */
+int store_get(int fd, struct control_store *s, const int *index, int n);
+int store_set(int fd, struct control_store *s, const int *index,
+              const __s32 *values, int n);
+/* Recompute flags from hw_flags and the auto modes in value */
+void store_apply_quirks(struct control_store *s);
+
+int ext_ctrls(int fd, unsigned long req, struct v4l2_ext_control *c,
+              int count, __u32 *error_idx);
+
+/* Controls which gate others, like the auto modes */
+int is_master(__u32 id);
+
+/* The controls each well known auto mode takes over */
+struct control_edge {
+    __u32 master;
+    __u32 dependent;
+};
+extern const struct control_edge control_edges[];
+extern const int control_edge_count;
+
+struct auto_modes {
+    __s32 exposure;
+    __s32 focus;
+    __s32 hue;
+    __s32 white_balance;
+};
+
+void auto_modes_init(struct auto_modes *a);
+/* Returns 1 when id is one of the auto modes and its value changed */
+int auto_modes_set(struct auto_modes *a, __u32 id, __s32 value);
+/* The flags of well known (UVC) controls, these should really be set by
+   the driver, but older drivers do not */
+__u32 quirk_flags(__u32 id, __u32 flags, const struct auto_modes *a);
+
+/* v4l2stats.c: v4l2_ioctl() counting every call and its latency, per
+   ioctl and control, in a fixed table updated with atomic operations.
+   Cheap enough to be always on. Batches of extended controls are
+   recorded under their control class. */
+#define STAT_BUCKETS 24     /* below 1 us, 2 us, 4 us ... 2^23 us, more */
+
+struct ioctl_stat {
+    unsigned long request;
+    __u32 id;               /* 0 for ioctls not about one control */
+    unsigned long count;
+    unsigned long errors;
+    unsigned long long total_ns;
+    unsigned long long max_ns;
+    unsigned long buckets[STAT_BUCKETS];
+};
+
+int core_ioctl(int fd, unsigned long request, void *arg);
+/* Copy up to max entries, returns how many there are */
+int stats_snapshot(struct ioctl_stat *out, int max);
+void stats_reset(void);
+const char *ioctl_name(unsigned long request);
+/* The latency below which the given fraction of the calls completed */
+unsigned long long stats_percentile(const struct ioctl_stat *st, double fraction);
+void stats_print(FILE *file);
+
+/* v4l2stream.c: capturing in the current format of the device into
+   buffers mapped from the driver, for a preview without copies. The fd
+   is the stream's own, opened non blocking. */
+#define STREAM_MAX_BUFFERS 8
+
+struct stream {
+    int fd;
+    struct v4l2_pix_format pix;
+    int count;
+    void *start[STREAM_MAX_BUFFERS];
+    size_t length[STREAM_MAX_BUFFERS];
+};
+
+/* Open the device, map count buffers and start streaming. Returns -1
+   with errno set when any step fails, nothing is left open then. */
+int stream_open(struct stream *s, const char *device, int count);
+/* Wait up to timeout ms for a frame, returns the index of its buffer or
+   -1, errno is EAGAIN when none came. The buffer belongs to the caller
+   until stream_queue() gives it back to the driver. */
+int stream_dequeue(struct stream *s, int timeout, __u32 *bytesused);
+/* The same with the whole buffer: sequence, timestamp and flags */
+int stream_dequeue_buffer(struct stream *s, int timeout, struct v4l2_buffer *buf);
+int stream_queue(struct stream *s, int index);
+void stream_close(struct stream *s);
+
+/* v4l2frame.c: YUV and grey frames to 32 bit 0xffRRGGBB pixels, BT.601
+   limited range with 6 bit fixed point coefficients. SSE2 and AVX2
+   kernels are chosen at run time, they give the same bytes as the
+   scalar one. */
+enum frame_kernel {
+    FRAME_AUTO,             /* the best the CPU supports */
+    FRAME_SCALAR,
+    FRAME_SSE2,
+    FRAME_AVX2,
+    FRAME_KERNELS
+};
+
+int frame_convertible(__u32 pixelformat);
+const char *frame_kernel_name(int kernel);
+int frame_kernel_supported(int kernel);
+/* Convert a whole frame of pix's format and size, dst_stride in bytes,
+   split into bands of rows over threads threads, 0 to choose */
+void frame_convert(const struct v4l2_pix_format *pix, const unsigned char *src,
+                   unsigned char *dst, int dst_stride, int kernel, int threads);
+/* The same with the best kernel and threads for the machine */
+void frame_to_rgb32(const struct v4l2_pix_format *pix, const unsigned char *src,
+                    unsigned char *dst, int dst_stride);
+
+/* v4l2analysis.c: what the controls do to the picture, on frames of
+   0xffRRGGBB pixels (V4L2_PIX_FMT_BGR32 in memory), RGB24 or GREY. The
+   SSE2 and AVX2 kernels of the first give the scalar kernel's counts. */
+enum frame_channel {
+    FRAME_RED,
+    FRAME_GREEN,
+    FRAME_BLUE,
+    FRAME_LUMA
+};
+
+struct frame_stats {
+    __u32 histogram[256];   /* luma, (38 R + 75 G + 15 B + 64) >> 7 */
+    __u32 pixels;           /* the pixels looked at */
+    __u32 clipped;          /* with a channel at 255 */
+    __u64 sum[3];           /* of red, green and blue */
+};
+
+/* Every row_step'th row of the frame, with the kernel of enum
+   frame_kernel. Returns -1 for other pixel formats. */
+int frame_stats_collect(const unsigned char *p, int width, int height, int stride,
+                        __u32 pixelformat, int row_step, int kernel, struct frame_stats *st);
+double frame_stats_mean(const struct frame_stats *st, int channel);
+
+/* A rectangle of the frame, in pixels */
+struct frame_roi {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/* Focus: the variance of the 4 neighbour Laplacian inside roi, the whole
+   frame when NULL. It is taken of the green channel of the RGB layouts,
+   which carries most of the detail, and of the grey level of GREY. It
+   grows as the picture gets sharper. Returns -1 for other formats. */
+double frame_sharpness(const unsigned char *p, int width, int height, int stride,
+                       __u32 pixelformat, const struct frame_roi *roi, int kernel);
+
+/* v4l2tune.c: exposure and white balance in software, for cameras with
+   poor or no auto modes of their own. The tuner looks at the statistics
+   of every frame and only decides: the caller writes what it returns,
+   one S_EXT_CTRLS per control class, and keeps the values of ctrl up to
+   date when others change them. After a write it skips the frames which
+   cannot show it yet, so it does not chase its own old frames. */
+enum tune_control_index {
+    TUNE_EXPOSURE,
+    TUNE_GAIN,
+    TUNE_RED,
+    TUNE_BLUE,
+    TUNE_TEMPERATURE,
+    TUNE_EXPOSURE_AUTO,
+    TUNE_AUTOGAIN,
+    TUNE_AUTO_WHITE_BALANCE,
+    TUNE_CONTROLS
+};
+
+struct tune_control {
+    __u32 id;               /* 0 when the camera does not have it */
+    __s32 value;
+    __s32 minimum;
+    __s32 maximum;
+    __s32 step;
+};
+
+struct tuner {
+    /* Settings, tuner_init() sets the defaults */
+    int exposure;           /* tune exposure and gain */
+    int white_balance;      /* tune the balances or the temperature */
+    double target;          /* mean luma, 0-255 */
+    double tolerance;       /* of the mean luma */
+    double gray_tolerance;  /* of red/green and blue/green, 0.05 is 5% */
+    int delay;              /* frames from a write to one showing it,
+                               too few makes the tuner oscillate */
+    int max_frames;         /* a convergence taking longer is logged */
+    FILE *log;              /* every adjustment and convergence, or NULL */
+
+    struct tune_control ctrl[TUNE_CONTROLS];
+
+    /* State */
+    int frame;
+    int settle;             /* frames left to skip */
+    int start;              /* frame the current convergence began, -1 */
+    double start_ms;
+    int missed;
+    int adjustments;        /* of the current convergence */
+    int ioctls;
+    /* The last convergence, converged counts them */
+    int converged;
+    int converge_frames;
+    double converge_ms;
+};
+
+void tuner_init(struct tuner *t);
+/* Offer a control, returns 1 when the tuner uses it */
+int tuner_add_control(struct tuner *t, const struct v4l2_queryctrl *q, __s32 value);
+/* Look at one frame taken at ms. Returns the number of controls to
+   write, at most TUNE_CONTROLS, with their ids and values ordered by
+   control class. */
+int tuner_frame(struct tuner *t, const struct frame_stats *st, double ms,
+                __u32 *ids, __s32 *values);
+
+/* Focus sweep: steps through the focus range writing one value a frame
+   while capturing, instead of waiting for each value to settle. The
+   sharpness of every frame is credited to the value written delay
+   frames before it. A coarse pass over the whole range is followed by a
+   fine one around its best. */
+#define FOCUS_STEPS 32          /* values of one pass, at most */
+
+enum focus_action {
+    FOCUS_IDLE,             /* nothing to write */
+    FOCUS_WRITE,            /* write the value */
+    FOCUS_DONE              /* write the value, the sharpest, and stop */
+};
+
+struct focus_sweep {
+    /* Settings, focus_sweep_init() sets the defaults */
+    int delay;              /* frames from a write to one showing it */
+    int settle;             /* more frames for the jump to a pass' start */
+    FILE *log;              /* every pass, or NULL */
+
+    struct tune_control focus;
+
+    /* State */
+    int pass;               /* 0 coarse, 1 fine */
+    int steps;              /* values of the pass: first + i * stride */
+    __s32 first;
+    __s32 stride;
+    int frame;              /* of the pass */
+    int frames;             /* of the whole sweep */
+    double score[FOCUS_STEPS];
+    __s32 best;
+    double best_score;
+};
+
+/* q is the absolute focus control */
+void focus_sweep_init(struct focus_sweep *f, const struct v4l2_queryctrl *q, __s32 value);
+/* Look at the sharpness of one frame, returns an enum focus_action */
+int focus_sweep_frame(struct focus_sweep *f, double sharpness, __s32 *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -29,111 +29,502 @@
 #include <linux/videodev2.h>
 #include <libv4l2.h>
 
-#define FORMATW "%u:%31s:%d\n"
-#define FORMATR "%u:%31c:%d\n"
+#include "v4l2ctrl.h"
 
 void usage(const char *argv0)
 {
     printf("Usage: %s [-d device] -s filename\n", argv0);
-    printf("       %s [-d device] -l filename\n", argv0);
+    printf("       %s [-d device] [-a] [-m] -l filename\n", argv0);
+    printf("       %s [-d device | -k identity] [-a] [-m] -L library -p preset\n", argv0);
+    printf("       %s [-d device | -k identity] -L library -p preset -i|-o filename\n", argv0);
+    printf("       %s -L library -t\n", argv0);
+    printf("       %s -D config [-u socket]\n", argv0);
+    printf("       %s [-d device]... [-j jobs] -s pattern\n", argv0);
+    printf("       %s [-d device]... [-j jobs] [-a] [-m] -l filename | -c config |\n", argv0);
+    printf("          -L library -p preset\n");
+    printf("       %s [-d device] -T control [-V value,value] [-n changes]\n", argv0);
+    printf("          [-r results]\n");
     printf("       %s -h\n", argv0);
+    printf("--stats to print the count and latency of every ioctl made to\n");
+    printf("   stderr on exit. Can be added to any of the above.\n");
     printf("-s to save settings to filename\n");
     printf("-l to load settings from filename\n");
+    printf("-a to load all settings at once, restoring the previous ones\n");
+    printf("   if any of them cannot be applied.\n");
+    printf("-m to read the device first and only write the controls whose\n");
+    printf("   value differs, printing how many were written, skipped or\n");
+    printf("   failed.\n");
     printf("-d to specify the device name to use. Defaults to /dev/video0.\n");
+    printf("-L to use a profile library, which holds many presets for many\n");
+    printf("   devices. Without -i, -o or -t the preset is applied.\n");
+    printf("-p to specify the name of the preset in the library.\n");
+    printf("-k to specify the device identity of the preset. Defaults to\n");
+    printf("   the card name of the device.\n");
+    printf("-i to add filename to the library as the preset, replacing it.\n");
+    printf("-o to write the preset to filename.\n");
+    printf("-t to list the presets of the library.\n");
+    printf("-D to keep running and apply the profiles listed in config to\n");
+    printf("   every matching device as it appears, restoring controls\n");
+    printf("   somebody else changes. Each line of config is a profile\n");
+    printf("   file followed by device=, card=, bus_info= or driver=.\n");
+    printf("-u to read device events from a local datagram socket instead\n");
+    printf("   of the kernel, in the kernel uevent format.\n");
+    printf("-j to save or load many devices at once, using up to jobs\n");
+    printf("   threads. This is also done for more than one -d, for a\n");
+    printf("   device name with wildcards or for -c. Without -d every\n");
+    printf("   /dev/video* is used. When saving, %%n in pattern is replaced\n");
+    printf("   by the device node name, %%b by the bus_info, %%c by the card\n");
+    printf("   name and %%d by the driver.\n");
+    printf("-c to load every device with the profile matching it in\n");
+    printf("   config, in the format of -D.\n");
+    printf("-T to measure how many frames and ms the device takes to show a\n");
+    printf("   change of control, given by name or id, while streaming in\n");
+    printf("   its current format. The control is toggled between two values\n");
+    printf("   and the distribution of the latency is printed.\n");
+    printf("-V to specify the two values, by default a quarter and three\n");
+    printf("   quarters of the range of the control.\n");
+    printf("-n to specify the number of changes. Defaults to 20.\n");
+    printf("-r to also keep the result in the file results, one line per\n");
+    printf("   card name, control and format, to compare devices.\n");
     printf("-h to print this message.\n");
 }
 
-int do_save(int fd, FILE *file)
+/* Group by control class, masters first, otherwise keep the file order */
+static int setting_cmp(const void *a, const void *b)
+{
+    const struct setting *sa = a, *sb = b;
+    __u32 ca = V4L2_CTRL_ID2CLASS(sa->id), cb = V4L2_CTRL_ID2CLASS(sb->id);
+
+    if(ca != cb) {
+        return ca < cb ? -1 : 1;
+    }
+    if(is_master(sa->id) != is_master(sb->id)) {
+        return is_master(sa->id) ? -1 : 1;
+    }
+    return sa->order - sb->order;
+}
+
+/* Number of entries starting at first which belong to the same class */
+static int class_size(const struct v4l2_ext_control *c, int first, int count)
 {
     int i;
-    struct v4l2_queryctrl ctrl;
-    struct v4l2_control c;
-    
-#ifdef V4L2_CTRL_FLAG_NEXT_CTRL
-    /* Try the extended control API first */
-    ctrl.id = V4L2_CTRL_FLAG_NEXT_CTRL;
-    if(0 == v4l2_ioctl (fd, VIDIOC_QUERYCTRL, &ctrl)) {
-	do {
-	    c.id = ctrl.id;
-            ctrl.id |= V4L2_CTRL_FLAG_NEXT_CTRL;
-            if(ctrl.flags & V4L2_CTRL_FLAG_DISABLED) {
-                continue;
+
+    for(i=first+1; i<count; i++) {
+        if(V4L2_CTRL_ID2CLASS(c[i].id) != V4L2_CTRL_ID2CLASS(c[first].id)) {
+            break;
+        }
+    }
+    return i - first;
+}
+
+static int hexval(char c)
+{
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Parse the value part of a line, returns 0 on success */
+static int parse_value(const char *v, struct setting *s)
+{
+    char *end;
+    size_t len = strlen(v), i;
+    int hi, lo;
+
+    s->data = NULL;
+    s->size = 0;
+    if(*v == '"') {
+        s->kind = SETTING_STRING;
+        s->data = malloc(len);
+        if(!s->data) {
+            return -1;
+        }
+        for(v++; *v && *v != '"'; v++) {
+            if(*v == '\\' && v[1] == 'x' &&
+               (hi = hexval(v[2])) >= 0 && (lo = hexval(v[3])) >= 0) {
+                s->data[s->size++] = hi << 4 | lo;
+                v += 3;
+            } else if(*v == '\\' && v[1]) {
+                s->data[s->size++] = *++v;
+            } else {
+                s->data[s->size++] = *v;
             }
-            if(ctrl.type != V4L2_CTRL_TYPE_INTEGER &&
-               ctrl.type != V4L2_CTRL_TYPE_BOOLEAN &&
-               ctrl.type != V4L2_CTRL_TYPE_MENU) {
-                continue;
+        }
+        if(*v != '"' || v[1]) {
+            return -1;
+        }
+        s->data[s->size++] = 0;
+    } else if(*v == '#') {
+        s->kind = SETTING_PAYLOAD;
+        s->data = malloc(len / 2 + 1);
+        if(!s->data || (len - 1) % 2) {
+            return -1;
+        }
+        for(i=1; i<len; i+=2) {
+            hi = hexval(v[i]);
+            lo = hexval(v[i+1]);
+            if(hi < 0 || lo < 0) {
+                return -1;
             }
-            if(v4l2_ioctl(fd, VIDIOC_G_CTRL, &c) == 0) {
-                fprintf(file, FORMATW, c.id, ctrl.name, c.value);
-            }
-	} while(0 == v4l2_ioctl (fd, VIDIOC_QUERYCTRL, &ctrl));
-    } else
-#endif
-    {
-        /* Check all the standard controls */
-        for(i=V4L2_CID_BASE; i<V4L2_CID_LASTP1; i++) {
-            ctrl.id = i;
-            if(v4l2_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0) {
-                if(ctrl.flags & V4L2_CTRL_FLAG_DISABLED) {
-                    continue;
-                }
-                if(ctrl.type != V4L2_CTRL_TYPE_INTEGER &&
-                   ctrl.type != V4L2_CTRL_TYPE_BOOLEAN &&
-                   ctrl.type != V4L2_CTRL_TYPE_MENU) {
-                    continue;
-                }
-                c.id = i;
-                if(v4l2_ioctl(fd, VIDIOC_G_CTRL, &c) == 0) {
-                    fprintf(file, FORMATW, i, ctrl.name, c.value);
-                }
+            s->data[s->size++] = hi << 4 | lo;
+        }
+    } else {
+        errno = 0;
+        s->value = strtoll(v, &end, 10);
+        if(errno || end == v) {
+            return -1;
+        }
+        if(*end == 'L') {
+            s->kind = SETTING_INT64;
+            end++;
+        } else {
+            s->kind = SETTING_INT;
+            if(s->value != (__s32)s->value) {
+                return -1;
+            }
+        }
+        if(*end) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void free_settings(struct setting *s, int count)
+{
+    int i;
+
+    for(i=0; i<count; i++) {
+        free(s[i].data);
+    }
+    free(s);
+}
+
+int read_settings(FILE *file, struct setting **settings)
+{
+    struct setting *s = NULL, *tmp;
+    int count = 0, alloc = 0;
+    char *line = NULL, *n, *v;
+    size_t linesize = 0;
+    ssize_t len;
+    unsigned long id;
+
+    while((len = getline(&line, &linesize, file)) > 0) {
+        if(line[len-1] == '\n') {
+            line[--len] = 0;
+        }
+        /* Blank lines and comments, as fscanf() skipped whitespace */
+        n = line + strspn(line, " \t\r");
+        if(!*n || *n == '#') {
+            continue;
+        }
+        if(count == alloc) {
+            alloc = alloc ? alloc * 2 : 32;
+            tmp = realloc(s, alloc * sizeof(*s));
+            if(!tmp) {
+                fprintf(stderr, "Out of memory\n");
+                goto fail;
             }
+            s = tmp;
+        }
+
+        id = strtoul(line, &n, 10);
+        if(n == line || *n != ':' || strlen(n) < NAME_WIDTH + 2 ||
+           n[NAME_WIDTH + 1] != ':') {
+            fprintf(stderr, "Error reading from file\n");
+            goto fail;
+        }
+        n++;
+        v = n + NAME_WIDTH;
+        *v++ = 0;
+        while(*n == ' ') {
+            n++;
+        }
+        s[count].id = id;
+        s[count].order = count;
+        strcpy(s[count].name, n);
+        if(parse_value(v, &s[count])) {
+            fprintf(stderr, "Invalid value for control %s\n", n);
+            free(s[count].data);
+            goto fail;
+        }
+        count++;
+    }
+
+    if(!feof(file)) {
+        fprintf(stderr, "Error reading from file\n");
+        goto fail;
+    }
+
+    free(line);
+    *settings = s;
+    return count;
+
+fail:
+    free(line);
+    free_settings(s, count);
+    return -1;
+}
+
+/* Fill an extended control from a setting of the profile */
+void setting_to_ext(const struct setting *s, struct v4l2_ext_control *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->id = s->id;
+    switch(s->kind) {
+    case SETTING_INT:
+        c->value = s->value;
+        break;
+    case SETTING_INT64:
+        c->value64 = s->value;
+        break;
+    case SETTING_STRING:
+        c->string = s->data;
+        c->size = s->size;
+        break;
+    case SETTING_PAYLOAD:
+        c->ptr = s->data;
+        c->size = s->size;
+        break;
+    }
+}
+
+/* Point the payload controls of c (those with a size) at one buffer */
+static int assign_payloads(struct v4l2_ext_control *c, int count, char **buf)
+{
+    size_t total = 0, off = 0;
+    char *tmp;
+    int i;
+
+    for(i=0; i<count; i++) {
+        total += c[i].size;
+    }
+    tmp = realloc(*buf, total ? total : 1);
+    if(!tmp) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    *buf = tmp;
+    for(i=0; i<count; i++) {
+        if(c[i].size) {
+            c[i].ptr = *buf + off;
+            off += c[i].size;
+        }
+    }
+    return 0;
+}
+
+static void write_string(FILE *file, const char *str)
+{
+    const unsigned char *p;
+
+    fputc('"', file);
+    for(p=(const unsigned char *)str; *p; p++) {
+        if(*p == '"' || *p == '\\') {
+            fprintf(file, "\\%c", *p);
+        } else if(*p < ' ' || *p > '~') {
+            fprintf(file, "\\x%02x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void write_payload(FILE *file, const void *data, __u32 size)
+{
+    const unsigned char *p = data;
+    __u32 i;
+
+    fputc('#', file);
+    for(i=0; i<size; i++) {
+        fprintf(file, "%02x", p[i]);
+    }
+}
+
+static void write_value(FILE *file, const struct v4l2_query_ext_ctrl *q,
+                        const struct v4l2_ext_control *c)
+{
+    if(!(q->flags & V4L2_CTRL_FLAG_HAS_PAYLOAD)) {
+        if(q->type == V4L2_CTRL_TYPE_INTEGER64) {
+            fprintf(file, FORMATH "%lldL\n", q->id, q->name,
+                    (long long)c->value64);
+        } else {
+            fprintf(file, FORMATW, q->id, q->name, c->value);
         }
+        return;
+    }
 
-        /* Check any custom controls */
-        for(i=V4L2_CID_PRIVATE_BASE; ; i++) {
-            ctrl.id = i;
-            if(v4l2_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0) {
-                if(ctrl.flags & V4L2_CTRL_FLAG_DISABLED) {
-                    continue;
+    fprintf(file, FORMATH, q->id, q->name);
+    if(q->type == V4L2_CTRL_TYPE_STRING) {
+        write_string(file, c->string);
+    } else {
+        write_payload(file, c->ptr, c->size);
+    }
+    fputc('\n', file);
+}
+
+/* The same line as do_save_ext() writes, from a parsed setting */
+void write_setting(FILE *file, const struct setting *s)
+{
+    switch(s->kind) {
+    case SETTING_INT:
+        fprintf(file, FORMATW, s->id, s->name, (int)s->value);
+        break;
+    case SETTING_INT64:
+        fprintf(file, FORMATH "%lldL\n", s->id, s->name, (long long)s->value);
+        break;
+    case SETTING_STRING:
+        fprintf(file, FORMATH, s->id, s->name);
+        write_string(file, s->data);
+        fputc('\n', file);
+        break;
+    case SETTING_PAYLOAD:
+        fprintf(file, FORMATH, s->id, s->name);
+        write_payload(file, s->data, s->size);
+        fputc('\n', file);
+        break;
+    }
+}
+
+int do_save(int fd, FILE *file)
+{
+    struct control_store s;
+    int i;
+
+    store_init(&s);
+    if(store_enumerate(fd, &s) < 0) {
+        fprintf(stderr, "Out of memory\n");
+        store_free(&s);
+        return EXIT_FAILURE;
+    }
+    /* Controls which cannot be read are left out */
+    store_get(fd, &s, NULL, 0);
+    for(i=0; i<s.count; i++) {
+        if(s.type[i] != V4L2_CTRL_TYPE_INTEGER &&
+           s.type[i] != V4L2_CTRL_TYPE_BOOLEAN &&
+           s.type[i] != V4L2_CTRL_TYPE_MENU) {
+            continue;
+        }
+        if(store_readable(&s, i) && s.valid[i]) {
+            fprintf(file, FORMATW, s.id[i], s.name[i], s.value[i]);
+        }
+    }
+    store_free(&s);
+    return EXIT_SUCCESS;
+}
+
+/* Enumerate with VIDIOC_QUERY_EXT_CTRL and read the values with one
+   VIDIOC_G_EXT_CTRLS per class. This covers every control type; payloads
+   are read into a single buffer large enough for the biggest class. */
+int do_save_ext(int fd, FILE *file)
+{
+    struct v4l2_query_ext_ctrl *q = NULL, *tmpq, qc;
+    struct v4l2_ext_control *c = NULL;
+    char *buf = NULL;
+    int count = 0, alloc = 0, first, n, i, ret = EXIT_FAILURE;
+    size_t size, classsize = 0, bufsize = 0;
+
+    memset(&qc, 0, sizeof(qc));
+    qc.id = V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    if(core_ioctl(fd, VIDIOC_QUERY_EXT_CTRL, &qc) != 0) {
+        /* Older kernel without VIDIOC_QUERY_EXT_CTRL, or no controls */
+        return do_save(fd, file);
+    }
+    do {
+        if(count && V4L2_CTRL_ID2CLASS(qc.id) !=
+                    V4L2_CTRL_ID2CLASS(q[count-1].id)) {
+            classsize = 0;
+        }
+        if(!(qc.flags & (V4L2_CTRL_FLAG_DISABLED |
+                         V4L2_CTRL_FLAG_WRITE_ONLY)) &&
+           qc.type != V4L2_CTRL_TYPE_CTRL_CLASS &&
+           qc.type != V4L2_CTRL_TYPE_BUTTON) {
+            if(count == alloc) {
+                alloc = alloc ? alloc * 2 : 32;
+                tmpq = realloc(q, alloc * sizeof(*q));
+                if(!tmpq) {
+                    fprintf(stderr, "Out of memory\n");
+                    goto out;
                 }
-                if(ctrl.type != V4L2_CTRL_TYPE_INTEGER &&
-                   ctrl.type != V4L2_CTRL_TYPE_BOOLEAN &&
-                   ctrl.type != V4L2_CTRL_TYPE_MENU) {
-                    continue;
+                q = tmpq;
+            }
+            q[count++] = qc;
+            if(qc.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD) {
+                classsize += qc.elem_size * qc.elems;
+                if(classsize > bufsize) {
+                    bufsize = classsize;
                 }
-                c.id = i;
-                if(v4l2_ioctl(fd, VIDIOC_G_CTRL, &c) == 0) {
-                    fprintf(file, FORMATW, i, ctrl.name, c.value);
+            }
+        }
+        qc.id |= V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    } while(core_ioctl(fd, VIDIOC_QUERY_EXT_CTRL, &qc) == 0);
+
+    c = calloc(count ? count : 1, sizeof(*c));
+    buf = malloc(bufsize ? bufsize : 1);
+    if(!c || !buf) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+    for(i=0; i<count; i++) {
+        c[i].id = q[i].id;
+    }
+
+    for(first=0; first<count; first+=n) {
+        n = class_size(c, first, count);
+        size = 0;
+        for(i=first; i<first+n; i++) {
+            if(q[i].flags & V4L2_CTRL_FLAG_HAS_PAYLOAD) {
+                c[i].size = q[i].elem_size * q[i].elems;
+                c[i].ptr = buf + size;
+                size += c[i].size;
+            }
+        }
+
+        if(ext_ctrls(fd, VIDIOC_G_EXT_CTRLS, c + first, n, NULL) == 0) {
+            for(i=first; i<first+n; i++) {
+                write_value(file, &q[i], &c[i]);
+            }
+        } else {
+            /* Something in this class cannot be read, do it one by one and
+               skip the failing controls */
+            for(i=first; i<first+n; i++) {
+                if(ext_ctrls(fd, VIDIOC_G_EXT_CTRLS, c + i, 1, NULL) == 0) {
+                    write_value(file, &q[i], &c[i]);
                 }
-            } else {
-                break;
             }
         }
     }
-    
-    return 0;
+    ret = EXIT_SUCCESS;
+
+out:
+    free(q);
+    free(c);
+    free(buf);
+    return ret;
 }
 
-int do_load(int fd, FILE *file)
+/* Apply the settings one control at a time, in the order given */
+int load_settings(int fd, const struct setting *settings, int count)
 {
-    __u32 id;
-    __s32 value;
     struct v4l2_queryctrl ctrl;
     struct v4l2_control c;
-    char name[sizeof(ctrl.name)], *n;
-    
-    name[sizeof(ctrl.name)-1] = 0;
-    while(fscanf(file, FORMATR, &id, name, &value) == 3) {
-	n = name;
-        while(*n == ' ') {
-            n++;
-        }
-        ctrl.id = id;
-        if(v4l2_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0) {
-            if(strcmp((char *)ctrl.name, n)) {
+    int i, ret = EXIT_SUCCESS;
+
+    for(i=0; i<count; i++) {
+        ctrl.id = settings[i].id;
+        if(core_ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0) {
+            if(strcmp((char *)ctrl.name, settings[i].name)) {
                 fprintf(stderr, "Control name mismatch\n");
-                return EXIT_FAILURE;
+                ret = EXIT_FAILURE;
+                break;
             }
             
             if(ctrl.flags & (V4L2_CTRL_FLAG_READ_ONLY |
@@ -143,58 +534,635 @@ int do_load(int fd, FILE *file)
             }
             if(ctrl.type != V4L2_CTRL_TYPE_INTEGER &&
                ctrl.type != V4L2_CTRL_TYPE_BOOLEAN &&
-               ctrl.type != V4L2_CTRL_TYPE_MENU) {
+               ctrl.type != V4L2_CTRL_TYPE_MENU &&
+               ctrl.type != V4L2_CTRL_TYPE_INTEGER_MENU &&
+               ctrl.type != V4L2_CTRL_TYPE_BITMASK) {
+                continue;
+            }
+            if(settings[i].kind != SETTING_INT) {
                 continue;
             }
             
-            c.id = id;
-            c.value = value;
-            if(v4l2_ioctl(fd, VIDIOC_S_CTRL, &c) != 0) {
+            c.id = settings[i].id;
+            c.value = settings[i].value;
+            if(core_ioctl(fd, VIDIOC_S_CTRL, &c) != 0) {
                 fprintf(stderr, "Failed to set control \"%s\": %s\n",
                         ctrl.name, strerror(errno));
                 continue;
             }
         } else {
             fprintf(stderr, "Error querying control %s: %s\n",
-                    n, strerror(errno));
+                    settings[i].name, strerror(errno));
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+    return ret;
+}
+
+int do_load(int fd, FILE *file)
+{
+    struct setting *settings;
+    int count, ret;
+
+    count = read_settings(file, &settings);
+    if(count < 0) {
+        return EXIT_FAILURE;
+    }
+    ret = load_settings(fd, settings, count);
+    free_settings(settings, count);
+    return ret;
+}
+
+/* Write back the snapshot of every class up to (not including) end */
+static void rollback(int fd, struct v4l2_ext_control *saved, int end)
+{
+    int first, n;
+
+    for(first=0; first<end; first+=n) {
+        n = class_size(saved, first, end);
+        if(ext_ctrls(fd, VIDIOC_S_EXT_CTRLS, saved + first, n, NULL) != 0) {
+            fprintf(stderr, "Failed to restore previous settings: %s\n",
+                    strerror(errno));
+        }
+    }
+}
+
+/* Validate and apply the settings with one VIDIOC_TRY_EXT_CTRLS and one
+   VIDIOC_S_EXT_CTRLS per control class. The current values are read
+   beforehand so that a failure half way through leaves the device as it
+   was. The settings themselves are left untouched. */
+int load_settings_atomic(int fd, const struct setting *profile, int total)
+{
+    struct setting *settings = NULL;
+    struct v4l2_ext_control *values = NULL, *saved = NULL;
+    char *snapshot = NULL;
+    int i, count = total, first, n, retries, ret = EXIT_FAILURE;
+    __u32 idx;
+
+    if(count == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    /* Sorted and pruned copy, the payloads still belong to the profile */
+    settings = malloc(count * sizeof(*settings));
+    values = calloc(count, sizeof(*values));
+    saved = calloc(count, sizeof(*saved));
+    if(!settings || !values || !saved) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+    memcpy(settings, profile, count * sizeof(*settings));
+    qsort(settings, count, sizeof(*settings), setting_cmp);
+    for(i=0; i<count; i++) {
+        setting_to_ext(&settings[i], &values[i]);
+    }
+
+    /* Validate, dropping the controls the driver refuses to take */
+    for(first=0; first<count; first+=n) {
+        n = class_size(values, first, count);
+        while(n > 0 &&
+              ext_ctrls(fd, VIDIOC_TRY_EXT_CTRLS, values + first, n, &idx)) {
+            if(idx >= (__u32)n) {
+                /* Not a problem with a particular control, this driver
+                   does not handle extended controls for this class */
+                free(settings);
+                free(values);
+                free(saved);
+                return load_settings(fd, profile, total);
+            }
+            /* Read only controls are silently skipped, like do_load() does */
+            if(errno != EACCES) {
+                fprintf(stderr, "Skipping control \"%s\": %s\n",
+                        settings[first+idx].name, strerror(errno));
+            }
+            i = first + idx;
+            memmove(settings + i, settings + i + 1,
+                    (count - i - 1) * sizeof(*settings));
+            memmove(values + i, values + i + 1,
+                    (count - i - 1) * sizeof(*values));
+            count--;
+            n--;
+        }
+    }
+
+    for(i=0; i<count; i++) {
+        saved[i].id = values[i].id;
+        saved[i].size = values[i].size;
+    }
+    /* A current string may be longer than the one we are about to set,
+       the driver then tells us the size it needs */
+    for(retries=0; ; retries++) {
+        if(assign_payloads(saved, count, &snapshot)) {
+            goto out;
+        }
+        for(first=0; first<count; first+=n) {
+            n = class_size(saved, first, count);
+            if(ext_ctrls(fd, VIDIOC_G_EXT_CTRLS, saved + first, n, &idx)) {
+                break;
+            }
+        }
+        if(first >= count) {
+            break;
+        }
+        if(errno != ENOSPC || retries >= count) {
+            fprintf(stderr, "Unable to read current settings: %s\n",
+                    strerror(errno));
+            goto out;
+        }
+    }
+
+    for(first=0; first<count; first+=n) {
+        n = class_size(values, first, count);
+        if(ext_ctrls(fd, VIDIOC_S_EXT_CTRLS, values + first, n, &idx)) {
+            if(idx < (__u32)n) {
+                fprintf(stderr, "Failed to set control \"%s\": %s\n",
+                        settings[first+idx].name, strerror(errno));
+            } else {
+                fprintf(stderr, "Failed to set controls: %s\n",
+                        strerror(errno));
+            }
+            rollback(fd, saved, first + n);
+            goto out;
+        }
+    }
+    ret = EXIT_SUCCESS;
+
+out:
+    free(settings);
+    free(values);
+    free(saved);
+    free(snapshot);
+    return ret;
+}
+
+/* True when the value read from the device is the one of the setting */
+static int same_value(const struct setting *s, const struct v4l2_ext_control *c)
+{
+    switch(s->kind) {
+    case SETTING_INT:
+        return c->value == s->value;
+    case SETTING_INT64:
+        return c->value64 == s->value;
+    case SETTING_STRING:
+        return !strcmp(c->string, s->data);
+    case SETTING_PAYLOAD:
+        return c->size == s->size && !memcmp(c->ptr, s->data, s->size);
+    }
+    return 0;
+}
+
+/* Read the current value of every control, one VIDIOC_G_EXT_CTRLS per
+   control class where the driver allows it. known is set for the
+   controls which could be read. */
+static int read_current(int fd, const struct setting *settings,
+                        struct v4l2_ext_control *cur, char *known, int count,
+                        char **buf)
+{
+    struct v4l2_control ctl;
+    int i, first, n, retries, enospc;
+
+    for(retries=0; ; retries++) {
+        if(assign_payloads(cur, count, buf)) {
+            return -1;
+        }
+        memset(known, 0, count);
+        enospc = 0;
+        for(first=0; first<count; first+=n) {
+            n = class_size(cur, first, count);
+            if(ext_ctrls(fd, VIDIOC_G_EXT_CTRLS, cur + first, n, NULL) == 0) {
+                memset(known + first, 1, n);
+                continue;
+            }
+            if(errno == ENOSPC) {
+                /* The driver updated the size it needs */
+                enospc = 1;
+                continue;
+            }
+            /* One control spoils the batch, or the driver has no extended
+               controls: go one by one */
+            for(i=first; i<first+n; i++) {
+                if(ext_ctrls(fd, VIDIOC_G_EXT_CTRLS, cur + i, 1, NULL) == 0) {
+                    known[i] = 1;
+                } else if(errno == ENOSPC) {
+                    enospc = 1;
+                } else if(settings[i].kind == SETTING_INT) {
+                    ctl.id = cur[i].id;
+                    if(core_ioctl(fd, VIDIOC_G_CTRL, &ctl) == 0) {
+                        cur[i].value = ctl.value;
+                        known[i] = 1;
+                    }
+                }
+            }
+        }
+        if(!enospc || retries >= count) {
+            return 0;
+        }
+    }
+}
+
+/* Write one control, for drivers without extended controls as well */
+static int write_one(int fd, const struct setting *s, struct v4l2_ext_control *c)
+{
+    struct v4l2_control ctl;
+
+    if(ext_ctrls(fd, VIDIOC_S_EXT_CTRLS, c, 1, NULL) == 0) {
+        return 0;
+    }
+    if(s->kind != SETTING_INT || errno == EACCES) {
+        return -1;
+    }
+    ctl.id = s->id;
+    ctl.value = s->value;
+    return core_ioctl(fd, VIDIOC_S_CTRL, &ctl);
+}
+
+/* Only write the controls whose current value differs from the profile.
+   The device is read once, and the changed controls are written with one
+   VIDIOC_S_EXT_CTRLS per class, or with load_settings_atomic() when
+   atomic is set. Controls which cannot be written are skipped like
+   load_settings() does. */
+int load_settings_changed(int fd, const struct setting *profile, int count,
+                          int atomic, struct load_stats *stats)
+{
+    struct setting *settings = NULL, *changed = NULL;
+    struct v4l2_ext_control *cur = NULL, *values = NULL;
+    char *known = NULL, *snapshot = NULL;
+    int i, first, n, m = 0, ret = EXIT_FAILURE;
+
+    memset(stats, 0, sizeof(*stats));
+    if(count == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    settings = malloc(count * sizeof(*settings));
+    changed = malloc(count * sizeof(*changed));
+    cur = calloc(count, sizeof(*cur));
+    values = calloc(count, sizeof(*values));
+    known = malloc(count);
+    if(!settings || !changed || !cur || !values || !known) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+    memcpy(settings, profile, count * sizeof(*settings));
+    qsort(settings, count, sizeof(*settings), setting_cmp);
+    for(i=0; i<count; i++) {
+        cur[i].id = settings[i].id;
+        cur[i].size = settings[i].kind == SETTING_STRING ||
+                      settings[i].kind == SETTING_PAYLOAD ? settings[i].size : 0;
+    }
+    if(read_current(fd, settings, cur, known, count, &snapshot)) {
+        goto out;
+    }
+
+    /* Unreadable controls are written, they might not be as we want */
+    for(i=0; i<count; i++) {
+        if(known[i] && same_value(&settings[i], &cur[i])) {
+            stats->skipped++;
+        } else {
+            changed[m++] = settings[i];
+        }
+    }
+
+    if(atomic) {
+        ret = load_settings_atomic(fd, changed, m);
+        if(ret == EXIT_SUCCESS) {
+            stats->written = m;
+        } else {
+            stats->failed = m;
+        }
+        goto out;
+    }
+
+    for(i=0; i<m; i++) {
+        setting_to_ext(&changed[i], &values[i]);
+    }
+    for(first=0; first<m; first+=n) {
+        n = class_size(values, first, m);
+        if(ext_ctrls(fd, VIDIOC_S_EXT_CTRLS, values + first, n, NULL) == 0) {
+            stats->written += n;
+            continue;
+        }
+        for(i=first; i<first+n; i++) {
+            if(write_one(fd, &changed[i], &values[i]) == 0) {
+                stats->written++;
+            } else if(errno == EACCES || errno == EBUSY) {
+                /* Read only, or held by somebody else */
+                stats->skipped++;
+            } else {
+                fprintf(stderr, "Failed to set control \"%s\": %s\n",
+                        changed[i].name, strerror(errno));
+                stats->failed++;
+            }
+        }
+    }
+    ret = stats->failed ? EXIT_FAILURE : EXIT_SUCCESS;
+
+out:
+    free(settings);
+    free(changed);
+    free(cur);
+    free(values);
+    free(known);
+    free(snapshot);
+    return ret;
+}
+
+/* Load the file, writing only what differs, and tell what was done */
+int do_load_changed(int fd, FILE *file, int atomic)
+{
+    struct load_stats stats;
+    struct setting *settings;
+    int count, ret;
+
+    count = read_settings(file, &settings);
+    if(count < 0) {
+        return EXIT_FAILURE;
+    }
+    ret = load_settings_changed(fd, settings, count, atomic, &stats);
+    printf("%d written, %d skipped, %d failed\n", stats.written,
+           stats.skipped, stats.failed);
+    free_settings(settings, count);
+    return ret;
+}
+
+/* The identity presets are stored under when none is given: the card name */
+static int device_identity(const char *device, char *identity, size_t size)
+{
+    struct v4l2_capability cap;
+    int fd;
+
+    fd = v4l2_open(device, O_RDWR, 0);
+    if(fd < 0) {
+        fprintf(stderr, "Unable to open %s: %s\n", device, strerror(errno));
+        return -1;
+    }
+    if(core_ioctl(fd, VIDIOC_QUERYCAP, &cap) == -1) {
+        fprintf(stderr, "%s is not a V4L2 device\n", device);
+        v4l2_close(fd);
+        return -1;
+    }
+    v4l2_close(fd);
+    snprintf(identity, size, "%s", (const char *)cap.card);
+    return 0;
+}
+
+int do_library(const char *path, const char *device, const char *identity,
+               const char *preset, const char *import, const char *export,
+               int list, int atomic, int changed)
+{
+    struct load_stats stats;
+    struct profile_library *lib;
+    struct setting *settings;
+    char card[sizeof(((struct v4l2_capability *)0)->card) + 1];
+    int i, fd, count, ret = EXIT_FAILURE;
+    FILE *file;
+
+    if(list) {
+        lib = library_open(path);
+        if(!lib) {
+            fprintf(stderr, "Unable to read library %s: %s\n", path, strerror(errno));
             return EXIT_FAILURE;
         }
+        for(i=0; i<library_count(lib); i++) {
+            count = library_settings(lib, i, &settings);
+            if(count < 0 || !library_identity(lib, i) || !library_preset(lib, i)) {
+                fprintf(stderr, "Library %s is damaged\n", path);
+                library_close(lib);
+                return EXIT_FAILURE;
+            }
+            printf("%s\t%s\t%d controls\n", library_identity(lib, i),
+                   library_preset(lib, i), count);
+            free(settings);
+        }
+        library_close(lib);
+        return EXIT_SUCCESS;
     }
-    
-    if(!feof(file)) {
-        fprintf(stderr, "Error reading from file\n");
+
+    if(!preset) {
+        fprintf(stderr, "No preset given\n");
         return EXIT_FAILURE;
     }
-    
-    return EXIT_SUCCESS;
+    if(!identity) {
+        if(device_identity(device, card, sizeof(card))) {
+            return EXIT_FAILURE;
+        }
+        identity = card;
+    }
+
+    if(import) {
+        file = fopen(import, "r");
+        if(!file) {
+            fprintf(stderr, "Unable to open %s: %s\n", import, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        count = read_settings(file, &settings);
+        fclose(file);
+        if(count < 0) {
+            return EXIT_FAILURE;
+        }
+        if(library_add(path, identity, preset, settings, count) == 0) {
+            ret = EXIT_SUCCESS;
+        }
+        free_settings(settings, count);
+        return ret;
+    }
+
+    /* From here on, no parsing: a hash lookup in the mapped file */
+    lib = library_open(path);
+    if(!lib) {
+        fprintf(stderr, "Unable to read library %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    i = library_find(lib, identity, preset);
+    if(i < 0) {
+        fprintf(stderr, "No preset \"%s\" for \"%s\" in %s\n", preset, identity, path);
+        library_close(lib);
+        return EXIT_FAILURE;
+    }
+    count = library_settings(lib, i, &settings);
+    if(count < 0) {
+        fprintf(stderr, "Library %s is damaged\n", path);
+        library_close(lib);
+        return EXIT_FAILURE;
+    }
+
+    if(export) {
+        file = fopen(export, "w");
+        if(!file) {
+            fprintf(stderr, "Unable to open %s: %s\n", export, strerror(errno));
+        } else {
+            for(i=0; i<count; i++) {
+                write_setting(file, &settings[i]);
+            }
+            if(fclose(file) == 0) {
+                ret = EXIT_SUCCESS;
+            }
+        }
+    } else {
+        fd = v4l2_open(device, O_RDWR, 0);
+        if(fd < 0) {
+            fprintf(stderr, "Unable to open %s: %s\n", device, strerror(errno));
+        } else {
+            if(changed) {
+                ret = load_settings_changed(fd, settings, count, atomic, &stats);
+                printf("%d written, %d skipped, %d failed\n", stats.written,
+                       stats.skipped, stats.failed);
+            } else if(atomic) {
+                ret = load_settings_atomic(fd, settings, count);
+            } else {
+                ret = load_settings(fd, settings, count);
+            }
+            v4l2_close(fd);
+        }
+    }
+
+    free(settings);
+    library_close(lib);
+    return ret;
+}
+
+/* Load the whole file, then apply it at once */
+int do_load_atomic(int fd, FILE *file)
+{
+    struct setting *settings;
+    int count, ret;
+
+    count = read_settings(file, &settings);
+    if(count < 0) {
+        return EXIT_FAILURE;
+    }
+    ret = load_settings_atomic(fd, settings, count);
+    free_settings(settings, count);
+    return ret;
+}
+
+static void print_stats(void)
+{
+    stats_print(stderr);
 }
 
 int main(int argc, char **argv)
 {
     int i, fd, ret;
     int load = -1;
+    int atomic = 0, changed = 0;
     const char *device = "/dev/video0";
     const char *filename, *mode;
+    const char *config = NULL, *socket_path = NULL;
+    const char *library = NULL, *preset = NULL, *identity = NULL;
+    const char *import = NULL, *export = NULL;
+    const char *profiles = NULL;
+    const char **devices;
+    int ndevices = 0, workers = 0, fleet = 0;
+    int list = 0;
+    const char *latency = NULL, *results = NULL;
+    __s32 values[2];
+    int nvalues = 0, changes = 20;
     FILE *file;
     
+    devices = malloc(argc * sizeof(*devices));
+    if(!devices) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
     for(i=1; i<argc; i++) {
         if(!strcmp(argv[i], "-d") && i<argc-1) {
             device = argv[++i];
+            devices[ndevices++] = device;
+            if(strpbrk(device, "*?[")) {
+                fleet = 1;
+            }
+        } else if(!strcmp(argv[i], "-j") && i<argc-1) {
+            workers = atoi(argv[++i]);
+            fleet = 1;
+        } else if(!strcmp(argv[i], "-c") && i<argc-1) {
+            profiles = argv[++i];
+            fleet = 1;
         } else if(!strcmp(argv[i], "-s") && i<argc-1) {
             filename = argv[++i];
             load = 0;
         } else if(!strcmp(argv[i], "-l") && i<argc-1) {
             filename = argv[++i];
             load = 1;
+        } else if(!strcmp(argv[i], "-D") && i<argc-1) {
+            config = argv[++i];
+        } else if(!strcmp(argv[i], "-u") && i<argc-1) {
+            socket_path = argv[++i];
+        } else if(!strcmp(argv[i], "-L") && i<argc-1) {
+            library = argv[++i];
+        } else if(!strcmp(argv[i], "-p") && i<argc-1) {
+            preset = argv[++i];
+        } else if(!strcmp(argv[i], "-k") && i<argc-1) {
+            identity = argv[++i];
+        } else if(!strcmp(argv[i], "-i") && i<argc-1) {
+            import = argv[++i];
+        } else if(!strcmp(argv[i], "-o") && i<argc-1) {
+            export = argv[++i];
+        } else if(!strcmp(argv[i], "-T") && i<argc-1) {
+            latency = argv[++i];
+        } else if(!strcmp(argv[i], "-V") && i<argc-1) {
+            if(sscanf(argv[++i], "%d,%d", &values[0], &values[1]) != 2) {
+                usage(argv[0]);
+                free(devices);
+                return EXIT_FAILURE;
+            }
+            nvalues = 2;
+        } else if(!strcmp(argv[i], "-n") && i<argc-1) {
+            changes = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-r") && i<argc-1) {
+            results = argv[++i];
+        } else if(!strcmp(argv[i], "-t")) {
+            list = 1;
+        } else if(!strcmp(argv[i], "-a")) {
+            atomic = 1;
+        } else if(!strcmp(argv[i], "-m")) {
+            changed = 1;
+        } else if(!strcmp(argv[i], "--stats")) {
+            atexit(print_stats);
         } else if(!strcmp(argv[i], "-h")) {
             usage(argv[0]);
+            free(devices);
             return EXIT_SUCCESS;
         } else {
             usage(argv[0]);
+            free(devices);
             return EXIT_FAILURE;
         }
     }
     
+    if(ndevices > 1 || fleet) {
+        if(config || import || export || list || identity ||
+           (load < 0 && !profiles && !library) || (load >= 0 && (profiles || library)) ||
+           (profiles && library) || (library && !preset)) {
+            usage(argv[0]);
+            ret = EXIT_FAILURE;
+        } else {
+            ret = run_fleet(devices, ndevices, workers, load == 0 ? filename : NULL,
+                            load == 1 ? filename : NULL, profiles, library, preset,
+                            atomic, changed);
+        }
+        free(devices);
+        return ret;
+    }
+    free(devices);
+
+    if(config) {
+        return run_daemon(config, socket_path);
+    }
+    if(latency) {
+        if(changes < 1 || load >= 0 || library) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return run_latency(device, latency, nvalues ? values : NULL, changes,
+                           results);
+    }
+    if(library) {
+        return do_library(library, device, identity, preset, import, export,
+                          list, atomic, changed);
+    }
+
     if(load < 0) {
         usage(argv[0]);
         return EXIT_FAILURE;
@@ -219,10 +1187,14 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
     
-    if(load) {
+    if(load && changed) {
+        ret = do_load_changed(fd, file, atomic);
+    } else if(load && atomic) {
+        ret = do_load_atomic(fd, file);
+    } else if(load) {
         ret = do_load(fd, file);
     } else {
-        ret = do_save(fd, file);
+        ret = do_save_ext(fd, file);
     }
     
     fclose(file);
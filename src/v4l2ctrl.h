@@ -0,0 +1,114 @@
+/*  v4l2ctrl - A program for saving and loading settings for V4L2 devices
+    Copyright (C) 2008-2009 Scott J. Bertin (scottbertin@yahoo.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef V4L2CTRL_H
+#define V4L2CTRL_H
+
+#include <stdio.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#include "v4l2core.h"
+
+/* One control per line: id, name right aligned on 31 characters, value.
+   Plain integers are 32 bit values, other types are written as
+   "123L" (64 bit integer), "\"text\"" (string) or "#0a1b..." (hex dump
+   of an array or compound payload). */
+#define FORMATW "%u:%31s:%d\n"
+#define FORMATH "%u:%31s:"
+#define NAME_WIDTH 31
+
+enum setting_kind {
+    SETTING_INT,
+    SETTING_INT64,
+    SETTING_STRING,
+    SETTING_PAYLOAD,
+};
+
+struct setting {
+    __u32 id;
+    enum setting_kind kind;
+    __s64 value;
+    __u32 size;     /* payload size for strings (with the NUL) and arrays */
+    char *data;
+    int order;
+    char name[32];
+};
+
+int read_settings(FILE *file, struct setting **settings);
+void free_settings(struct setting *s, int count);
+void write_setting(FILE *file, const struct setting *s);
+void setting_to_ext(const struct setting *s, struct v4l2_ext_control *c);
+
+int do_save_ext(int fd, FILE *file);
+
+struct load_stats {
+    int written;
+    int skipped;    /* already set, or not writable */
+    int failed;
+};
+
+/* These return EXIT_SUCCESS or EXIT_FAILURE and leave settings alone */
+int load_settings(int fd, const struct setting *settings, int count);
+int load_settings_atomic(int fd, const struct setting *settings, int count);
+int load_settings_changed(int fd, const struct setting *settings, int count,
+                          int atomic, struct load_stats *stats);
+
+/* v4l2library.c */
+struct profile_library;
+struct profile_library *library_open(const char *path);
+void library_close(struct profile_library *lib);
+int library_count(const struct profile_library *lib);
+int library_find(const struct profile_library *lib, const char *identity,
+                 const char *preset);
+const char *library_identity(const struct profile_library *lib, int index);
+const char *library_preset(const struct profile_library *lib, int index);
+int library_settings(const struct profile_library *lib, int index,
+                     struct setting **settings);
+int library_add(const char *path, const char *identity, const char *preset,
+                const struct setting *settings, int count);
+
+/* v4l2fleet.c */
+int run_fleet(const char **devices, int ndevices, int workers,
+              const char *pattern, const char *filename, const char *config,
+              const char *library, const char *preset, int atomic,
+              int changed);
+
+/* v4l2latency.c: values holds the two values to toggle between, NULL
+   to choose them from the range of the control */
+int run_latency(const char *device, const char *control, const __s32 *values,
+                int changes, const char *results);
+
+/* v4l2daemon.c */
+struct profile {
+    char *path;
+    char *key;              /* device, card, bus_info or driver */
+    char *value;
+    struct setting *settings;
+    int count;
+};
+
+int read_config(const char *config, struct profile **profiles);
+void free_profiles(struct profile *p, int count);
+const struct profile *match_profile(const struct profile *profiles, int count,
+                                    const char *path,
+                                    const struct v4l2_capability *cap);
+int is_metadata_node(const struct v4l2_capability *cap);
+int run_daemon(const char *config, const char *socket_path);
+
+#endif
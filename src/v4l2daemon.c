@@ -0,0 +1,776 @@
+/*  v4l2ctrl - A program for saving and loading settings for V4L2 devices
+    Copyright (C) 2008-2009 Scott J. Bertin (scottbertin@yahoo.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <libv4l2.h>
+
+#include "v4l2ctrl.h"
+
+/* Daemon mode: keep the profiles of many devices in memory, apply them as
+   soon as a matching device shows up and put back any control somebody
+   else changes. */
+
+#define UEVENT_SIZE 8192
+/* A node announced by the kernel may not be usable right away */
+#define OPEN_RETRY_MS 2000
+#define OPEN_RETRY_INTERVAL_MS 20
+
+struct device {
+    char path[PATH_MAX];
+    int fd;
+    const struct profile *profile;
+    long long seen;         /* when the device appeared, in us */
+    long long retry_until;  /* while it can not be opened yet, in us */
+    long long next_retry;   /* 0 when there is nothing left to try */
+    int watch;              /* control events are polled for */
+};
+
+/* Where device add and remove events come from. Both sources deliver
+   kernel uevents, "add@/devpath" followed by NUL separated KEY=value
+   pairs. The netlink source listens to the kernel, the socket source
+   reads the same messages from a local datagram socket, so the daemon
+   can be driven by hand or by a test instead of real hotplug. */
+struct event_source {
+    int fd;
+    /* Returns the length of the message in buf, -1 to ignore it */
+    ssize_t (*receive)(struct event_source *src, char *buf, size_t size);
+    void (*close)(struct event_source *src);
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+};
+
+struct uevent {
+    const char *action;
+    const char *subsystem;
+    const char *devname;
+};
+
+struct daemon {
+    struct profile *profiles;
+    int nprofiles;
+    struct device *devices;
+    int ndevices;
+    struct event_source src;
+};
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    quit = 1;
+}
+
+static long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Event sources
+ */
+static ssize_t netlink_receive(struct event_source *src, char *buf, size_t size)
+{
+    struct sockaddr_nl addr;
+    socklen_t addrlen = sizeof(addr);
+    ssize_t len;
+
+    len = recvfrom(src->fd, buf, size, 0, (struct sockaddr *)&addr, &addrlen);
+    /* Only the kernel is trusted, not other processes of the group */
+    if(len > 0 && addr.nl_pid != 0) {
+        return -1;
+    }
+    return len;
+}
+
+static void netlink_close(struct event_source *src)
+{
+    close(src->fd);
+}
+
+static int open_netlink_source(struct event_source *src)
+{
+    struct sockaddr_nl addr;
+
+    src->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                     NETLINK_KOBJECT_UEVENT);
+    if(src->fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;     /* kernel events, not the ones from udev */
+    if(bind(src->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(src->fd);
+        return -1;
+    }
+    src->receive = netlink_receive;
+    src->close = netlink_close;
+    src->path[0] = 0;
+    return 0;
+}
+
+static ssize_t socket_receive(struct event_source *src, char *buf, size_t size)
+{
+    return recv(src->fd, buf, size, 0);
+}
+
+static void socket_close(struct event_source *src)
+{
+    close(src->fd);
+    unlink(src->path);
+}
+
+static int open_socket_source(struct event_source *src, const char *path)
+{
+    struct sockaddr_un addr;
+
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    src->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(src->fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if(bind(src->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(src->fd);
+        return -1;
+    }
+    src->receive = socket_receive;
+    src->close = socket_close;
+    strcpy(src->path, path);
+    return 0;
+}
+
+/* buf must have room for a terminating NUL after len bytes */
+static int parse_uevent(char *buf, ssize_t len, struct uevent *ev)
+{
+    char *p, *end = buf + len;
+
+    memset(ev, 0, sizeof(*ev));
+    buf[len] = 0;
+    for(p=buf; p<end; p+=strlen(p)+1) {
+        if(!strncmp(p, "ACTION=", 7)) {
+            ev->action = p + 7;
+        } else if(!strncmp(p, "SUBSYSTEM=", 10)) {
+            ev->subsystem = p + 10;
+        } else if(!strncmp(p, "DEVNAME=", 8)) {
+            ev->devname = p + 8;
+        }
+    }
+    return ev->action && ev->subsystem && ev->devname ? 0 : -1;
+}
+
+/*
+ * Profiles
+ */
+void free_profiles(struct profile *p, int count)
+{
+    int i;
+
+    for(i=0; i<count; i++) {
+        free(p[i].path);
+        free(p[i].key);
+        free_settings(p[i].settings, p[i].count);
+    }
+    free(p);
+}
+
+static int load_profile(struct profile *p, const char *path, const char *key,
+                        const char *value)
+{
+    FILE *file;
+
+    memset(p, 0, sizeof(*p));
+    if(strcmp(key, "device") && strcmp(key, "card") &&
+       strcmp(key, "bus_info") && strcmp(key, "driver")) {
+        fprintf(stderr, "Unknown match \"%s\", use device, card, bus_info "
+                "or driver\n", key);
+        return -1;
+    }
+
+    file = fopen(path, "r");
+    if(!file) {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    p->count = read_settings(file, &p->settings);
+    fclose(file);
+    if(p->count < 0) {
+        fprintf(stderr, "Unable to read profile %s\n", path);
+        return -1;
+    }
+
+    p->path = strdup(path);
+    /* key and value share one allocation */
+    p->key = malloc(strlen(key) + strlen(value) + 2);
+    if(!p->path || !p->key) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    strcpy(p->key, key);
+    p->value = p->key + strlen(key) + 1;
+    strcpy(p->value, value);
+    return 0;
+}
+
+/* Each line names a profile and what it applies to:
+       /etc/v4l2ctrl/c920.ctrl   card=HD Pro Webcam C920
+       /etc/v4l2ctrl/left.ctrl   bus_info=usb-0000:00:14.0-1
+   The first matching line wins. Empty lines and # comments are ignored. */
+int read_config(const char *config, struct profile **profiles)
+{
+    struct profile *p = NULL, *tmp;
+    int count = 0, alloc = 0, lineno = 0;
+    char *line = NULL, *path, *key, *value, *end;
+    size_t linesize = 0;
+    ssize_t len;
+    FILE *file;
+
+    file = fopen(config, "r");
+    if(!file) {
+        fprintf(stderr, "Unable to open %s: %s\n", config, strerror(errno));
+        return -1;
+    }
+
+    while((len = getline(&line, &linesize, file)) > 0) {
+        lineno++;
+        while(len > 0 && (line[len-1] == '\n' || line[len-1] == ' ' ||
+                          line[len-1] == '\t')) {
+            line[--len] = 0;
+        }
+        path = line + strspn(line, " \t");
+        if(!*path || *path == '#') {
+            continue;
+        }
+
+        end = path + strcspn(path, " \t");
+        key = end + strspn(end, " \t");
+        value = strchr(key, '=');
+        if(!*end || !value) {
+            fprintf(stderr, "%s:%d: expected \"profile key=value\"\n",
+                    config, lineno);
+            goto fail;
+        }
+        *end = 0;
+        *value++ = 0;
+
+        if(count == alloc) {
+            alloc = alloc ? alloc * 2 : 8;
+            tmp = realloc(p, alloc * sizeof(*p));
+            if(!tmp) {
+                fprintf(stderr, "Out of memory\n");
+                goto fail;
+            }
+            p = tmp;
+        }
+        if(load_profile(&p[count], path, key, value)) {
+            fprintf(stderr, "%s:%d: profile not loaded\n", config, lineno);
+            free(p[count].path);
+            free(p[count].key);
+            free_settings(p[count].settings, p[count].count > 0 ? p[count].count : 0);
+            goto fail;
+        }
+        count++;
+    }
+
+    free(line);
+    fclose(file);
+    *profiles = p;
+    return count;
+
+fail:
+    free(line);
+    fclose(file);
+    free_profiles(p, count);
+    return -1;
+}
+
+const struct profile *match_profile(const struct profile *profiles, int count,
+                                    const char *path,
+                                    const struct v4l2_capability *cap)
+{
+    char real[PATH_MAX];
+    const char *v;
+    int i;
+
+    for(i=0; i<count; i++) {
+        const struct profile *p = &profiles[i];
+        if(!strcmp(p->key, "device")) {
+            /* Allow symlinks such as /dev/v4l/by-path/... */
+            v = realpath(p->value, real) ? real : p->value;
+            if(!strcmp(v, path)) {
+                return p;
+            }
+            continue;
+        }
+        if(!strcmp(p->key, "card")) {
+            v = (const char *)cap->card;
+        } else if(!strcmp(p->key, "bus_info")) {
+            v = (const char *)cap->bus_info;
+        } else {
+            v = (const char *)cap->driver;
+        }
+        if(!strcmp(v, p->value)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* The metadata node of a camera has the same card and bus_info as its
+   video node, but no controls */
+int is_metadata_node(const struct v4l2_capability *cap)
+{
+#ifdef V4L2_CAP_META_CAPTURE
+    return (cap->capabilities & V4L2_CAP_DEVICE_CAPS) &&
+           (cap->device_caps & V4L2_CAP_META_CAPTURE) &&
+           !(cap->device_caps & V4L2_CAP_VIDEO_CAPTURE);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Devices
+ */
+/* Only what differs is written, so a device which kept its settings or an
+   auto mode flipped back costs a read and nothing else */
+static void apply_profile(struct device *dev)
+{
+    long long start = now_us();
+    struct load_stats stats;
+    int ret;
+
+    ret = load_settings_changed(dev->fd, dev->profile->settings,
+                                dev->profile->count, 1, &stats);
+    fprintf(stderr, "%s: %s %s (%d written, %d skipped) in %.1f ms, "
+            "%.1f ms after the event\n", dev->path,
+            ret == EXIT_SUCCESS ? "applied" : "failed to apply",
+            dev->profile->path, stats.written, stats.skipped,
+            (now_us() - start) / 1000.0, (now_us() - dev->seen) / 1000.0);
+}
+
+/* Ask for an event whenever one of the controls of the profile changes */
+static void subscribe(struct device *dev)
+{
+    struct v4l2_event_subscription sub;
+    int i, subscribed = 0;
+
+    for(i=0; i<dev->profile->count; i++) {
+        memset(&sub, 0, sizeof(sub));
+        sub.type = V4L2_EVENT_CTRL;
+        sub.id = dev->profile->settings[i].id;
+        if(core_ioctl(dev->fd, VIDIOC_SUBSCRIBE_EVENT, &sub) == 0) {
+            subscribed++;
+        }
+    }
+    dev->watch = subscribed > 0;
+    if(!subscribed && dev->profile->count) {
+        fprintf(stderr, "%s: no control events, changes will not be "
+                "corrected\n", dev->path);
+    }
+}
+
+static const struct setting *find_setting(const struct profile *p, __u32 id)
+{
+    int i;
+
+    for(i=0; i<p->count; i++) {
+        if(p->settings[i].id == id) {
+            return &p->settings[i];
+        }
+    }
+    return NULL;
+}
+
+static int set_one(int fd, const struct setting *s)
+{
+    struct v4l2_ext_control c;
+    struct v4l2_control ctl;
+
+    setting_to_ext(s, &c);
+    if(ext_ctrls(fd, VIDIOC_S_EXT_CTRLS, &c, 1, NULL) == 0) {
+        return 0;
+    }
+    if(s->kind != SETTING_INT) {
+        return -1;
+    }
+    ctl.id = s->id;
+    ctl.value = s->value;
+    return core_ioctl(fd, VIDIOC_S_CTRL, &ctl);
+}
+
+/* Our own writes do not come back as events, anything we get was changed
+   by somebody else. Put it back unless the driver says the control is not
+   ours to set right now, an auto mode moving it for instance. Returns -1
+   once the device is gone. */
+static int correct_drift(struct device *dev)
+{
+    const struct v4l2_event_ctrl *c;
+    const struct setting *s;
+    struct v4l2_event ev;
+    int differs, reload = 0, err = 0;
+
+    for(;;) {
+        if(core_ioctl(dev->fd, VIDIOC_DQEVENT, &ev) == -1) {
+            err = errno;
+            break;
+        }
+        c = &ev.u.ctrl;
+        s = find_setting(dev->profile, ev.id);
+        if(ev.type == V4L2_EVENT_CTRL && s &&
+           (c->changes & V4L2_EVENT_CTRL_CH_VALUE) &&
+           !(c->flags & (V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_GRABBED |
+                         V4L2_CTRL_FLAG_INACTIVE | V4L2_CTRL_FLAG_VOLATILE))) {
+            switch(s->kind) {
+            case SETTING_INT:
+                differs = c->value != s->value;
+                break;
+            case SETTING_INT64:
+                differs = c->value64 != s->value;
+                break;
+            default:
+                /* The event does not carry payloads */
+                differs = 1;
+                break;
+            }
+            if(differs && is_master(s->id)) {
+                /* The controls it gates need to be set again as well */
+                reload = 1;
+            } else if(differs) {
+                fprintf(stderr, "%s: control \"%s\" changed, restoring it\n",
+                        dev->path, s->name);
+                if(set_one(dev->fd, s)) {
+                    fprintf(stderr, "%s: failed to restore \"%s\": %s\n",
+                            dev->path, s->name, strerror(errno));
+                }
+            }
+        }
+        if(ev.pending == 0) {
+            break;
+        }
+    }
+    if(err == ENODEV) {
+        return -1;
+    }
+
+    if(reload) {
+        fprintf(stderr, "%s: auto mode changed, restoring the profile\n",
+                dev->path);
+        dev->seen = now_us();
+        apply_profile(dev);
+    }
+    return 0;
+}
+
+static void close_device(struct device *dev)
+{
+    if(dev->fd >= 0) {
+        v4l2_close(dev->fd);
+    }
+    dev->fd = -1;
+    dev->next_retry = 0;
+    dev->watch = 0;
+}
+
+/* Open the node and apply its profile. The device keeps its entry while
+   it is managed or while the node is retried. */
+static void try_open(struct daemon *d, struct device *dev)
+{
+    struct v4l2_capability cap;
+    long long now = now_us();
+    int fd;
+
+    dev->next_retry = 0;
+    fd = v4l2_open(dev->path, O_RDWR | O_NONBLOCK, 0);
+    if(fd < 0) {
+        if((errno == ENOENT || errno == EACCES || errno == EBUSY) &&
+           now < dev->retry_until) {
+            dev->next_retry = now + OPEN_RETRY_INTERVAL_MS * 1000LL;
+        } else {
+            fprintf(stderr, "Unable to open %s: %s\n", dev->path, strerror(errno));
+        }
+        return;
+    }
+
+    if(core_ioctl(fd, VIDIOC_QUERYCAP, &cap) == -1) {
+        v4l2_close(fd);
+        return;
+    }
+    if(is_metadata_node(&cap)) {
+        v4l2_close(fd);
+        return;
+    }
+
+    dev->profile = match_profile(d->profiles, d->nprofiles, dev->path, &cap);
+    if(!dev->profile) {
+        v4l2_close(fd);
+        return;
+    }
+    dev->fd = fd;
+    apply_profile(dev);
+    subscribe(dev);
+}
+
+static struct device *find_device(struct daemon *d, const char *path)
+{
+    int i;
+
+    for(i=0; i<d->ndevices; i++) {
+        if(!strcmp(d->devices[i].path, path)) {
+            return &d->devices[i];
+        }
+    }
+    return NULL;
+}
+
+static void add_device(struct daemon *d, const char *path)
+{
+    struct device *dev, *tmp;
+
+    dev = find_device(d, path);
+    if(dev) {
+        /* A remove we did not see, start over */
+        close_device(dev);
+    } else {
+        if(strlen(path) >= sizeof(dev->path)) {
+            return;
+        }
+        tmp = realloc(d->devices, (d->ndevices + 1) * sizeof(*tmp));
+        if(!tmp) {
+            fprintf(stderr, "Out of memory\n");
+            return;
+        }
+        d->devices = tmp;
+        dev = &d->devices[d->ndevices++];
+        memset(dev, 0, sizeof(*dev));
+        strcpy(dev->path, path);
+        dev->fd = -1;
+    }
+    dev->seen = now_us();
+    dev->retry_until = dev->seen + OPEN_RETRY_MS * 1000LL;
+    try_open(d, dev);
+}
+
+/* Drop the entries which are neither managed nor waiting for a retry */
+static void prune_devices(struct daemon *d)
+{
+    int i, n = 0;
+
+    for(i=0; i<d->ndevices; i++) {
+        if(d->devices[i].fd >= 0 || d->devices[i].next_retry) {
+            d->devices[n++] = d->devices[i];
+        }
+    }
+    d->ndevices = n;
+}
+
+/* Devices present before the daemon started */
+static void scan_devices(struct daemon *d)
+{
+    char path[PATH_MAX];
+    struct dirent *e;
+    DIR *dir;
+
+    dir = opendir("/dev");
+    if(!dir) {
+        return;
+    }
+    while((e = readdir(dir))) {
+        if(!strncmp(e->d_name, "video", 5)) {
+            snprintf(path, sizeof(path), "/dev/%s", e->d_name);
+            add_device(d, path);
+        }
+    }
+    closedir(dir);
+    prune_devices(d);
+}
+
+static void handle_uevent(struct daemon *d)
+{
+    char buf[UEVENT_SIZE + 1], path[PATH_MAX];
+    struct device *dev;
+    struct uevent ev;
+    ssize_t len;
+
+    len = d->src.receive(&d->src, buf, UEVENT_SIZE);
+    if(len <= 0 || parse_uevent(buf, len, &ev) ||
+       strcmp(ev.subsystem, "video4linux")) {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "/dev/%s", ev.devname);
+    if(!strcmp(ev.action, "add")) {
+        add_device(d, path);
+    } else if(!strcmp(ev.action, "remove")) {
+        dev = find_device(d, path);
+        if(dev) {
+            if(dev->fd >= 0) {
+                fprintf(stderr, "%s: removed\n", path);
+            }
+            close_device(dev);
+        }
+    }
+    prune_devices(d);
+}
+
+int run_daemon(const char *config, const char *socket_path)
+{
+    struct daemon d;
+    struct pollfd *fds = NULL, *tmp;
+    struct sigaction sa;
+    long long now, next;
+    int i, n, timeout, ret;
+
+    memset(&d, 0, sizeof(d));
+    d.nprofiles = read_config(config, &d.profiles);
+    if(d.nprofiles <= 0) {
+        if(d.nprofiles == 0) {
+            fprintf(stderr, "No profiles in %s\n", config);
+        }
+        return EXIT_FAILURE;
+    }
+
+    if(socket_path) {
+        ret = open_socket_source(&d.src, socket_path);
+    } else {
+        ret = open_netlink_source(&d.src);
+    }
+    if(ret) {
+        fprintf(stderr, "Unable to listen for devices: %s\n", strerror(errno));
+        free_profiles(d.profiles, d.nprofiles);
+        return EXIT_FAILURE;
+    }
+
+    /* No SA_RESTART, poll() has to return */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* Listen first, a device added during the scan is not missed */
+    scan_devices(&d);
+
+    while(!quit) {
+        tmp = realloc(fds, (d.ndevices + 1) * sizeof(*fds));
+        if(!tmp) {
+            fprintf(stderr, "Out of memory\n");
+            break;
+        }
+        fds = tmp;
+        fds[0].fd = d.src.fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        next = 0;
+        for(i=0; i<d.ndevices; i++) {
+            /* negative ones are ignored */
+            fds[i+1].fd = d.devices[i].watch ? d.devices[i].fd : -1;
+            fds[i+1].events = POLLPRI;
+            fds[i+1].revents = 0;
+            if(d.devices[i].next_retry &&
+               (!next || d.devices[i].next_retry < next)) {
+                next = d.devices[i].next_retry;
+            }
+        }
+        n = d.ndevices;
+
+        timeout = -1;
+        if(next) {
+            now = now_us();
+            timeout = next > now ? (next - now + 999) / 1000 : 0;
+        }
+        if(poll(fds, n + 1, timeout) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "poll: %s\n", strerror(errno));
+            break;
+        }
+
+        for(i=0; i<n; i++) {
+            struct device *dev = &d.devices[i];
+            if(fds[i+1].revents & (POLLHUP | POLLNVAL)) {
+                fprintf(stderr, "%s: gone\n", dev->path);
+                close_device(dev);
+            } else if(fds[i+1].revents & POLLPRI) {
+                if(correct_drift(dev)) {
+                    fprintf(stderr, "%s: gone\n", dev->path);
+                    close_device(dev);
+                }
+            } else if(fds[i+1].revents & POLLERR) {
+                struct v4l2_capability cap;
+                if(core_ioctl(dev->fd, VIDIOC_QUERYCAP, &cap) == -1) {
+                    fprintf(stderr, "%s: gone\n", dev->path);
+                    close_device(dev);
+                } else {
+                    /* Would wake us up in a loop */
+                    fprintf(stderr, "%s: poll error, changes will not be "
+                            "corrected\n", dev->path);
+                    dev->watch = 0;
+                }
+            }
+        }
+
+        now = now_us();
+        for(i=0; i<n; i++) {
+            if(d.devices[i].next_retry && d.devices[i].next_retry <= now) {
+                try_open(&d, &d.devices[i]);
+            }
+        }
+        prune_devices(&d);
+
+        /* Last, it may add entries and move the array */
+        if(fds[0].revents & POLLIN) {
+            handle_uevent(&d);
+        }
+    }
+
+    for(i=0; i<d.ndevices; i++) {
+        close_device(&d.devices[i]);
+    }
+    free(d.devices);
+    free(fds);
+    d.src.close(&d.src);
+    free_profiles(d.profiles, d.nprofiles);
+    return EXIT_SUCCESS;
+}
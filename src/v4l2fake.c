@@ -0,0 +1,738 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <libv4l2.h>
+
+#include "v4l2fake.h"
+
+#define MAX_FDS 256
+#define FAKE_PRIVATE_BASE (V4L2_CID_USER_BASE | 0x1000)
+/* The range of the 64 bit controls, past what 32 bits hold */
+#define FAKE_MAX64 (1LL << 40)
+#define FAKE_STRING_SIZE 32
+
+struct fake_ctrl {
+    __u32 id;
+    __u32 type;
+    char name[32];
+    __s32 minimum;
+    __s32 maximum;
+    __s32 step;
+    __s32 default_value;
+    __u32 flags;
+    __s32 value;
+    __s64 value64;          /* V4L2_CTRL_TYPE_INTEGER64 */
+    char string[FAKE_STRING_SIZE];  /* V4L2_CTRL_TYPE_STRING */
+    __u32 master;           /* the auto mode taking this control over */
+};
+
+const char *const fake_ioctl_names[FAKE_IOCTL_COUNT] = {
+    "QUERYCAP",
+    "QUERYCTRL",
+    "QUERY_EXT_CTRL",
+    "QUERYMENU",
+    "G_CTRL",
+    "S_CTRL",
+    "G_EXT_CTRLS",
+    "S_EXT_CTRLS",
+    "TRY_EXT_CTRLS",
+    "SUBSCRIBE_EVENT",
+    "DQEVENT",
+    "OTHER",
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int configured;
+static struct fake_ctrl *ctrls;
+static int nctrls;
+static int menu_items = 4;
+static long latency[FAKE_IOCTL_COUNT];
+static unsigned long counts[FAKE_IOCTL_COUNT];
+static char *paths[MAX_FDS];
+
+/*
+ * Configuration
+ */
+static struct fake_ctrl *add_ctrl(__u32 id, __u32 type, const char *name,
+                                  __s32 minimum, __s32 maximum, __s32 def)
+{
+    struct fake_ctrl *tmp, *c;
+
+    tmp = realloc(ctrls, (nctrls + 1) * sizeof(*ctrls));
+    if(!tmp) {
+        return NULL;
+    }
+    ctrls = tmp;
+    c = &ctrls[nctrls++];
+    memset(c, 0, sizeof(*c));
+    c->id = id;
+    c->type = type;
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->minimum = minimum;
+    c->maximum = maximum;
+    c->step = 1;
+    c->default_value = def;
+    c->value = def;
+    if(type == V4L2_CTRL_TYPE_CTRL_CLASS) {
+        c->flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_WRITE_ONLY;
+        c->step = 0;
+    }
+    return c;
+}
+
+static int ctrl_cmp(const void *a, const void *b)
+{
+    const struct fake_ctrl *ca = a, *cb = b;
+
+    return ca->id < cb->id ? -1 : ca->id > cb->id;
+}
+
+static int ioctl_index(const char *name)
+{
+    int i;
+
+    for(i=0; i<FAKE_IOCTL_COUNT; i++) {
+        if(!strcmp(fake_ioctl_names[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void build(int integers, int booleans, int menus, int integers64,
+                  int bitmasks, int strings, int exposure, int white_balance,
+                  int focus)
+{
+    struct fake_ctrl *m, *c;
+    char name[32];
+    __u32 id = FAKE_PRIVATE_BASE;
+    int i;
+
+    add_ctrl(V4L2_CTRL_CLASS_USER | 1, V4L2_CTRL_TYPE_CTRL_CLASS, "User Controls", 0, 0, 0);
+    add_ctrl(V4L2_CID_BRIGHTNESS, V4L2_CTRL_TYPE_INTEGER, "Brightness", 0, 255, 128);
+    add_ctrl(V4L2_CID_CONTRAST, V4L2_CTRL_TYPE_INTEGER, "Contrast", 0, 255, 32);
+    for(i=0; i<integers; i++) {
+        snprintf(name, sizeof(name), "Integer %d", i);
+        add_ctrl(id++, V4L2_CTRL_TYPE_INTEGER, name, -1000, 1000, 0);
+    }
+    for(i=0; i<booleans; i++) {
+        snprintf(name, sizeof(name), "Boolean %d", i);
+        add_ctrl(id++, V4L2_CTRL_TYPE_BOOLEAN, name, 0, 1, 0);
+    }
+    for(i=0; i<menus; i++) {
+        snprintf(name, sizeof(name), "Menu %d", i);
+        add_ctrl(id++, V4L2_CTRL_TYPE_MENU, name, 0, menu_items - 1, 0);
+    }
+    /* QUERYCTRL clamps the range of these to 32 bits, like the kernel */
+    for(i=0; i<integers64; i++) {
+        snprintf(name, sizeof(name), "Integer64 %d", i);
+        add_ctrl(id++, V4L2_CTRL_TYPE_INTEGER64, name, INT_MIN, INT_MAX, 0);
+    }
+    for(i=0; i<bitmasks; i++) {
+        snprintf(name, sizeof(name), "Bitmask %d", i);
+        c = add_ctrl(id++, V4L2_CTRL_TYPE_BITMASK, name, 0, 0xff, 0);
+        if(c) {
+            c->step = 0;
+        }
+    }
+    /* The range of a string is its length */
+    for(i=0; i<strings; i++) {
+        snprintf(name, sizeof(name), "String %d", i);
+        c = add_ctrl(id++, V4L2_CTRL_TYPE_STRING, name, 0, FAKE_STRING_SIZE - 1, 0);
+        if(c) {
+            snprintf(c->string, sizeof(c->string), "%s", name);
+        }
+    }
+    if(white_balance) {
+        add_ctrl(V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CTRL_TYPE_BOOLEAN,
+                 "White Balance, Auto", 0, 1, 1);
+        c = add_ctrl(V4L2_CID_WHITE_BALANCE_TEMPERATURE, V4L2_CTRL_TYPE_INTEGER,
+                     "White Balance Temperature", 2800, 6500, 4600);
+        if(c) {
+            c->master = V4L2_CID_AUTO_WHITE_BALANCE;
+        }
+    }
+
+    if(exposure || focus) {
+        add_ctrl(V4L2_CTRL_CLASS_CAMERA | 1, V4L2_CTRL_TYPE_CTRL_CLASS,
+                 "Camera Controls", 0, 0, 0);
+    }
+    if(exposure) {
+        m = add_ctrl(V4L2_CID_EXPOSURE_AUTO, V4L2_CTRL_TYPE_MENU, "Auto Exposure",
+                     V4L2_EXPOSURE_AUTO, V4L2_EXPOSURE_APERTURE_PRIORITY,
+                     V4L2_EXPOSURE_APERTURE_PRIORITY);
+        c = add_ctrl(V4L2_CID_EXPOSURE_ABSOLUTE, V4L2_CTRL_TYPE_INTEGER,
+                     "Exposure (Absolute)", 1, 10000, 156);
+        if(m && c) {
+            c->master = V4L2_CID_EXPOSURE_AUTO;
+        }
+    }
+    if(focus) {
+        add_ctrl(V4L2_CID_FOCUS_AUTO, V4L2_CTRL_TYPE_BOOLEAN, "Focus, Auto", 0, 1, 1);
+        c = add_ctrl(V4L2_CID_FOCUS_ABSOLUTE, V4L2_CTRL_TYPE_INTEGER,
+                     "Focus (absolute)", 0, 250, 0);
+        if(c) {
+            c->master = V4L2_CID_FOCUS_AUTO;
+        }
+    }
+    qsort(ctrls, nctrls, sizeof(*ctrls), ctrl_cmp);
+}
+
+static int configure(const char *config)
+{
+    int integers = 20, booleans = 5, menus = 5;
+    int integers64 = 1, bitmasks = 1, strings = 1;
+    int exposure = 1, white_balance = 1, focus = 1;
+    char line[256], key[64], arg[64];
+    long value, extra;
+    FILE *file = NULL;
+    int i, n;
+
+    free(ctrls);
+    ctrls = NULL;
+    nctrls = 0;
+    memset(latency, 0, sizeof(latency));
+    menu_items = 4;
+    configured = 1;
+
+    if(config) {
+        file = fopen(config, "r");
+        if(!file) {
+            fprintf(stderr, "v4l2fake: unable to open %s: %s\n", config, strerror(errno));
+            build(integers, booleans, menus, integers64, bitmasks, strings,
+                  exposure, white_balance, focus);
+            return -1;
+        }
+    }
+    while(file && fgets(line, sizeof(line), file)) {
+        if(line[0] == '#') {
+            continue;
+        }
+        n = sscanf(line, "%63s %63s %ld", key, arg, &extra);
+        if(n < 2) {
+            continue;
+        }
+        if(!strcmp(key, "latency") && n == 3) {
+            i = ioctl_index(arg);
+            if(i >= 0) {
+                latency[i] = extra;
+            }
+            continue;
+        }
+        value = atol(arg);
+        if(!strcmp(key, "integers")) {
+            integers = value;
+        } else if(!strcmp(key, "booleans")) {
+            booleans = value;
+        } else if(!strcmp(key, "menus")) {
+            menus = value;
+            if(n == 3) {
+                menu_items = extra;
+            }
+        } else if(!strcmp(key, "integers64")) {
+            integers64 = value;
+        } else if(!strcmp(key, "bitmasks")) {
+            bitmasks = value;
+        } else if(!strcmp(key, "strings")) {
+            strings = value;
+        } else if(!strcmp(key, "auto_exposure")) {
+            exposure = value;
+        } else if(!strcmp(key, "auto_white_balance")) {
+            white_balance = value;
+        } else if(!strcmp(key, "auto_focus")) {
+            focus = value;
+        } else if(!strcmp(key, "latency")) {
+            for(i=0; i<FAKE_IOCTL_COUNT; i++) {
+                latency[i] = value;
+            }
+        }
+    }
+    if(file) {
+        fclose(file);
+    }
+    if(menu_items < 1) {
+        menu_items = 1;
+    }
+    build(integers, booleans, menus, integers64, bitmasks, strings,
+          exposure, white_balance, focus);
+    return 0;
+}
+
+int fake_configure(const char *config)
+{
+    int ret;
+
+    pthread_mutex_lock(&lock);
+    ret = configure(config);
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+int fake_control_count(void)
+{
+    return nctrls;
+}
+
+void fake_reset_stats(void)
+{
+    pthread_mutex_lock(&lock);
+    memset(counts, 0, sizeof(counts));
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_get_stats(unsigned long out[FAKE_IOCTL_COUNT])
+{
+    pthread_mutex_lock(&lock);
+    memcpy(out, counts, sizeof(counts));
+    pthread_mutex_unlock(&lock);
+}
+
+static void write_stats(void)
+{
+    const char *path = getenv("V4L2FAKE_STATS");
+    FILE *file;
+    int i;
+
+    if(!path || !(file = fopen(path, "w"))) {
+        return;
+    }
+    for(i=0; i<FAKE_IOCTL_COUNT; i++) {
+        fprintf(file, "%s %lu\n", fake_ioctl_names[i], counts[i]);
+    }
+    fclose(file);
+}
+
+/*
+ * Controls
+ */
+static struct fake_ctrl *find(__u32 id)
+{
+    int lo = 0, hi = nctrls - 1, mid;
+
+    while(lo <= hi) {
+        mid = (lo + hi) / 2;
+        if(ctrls[mid].id == id) {
+            return &ctrls[mid];
+        }
+        if(ctrls[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+/* The first control after id, for V4L2_CTRL_FLAG_NEXT_CTRL */
+static struct fake_ctrl *next(__u32 id)
+{
+    int i;
+
+    for(i=0; i<nctrls; i++) {
+        if(ctrls[i].id > id) {
+            return &ctrls[i];
+        }
+    }
+    return NULL;
+}
+
+static int taken_over(const struct fake_ctrl *c)
+{
+    const struct fake_ctrl *m;
+
+    if(!c->master || !(m = find(c->master))) {
+        return 0;
+    }
+    if(m->id == V4L2_CID_EXPOSURE_AUTO) {
+        return m->value == V4L2_EXPOSURE_AUTO ||
+               m->value == V4L2_EXPOSURE_APERTURE_PRIORITY;
+    }
+    return m->value != 0;
+}
+
+static __u32 flags_of(const struct fake_ctrl *c)
+{
+    __u32 flags = c->flags;
+
+    if(taken_over(c)) {
+        flags |= V4L2_CTRL_FLAG_INACTIVE;
+    }
+    if(c->id == V4L2_CID_EXPOSURE_AUTO || c->id == V4L2_CID_AUTO_WHITE_BALANCE ||
+       c->id == V4L2_CID_FOCUS_AUTO) {
+        flags |= V4L2_CTRL_FLAG_UPDATE;
+    }
+    if(c->type == V4L2_CTRL_TYPE_STRING) {
+        flags |= V4L2_CTRL_FLAG_HAS_PAYLOAD;
+    }
+    return flags;
+}
+
+static struct fake_ctrl *lookup(__u32 id, __u32 mask)
+{
+    if(id & mask) {
+        return next(id & ~mask);
+    }
+    return find(id);
+}
+
+static int query(struct v4l2_queryctrl *q)
+{
+    struct fake_ctrl *c = lookup(q->id, V4L2_CTRL_FLAG_NEXT_CTRL);
+
+    if(!c) {
+        return EINVAL;
+    }
+    memset(q, 0, sizeof(*q));
+    q->id = c->id;
+    q->type = c->type;
+    memcpy(q->name, c->name, sizeof(q->name));
+    q->minimum = c->minimum;
+    q->maximum = c->maximum;
+    q->step = c->step;
+    q->default_value = c->default_value;
+    q->flags = flags_of(c);
+    return 0;
+}
+
+static int query_ext(struct v4l2_query_ext_ctrl *q)
+{
+    struct fake_ctrl *c = lookup(q->id, V4L2_CTRL_FLAG_NEXT_CTRL |
+                                        V4L2_CTRL_FLAG_NEXT_COMPOUND);
+
+    if(!c) {
+        return EINVAL;
+    }
+    memset(q, 0, sizeof(*q));
+    q->id = c->id;
+    q->type = c->type;
+    memcpy(q->name, c->name, sizeof(q->name));
+    q->minimum = c->minimum;
+    q->maximum = c->maximum;
+    q->step = c->step;
+    q->default_value = c->default_value;
+    q->flags = flags_of(c);
+    q->elem_size = sizeof(__s32);
+    q->elems = 1;
+    if(c->type == V4L2_CTRL_TYPE_INTEGER64) {
+        q->minimum = -FAKE_MAX64;
+        q->maximum = FAKE_MAX64;
+        q->elem_size = sizeof(__s64);
+    } else if(c->type == V4L2_CTRL_TYPE_STRING) {
+        q->elem_size = FAKE_STRING_SIZE;
+    }
+    return 0;
+}
+
+static int query_menu(struct v4l2_querymenu *qm)
+{
+    static const char *exposure[] = {
+        "Auto Mode", "Manual Mode", "Shutter Priority Mode", "Aperture Priority Mode"
+    };
+    struct fake_ctrl *c = find(qm->id);
+
+    if(!c || c->type != V4L2_CTRL_TYPE_MENU ||
+       (__s32)qm->index < c->minimum || (__s32)qm->index > c->maximum) {
+        return EINVAL;
+    }
+    if(c->id == V4L2_CID_EXPOSURE_AUTO && qm->index < 4) {
+        snprintf((char *)qm->name, sizeof(qm->name), "%s", exposure[qm->index]);
+    } else {
+        snprintf((char *)qm->name, sizeof(qm->name), "Item %u", qm->index);
+    }
+    return 0;
+}
+
+/* The ones VIDIOC_G_CTRL and VIDIOC_S_CTRL take */
+static int check_int(const struct fake_ctrl *c)
+{
+    if(c && (c->type == V4L2_CTRL_TYPE_INTEGER64 || c->type == V4L2_CTRL_TYPE_STRING)) {
+        return EINVAL;
+    }
+    return 0;
+}
+
+static int check_get(const struct fake_ctrl *c)
+{
+    if(!c || c->type == V4L2_CTRL_TYPE_CTRL_CLASS) {
+        return EINVAL;
+    }
+    return c->flags & V4L2_CTRL_FLAG_WRITE_ONLY ? EACCES : 0;
+}
+
+/* Like UVC, a control an auto mode has taken over cannot be written */
+static int check_set(const struct fake_ctrl *c, __s32 value)
+{
+    if(!c || c->type == V4L2_CTRL_TYPE_CTRL_CLASS) {
+        return EINVAL;
+    }
+    if((c->flags & V4L2_CTRL_FLAG_READ_ONLY) || taken_over(c)) {
+        return EACCES;
+    }
+    if(c->type == V4L2_CTRL_TYPE_MENU &&
+       (value < c->minimum || value > c->maximum)) {
+        return EINVAL;
+    }
+    if(c->type == V4L2_CTRL_TYPE_BITMASK && ((__u32)value & ~(__u32)c->maximum)) {
+        return EINVAL;
+    }
+    return 0;
+}
+
+/* Strings are read into and written from the buffer of the caller */
+static int check_string(unsigned long request, const struct fake_ctrl *c,
+                        struct v4l2_ext_control *e)
+{
+    if(request == VIDIOC_G_EXT_CTRLS) {
+        if(e->size < strlen(c->string) + 1) {
+            e->size = FAKE_STRING_SIZE;
+            return ENOSPC;
+        }
+        return 0;
+    }
+    if(!e->size || !e->string || strnlen(e->string, e->size) > (size_t)c->maximum) {
+        return ERANGE;
+    }
+    return 0;
+}
+
+static __s32 clamp(const struct fake_ctrl *c, __s32 value)
+{
+    if(value < c->minimum) {
+        return c->minimum;
+    }
+    if(value > c->maximum) {
+        return c->maximum;
+    }
+    return value;
+}
+
+static int ext(unsigned long request, struct v4l2_ext_controls *ext)
+{
+    struct fake_ctrl *c;
+    __u32 i;
+    int err;
+
+    /* Validate everything first, nothing is applied on an error */
+    for(i=0; i<ext->count; i++) {
+        struct v4l2_ext_control *e = &ext->controls[i];
+        c = find(e->id);
+        if(ext->ctrl_class && c && V4L2_CTRL_ID2CLASS(e->id) != ext->ctrl_class) {
+            c = NULL;
+        }
+        err = request == VIDIOC_G_EXT_CTRLS ? check_get(c) : check_set(c, e->value);
+        if(!err && c->type == V4L2_CTRL_TYPE_STRING) {
+            err = check_string(request, c, e);
+        }
+        if(err) {
+            ext->error_idx = i;
+            return err;
+        }
+    }
+    for(i=0; i<ext->count; i++) {
+        struct v4l2_ext_control *e = &ext->controls[i];
+        c = find(e->id);
+        if(c->type == V4L2_CTRL_TYPE_INTEGER64) {
+            if(request == VIDIOC_G_EXT_CTRLS) {
+                e->value64 = c->value64;
+            } else {
+                e->value64 = e->value64 < -FAKE_MAX64 ? -FAKE_MAX64 :
+                             e->value64 > FAKE_MAX64 ? FAKE_MAX64 : e->value64;
+                if(request == VIDIOC_S_EXT_CTRLS) {
+                    c->value64 = e->value64;
+                }
+            }
+        } else if(c->type == V4L2_CTRL_TYPE_STRING) {
+            if(request == VIDIOC_G_EXT_CTRLS) {
+                strcpy(e->string, c->string);
+            } else if(request == VIDIOC_S_EXT_CTRLS) {
+                memset(c->string, 0, sizeof(c->string));
+                memcpy(c->string, e->string, strnlen(e->string, e->size));
+            }
+        } else if(request == VIDIOC_G_EXT_CTRLS) {
+            e->value = c->value;
+        } else {
+            e->value = clamp(c, e->value);
+            if(request == VIDIOC_S_EXT_CTRLS) {
+                c->value = e->value;
+            }
+        }
+    }
+    return 0;
+}
+
+static int handle(int fd, unsigned long request, void *arg, int *which)
+{
+    struct v4l2_capability *cap;
+    struct v4l2_control *ctl;
+    struct fake_ctrl *c;
+    const char *node;
+    int err;
+
+    switch(request) {
+    case VIDIOC_QUERYCAP:
+        *which = FAKE_QUERYCAP;
+        cap = arg;
+        memset(cap, 0, sizeof(*cap));
+        node = strrchr(paths[fd], '/');
+        node = node ? node + 1 : paths[fd];
+        snprintf((char *)cap->driver, sizeof(cap->driver), "v4l2fake");
+        snprintf((char *)cap->card, sizeof(cap->card), "Fake Camera");
+        snprintf((char *)cap->bus_info, sizeof(cap->bus_info), "fake:%s", node);
+        cap->version = 0x050000;
+        cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+        cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+        return 0;
+    case VIDIOC_QUERYCTRL:
+        *which = FAKE_QUERYCTRL;
+        return query(arg);
+    case VIDIOC_QUERY_EXT_CTRL:
+        *which = FAKE_QUERY_EXT_CTRL;
+        return query_ext(arg);
+    case VIDIOC_QUERYMENU:
+        *which = FAKE_QUERYMENU;
+        return query_menu(arg);
+    case VIDIOC_G_CTRL:
+        *which = FAKE_G_CTRL;
+        ctl = arg;
+        c = find(ctl->id);
+        if((err = check_get(c)) || (err = check_int(c))) {
+            return err;
+        }
+        ctl->value = c->value;
+        return 0;
+    case VIDIOC_S_CTRL:
+        *which = FAKE_S_CTRL;
+        ctl = arg;
+        c = find(ctl->id);
+        if((err = check_set(c, ctl->value)) || (err = check_int(c))) {
+            return err;
+        }
+        c->value = ctl->value = clamp(c, ctl->value);
+        return 0;
+    case VIDIOC_G_EXT_CTRLS:
+        *which = FAKE_G_EXT_CTRLS;
+        return ext(request, arg);
+    case VIDIOC_S_EXT_CTRLS:
+        *which = FAKE_S_EXT_CTRLS;
+        return ext(request, arg);
+    case VIDIOC_TRY_EXT_CTRLS:
+        *which = FAKE_TRY_EXT_CTRLS;
+        return ext(request, arg);
+    case VIDIOC_SUBSCRIBE_EVENT:
+        *which = FAKE_SUBSCRIBE_EVENT;
+        return 0;
+    case VIDIOC_DQEVENT:
+        /* Our own writes are the only ones, and they do not send events */
+        *which = FAKE_DQEVENT;
+        return ENOENT;
+    default:
+        *which = FAKE_OTHER;
+        return ENOTTY;
+    }
+}
+
+/*
+ * libv4l2
+ */
+int v4l2_open(const char *file, int oflag, ...)
+{
+    int fd;
+
+    (void)oflag;
+    pthread_mutex_lock(&lock);
+    if(!configured) {
+        configure(getenv("V4L2FAKE_CONFIG"));
+        atexit(write_stats);
+    }
+    pthread_mutex_unlock(&lock);
+
+    /* A real descriptor, so that it can be polled */
+    fd = open("/dev/null", O_RDWR);
+    if(fd < 0) {
+        return -1;
+    }
+    if(fd >= MAX_FDS) {
+        close(fd);
+        errno = EMFILE;
+        return -1;
+    }
+    pthread_mutex_lock(&lock);
+    free(paths[fd]);
+    paths[fd] = strdup(file);
+    pthread_mutex_unlock(&lock);
+    return fd;
+}
+
+int v4l2_close(int fd)
+{
+    if(fd >= 0 && fd < MAX_FDS) {
+        pthread_mutex_lock(&lock);
+        free(paths[fd]);
+        paths[fd] = NULL;
+        pthread_mutex_unlock(&lock);
+    }
+    return close(fd);
+}
+
+int v4l2_ioctl(int fd, unsigned long int request, ...)
+{
+    struct timespec ts;
+    va_list ap;
+    void *arg;
+    int which, err;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if(fd < 0 || fd >= MAX_FDS || !paths[fd]) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&lock);
+    err = handle(fd, request, arg, &which);
+    counts[which]++;
+    pthread_mutex_unlock(&lock);
+
+    /* The bus transfer, devices do not wait for each other */
+    if(latency[which] > 0) {
+        ts.tv_sec = latency[which] / 1000000;
+        ts.tv_nsec = latency[which] % 1000000 * 1000;
+        nanosleep(&ts, NULL);
+    }
+    if(err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
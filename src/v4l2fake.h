@@ -0,0 +1,81 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#ifndef V4L2FAKE_H
+#define V4L2FAKE_H
+
+/* A camera in user space, for measuring v4l2ucp and v4l2ctrl without one.
+   v4l2fake.c defines v4l2_open(), v4l2_ioctl() and v4l2_close(). Linked
+   into a program it replaces libv4l2, built as a shared library it can be
+   put in front of it with LD_PRELOAD.
+
+   The controls and the time every ioctl takes are read from the file
+   named by V4L2FAKE_CONFIG, one setting per line:
+
+       integers 40             driver specific integer controls
+       booleans 10             boolean controls
+       menus 10 5              menu controls, 5 items each
+       integers64 1            64 bit integer controls
+       bitmasks 1              bitmask controls
+       strings 1               string controls, read and written through
+                               VIDIOC_G/S_EXT_CTRLS only
+       auto_exposure 1         exposure auto gating exposure absolute
+       auto_white_balance 1    white balance auto gating the temperature
+       auto_focus 1            focus auto gating focus absolute
+       latency 500             microseconds every ioctl takes
+       latency S_CTRL 2000     the same for one ioctl, by name
+
+   Any device name opens the fake camera; every node gets its own
+   bus_info. When V4L2FAKE_STATS names a file, the number of ioctls of
+   each kind is written to it on exit. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum fake_ioctl {
+    FAKE_QUERYCAP,
+    FAKE_QUERYCTRL,
+    FAKE_QUERY_EXT_CTRL,
+    FAKE_QUERYMENU,
+    FAKE_G_CTRL,
+    FAKE_S_CTRL,
+    FAKE_G_EXT_CTRLS,
+    FAKE_S_EXT_CTRLS,
+    FAKE_TRY_EXT_CTRLS,
+    FAKE_SUBSCRIBE_EVENT,
+    FAKE_DQEVENT,
+    FAKE_OTHER,
+    FAKE_IOCTL_COUNT
+};
+
+extern const char *const fake_ioctl_names[FAKE_IOCTL_COUNT];
+
+/* Load the configuration, done by the first v4l2_open() otherwise.
+   Returns -1 when the file cannot be read. */
+int fake_configure(const char *config);
+int fake_control_count(void);
+void fake_reset_stats(void);
+void fake_get_stats(unsigned long counts[FAKE_IOCTL_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,467 @@
+/*  v4l2ctrl - A program for saving and loading settings for V4L2 devices
+    Copyright (C) 2008-2009 Scott J. Bertin (scottbertin@yahoo.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <libv4l2.h>
+
+#include "v4l2ctrl.h"
+
+/* Fleet mode: save or load many devices with one invocation. The devices
+   are spread over a small pool of threads, so the whole fleet takes about
+   as long as its slowest device. */
+
+#define DEFAULT_WORKERS 8
+
+enum job_status {
+    JOB_OK,
+    JOB_SKIPPED,
+    JOB_FAILED,
+};
+
+struct fleet_job {
+    char path[PATH_MAX];
+    struct v4l2_capability cap;
+    enum job_status status;
+    char source[PATH_MAX];      /* profile, preset or file written */
+    char message[64];
+    long long open_us;
+    long long apply_us;
+    long long total_us;
+};
+
+struct fleet {
+    struct fleet_job *jobs;
+    int count;
+    int next;                   /* next job to take, atomically */
+    int atomic;
+    int changed;                /* only write what differs */
+    const char *pattern;        /* saving: file name of each device */
+    const struct profile *all;  /* loading: one profile for every device */
+    const struct profile *profiles;
+    int nprofiles;
+    const struct profile_library *lib;
+    const char *preset;
+};
+
+static long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void job_result(struct fleet_job *j, enum job_status status, const char *msg,
+                       int err)
+{
+    char buf[64];
+
+    j->status = status;
+    if(err) {
+        /* strerror() is not thread safe */
+        snprintf(j->message, sizeof(j->message), "%.20s: %.40s", msg,
+                 strerror_r(err, buf, sizeof(buf)) == 0 ? buf : "error");
+    } else {
+        snprintf(j->message, sizeof(j->message), "%s", msg);
+    }
+}
+
+/* Copy of the settings with payloads of their own: the driver writes the
+   applied values back, and several devices may share a profile */
+static int copy_settings(const struct setting *src, int count,
+                         struct setting **dst, char **buf)
+{
+    size_t total = 0, off = 0;
+    int i;
+
+    for(i=0; i<count; i++) {
+        total += src[i].size;
+    }
+    *dst = malloc((count ? count : 1) * sizeof(**dst));
+    *buf = malloc(total ? total : 1);
+    if(!*dst || !*buf) {
+        free(*dst);
+        free(*buf);
+        return -1;
+    }
+    memcpy(*dst, src, count * sizeof(**dst));
+    for(i=0; i<count; i++) {
+        if(src[i].size) {
+            memcpy(*buf + off, src[i].data, src[i].size);
+            (*dst)[i].data = *buf + off;
+            off += src[i].size;
+        }
+    }
+    return 0;
+}
+
+static void append_name(char *out, size_t size, size_t *len, const char *v)
+{
+    for(; *v && *len + 1 < size; v++) {
+        if((*v >= 'a' && *v <= 'z') || (*v >= 'A' && *v <= 'Z') ||
+           (*v >= '0' && *v <= '9') || *v == '.' || *v == '-' || *v == '_') {
+            out[(*len)++] = *v;
+        } else {
+            out[(*len)++] = '_';
+        }
+    }
+}
+
+/* %n device node name, %b bus_info, %c card, %d driver, %% a % */
+static void expand_pattern(const char *pattern, const struct fleet_job *j,
+                           char *out, size_t size)
+{
+    const char *p, *node = strrchr(j->path, '/');
+    size_t len = 0;
+
+    node = node ? node + 1 : j->path;
+    for(p=pattern; *p && len + 1 < size; p++) {
+        if(*p != '%' || !p[1]) {
+            out[len++] = *p;
+            continue;
+        }
+        switch(*++p) {
+        case 'n':
+            append_name(out, size, &len, node);
+            break;
+        case 'b':
+            append_name(out, size, &len, (const char *)j->cap.bus_info);
+            break;
+        case 'c':
+            append_name(out, size, &len, (const char *)j->cap.card);
+            break;
+        case 'd':
+            append_name(out, size, &len, (const char *)j->cap.driver);
+            break;
+        default:
+            out[len++] = *p;
+            break;
+        }
+    }
+    out[len] = 0;
+}
+
+static void save_job(struct fleet *f, struct fleet_job *j, int fd)
+{
+    FILE *file;
+
+    expand_pattern(f->pattern, j, j->source, sizeof(j->source));
+    file = fopen(j->source, "w");
+    if(!file) {
+        job_result(j, JOB_FAILED, "open file", errno);
+        return;
+    }
+    if(do_save_ext(fd, file) != EXIT_SUCCESS) {
+        job_result(j, JOB_FAILED, "save failed", 0);
+    } else {
+        job_result(j, JOB_OK, "saved", 0);
+    }
+    if(fclose(file)) {
+        job_result(j, JOB_FAILED, "write file", errno);
+    }
+}
+
+static void load_job(struct fleet *f, struct fleet_job *j, int fd)
+{
+    const struct profile *p = f->all;
+    struct setting *settings = NULL, *own;
+    char *buf;
+    int i = -1, count = 0, ret;
+
+    if(f->lib) {
+        /* The bus position is the more specific identity */
+        i = library_find(f->lib, (const char *)j->cap.bus_info, f->preset);
+        if(i < 0) {
+            i = library_find(f->lib, (const char *)j->cap.card, f->preset);
+        }
+        if(i < 0) {
+            job_result(j, JOB_SKIPPED, "no preset", 0);
+            return;
+        }
+        count = library_settings(f->lib, i, &settings);
+        if(count < 0) {
+            job_result(j, JOB_FAILED, "damaged library", 0);
+            return;
+        }
+        snprintf(j->source, sizeof(j->source), "%s/%s", library_identity(f->lib, i),
+                 f->preset);
+    } else {
+        if(!p) {
+            p = match_profile(f->profiles, f->nprofiles, j->path, &j->cap);
+        }
+        if(!p) {
+            job_result(j, JOB_SKIPPED, "no profile", 0);
+            return;
+        }
+        snprintf(j->source, sizeof(j->source), "%s", p->path);
+    }
+
+    if(copy_settings(f->lib ? settings : p->settings, f->lib ? count : p->count,
+                     &own, &buf)) {
+        free(settings);
+        job_result(j, JOB_FAILED, "out of memory", 0);
+        return;
+    }
+    if(!f->lib) {
+        count = p->count;
+    }
+    free(settings);
+
+    if(f->changed) {
+        struct load_stats stats;
+        ret = load_settings_changed(fd, own, count, f->atomic, &stats);
+        j->status = ret == EXIT_SUCCESS ? JOB_OK : JOB_FAILED;
+        snprintf(j->message, sizeof(j->message), "%d written, %d skipped, %d failed",
+                 stats.written, stats.skipped, stats.failed);
+    } else {
+        if(f->atomic) {
+            ret = load_settings_atomic(fd, own, count);
+        } else {
+            ret = load_settings(fd, own, count);
+        }
+        job_result(j, ret == EXIT_SUCCESS ? JOB_OK : JOB_FAILED,
+                   ret == EXIT_SUCCESS ? "loaded" : "load failed", 0);
+    }
+    free(own);
+    free(buf);
+}
+
+static void run_job(struct fleet *f, struct fleet_job *j)
+{
+    long long start = now_us(), t;
+    int fd;
+
+    fd = v4l2_open(j->path, O_RDWR, 0);
+    j->open_us = now_us() - start;
+    if(fd < 0) {
+        job_result(j, JOB_FAILED, "open", errno);
+        j->total_us = now_us() - start;
+        return;
+    }
+
+    if(core_ioctl(fd, VIDIOC_QUERYCAP, &j->cap) == -1) {
+        job_result(j, JOB_SKIPPED, "not a V4L2 device", 0);
+    } else if(is_metadata_node(&j->cap)) {
+        job_result(j, JOB_SKIPPED, "metadata node", 0);
+    } else {
+        t = now_us();
+        if(f->pattern) {
+            save_job(f, j, fd);
+        } else {
+            load_job(f, j, fd);
+        }
+        j->apply_us = now_us() - t;
+    }
+
+    v4l2_close(fd);
+    j->total_us = now_us() - start;
+}
+
+static void *fleet_worker(void *arg)
+{
+    struct fleet *f = arg;
+    int i;
+
+    while((i = __sync_fetch_and_add(&f->next, 1)) < f->count) {
+        run_job(f, &f->jobs[i]);
+    }
+    return NULL;
+}
+
+static void print_table(const struct fleet *f, long long wall)
+{
+    static const char *status[] = { "ok", "skipped", "FAILED" };
+    long long sum = 0, slowest = 0;
+    int i, n[3] = { 0, 0, 0 };
+
+    printf("%-16s %-24s %-8s %8s %8s %8s  %s\n", "device", "bus_info", "result",
+           "open", "apply", "total", "profile");
+    for(i=0; i<f->count; i++) {
+        const struct fleet_job *j = &f->jobs[i];
+        n[j->status]++;
+        sum += j->total_us;
+        if(j->total_us > slowest) {
+            slowest = j->total_us;
+        }
+        printf("%-16s %-24s %-8s %8.1f %8.1f %8.1f  %s", j->path,
+               (const char *)j->cap.bus_info, status[j->status],
+               j->open_us / 1000.0, j->apply_us / 1000.0, j->total_us / 1000.0,
+               j->source);
+        if(j->status != JOB_OK || (f->changed && !f->pattern)) {
+            printf("%s(%s)", *j->source ? " " : "", j->message);
+        }
+        printf("\n");
+    }
+    printf("%d devices: %d ok, %d skipped, %d failed. %.1f ms, slowest %.1f ms, "
+           "%.1f ms one after another. Times in ms.\n", f->count, n[JOB_OK],
+           n[JOB_SKIPPED], n[JOB_FAILED], wall / 1000.0, slowest / 1000.0,
+           sum / 1000.0);
+}
+
+/* Device arguments may be globs, without any the video nodes are scanned */
+static int add_devices(struct fleet *f, const char **devices, int ndevices)
+{
+    static const char *scan[] = { "/dev/video*" };
+    struct fleet_job *tmp;
+    glob_t g;
+    size_t k;
+    int i, ret;
+
+    if(!ndevices) {
+        devices = scan;
+        ndevices = 1;
+    }
+    for(i=0; i<ndevices; i++) {
+        memset(&g, 0, sizeof(g));
+        ret = glob(devices[i], GLOB_NOCHECK, NULL, &g);
+        if(ret) {
+            globfree(&g);
+            continue;
+        }
+        for(k=0; k<g.gl_pathc; k++) {
+            /* GLOB_NOCHECK hands back a pattern which matched nothing */
+            if(devices == scan && !strcmp(g.gl_pathv[k], scan[0])) {
+                continue;
+            }
+            tmp = realloc(f->jobs, (f->count + 1) * sizeof(*tmp));
+            if(!tmp) {
+                globfree(&g);
+                fprintf(stderr, "Out of memory\n");
+                return -1;
+            }
+            f->jobs = tmp;
+            memset(&f->jobs[f->count], 0, sizeof(*tmp));
+            snprintf(f->jobs[f->count].path, PATH_MAX, "%s", g.gl_pathv[k]);
+            f->count++;
+        }
+        globfree(&g);
+    }
+    return 0;
+}
+
+int run_fleet(const char **devices, int ndevices, int workers,
+              const char *pattern, const char *filename, const char *config,
+              const char *library, const char *preset, int atomic,
+              int changed)
+{
+    struct fleet f;
+    struct profile all;
+    pthread_t *threads = NULL;
+    long long start;
+    int i, started = 0, ret = EXIT_FAILURE;
+    FILE *file;
+
+    memset(&f, 0, sizeof(f));
+    memset(&all, 0, sizeof(all));
+    f.atomic = atomic;
+    f.changed = changed;
+    f.pattern = pattern;
+    f.preset = preset;
+
+    if(add_devices(&f, devices, ndevices)) {
+        goto out;
+    }
+    if(!f.count) {
+        fprintf(stderr, "No devices\n");
+        goto out;
+    }
+    if(pattern && f.count > 1 && !strchr(pattern, '%')) {
+        fprintf(stderr, "%s would be written for every device, use %%n, %%b "
+                "or %%c in it\n", pattern);
+        goto out;
+    }
+
+    if(filename) {
+        file = fopen(filename, "r");
+        if(!file) {
+            fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
+            goto out;
+        }
+        all.count = read_settings(file, &all.settings);
+        fclose(file);
+        if(all.count < 0) {
+            goto out;
+        }
+        all.path = (char *)filename;
+        f.all = &all;
+    } else if(config) {
+        f.nprofiles = read_config(config, (struct profile **)&f.profiles);
+        if(f.nprofiles < 0) {
+            goto out;
+        }
+    } else if(library) {
+        f.lib = library_open(library);
+        if(!f.lib) {
+            fprintf(stderr, "Unable to read library %s: %s\n", library, strerror(errno));
+            goto out;
+        }
+    }
+
+    if(workers <= 0) {
+        workers = DEFAULT_WORKERS;
+    }
+    if(workers > f.count) {
+        workers = f.count;
+    }
+    threads = calloc(workers, sizeof(*threads));
+
+    start = now_us();
+    for(i=0; threads && i<workers; i++) {
+        if(pthread_create(&threads[i], NULL, fleet_worker, &f)) {
+            break;
+        }
+        started++;
+    }
+    /* Whatever is left when threads could not be created is done here */
+    fleet_worker(&f);
+    for(i=0; i<started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    print_table(&f, now_us() - start);
+
+    ret = EXIT_SUCCESS;
+    for(i=0; i<f.count; i++) {
+        if(f.jobs[i].status == JOB_FAILED) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+out:
+    free(threads);
+    free(f.jobs);
+    if(all.count > 0) {
+        free_settings(all.settings, all.count);
+    }
+    if(f.nprofiles > 0) {
+        free_profiles((struct profile *)f.profiles, f.nprofiles);
+    }
+    library_close((struct profile_library *)f.lib);
+    return ret;
+}
@@ -0,0 +1,620 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <pthread.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FRAME_X86 1
+#include <immintrin.h>
+#endif
+
+#include "v4l2core.h"
+
+/* Every kernel computes in 16 bit lanes with the same 6 bit coefficients
+   and the same order of saturating operations, so all of them give the
+   bytes of the scalar code. (y - 16) * 75 + 32 stays below 18000, adding
+   the chroma terms only saturates where the result clips to 255. */
+#define YC 75
+#define RV 102
+#define GU 25
+#define GV 52
+#define BU 129
+
+/* No band of rows is made smaller than this */
+#define MIN_BAND_ROWS 64
+#define MAX_THREADS 8
+
+typedef void (*frame_row)(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width);
+
+/* The row functions of one kernel. Packed formats pass the row as y,
+   NV12 its interleaved chroma row as u. */
+struct row_kernels {
+    frame_row yuyv, uyvy, nv12, i420, grey;
+};
+
+static inline int sat16(int v)
+{
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+}
+
+static inline unsigned char clip(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static inline __u32 yuv_pixel(int y, int d, int e)
+{
+    int ys = (y - 16) * YC + 32;
+
+    return 0xff000000u |
+           (__u32)clip(sat16(ys + RV * e) >> 6) << 16 |
+           (__u32)clip(sat16(ys - (GU * d + GV * e)) >> 6) << 8 |
+           (__u32)clip(sat16(ys + BU * d) >> 6);
+}
+
+/* The luma samples ystep bytes apart and one chroma pair per two pixels,
+   cstep bytes apart. Covers the packed and the planar layouts. */
+static void yuv_row(const unsigned char *y, int ystep, const unsigned char *u,
+                    const unsigned char *v, int cstep, __u32 *dst, int width)
+{
+    int x, d, e;
+
+    for(x=0; x+1<width; x+=2) {
+        d = *u - 128;
+        e = *v - 128;
+        dst[x] = yuv_pixel(y[0], d, e);
+        dst[x + 1] = yuv_pixel(y[ystep], d, e);
+        y += 2 * ystep;
+        u += cstep;
+        v += cstep;
+    }
+    if(x < width) {
+        dst[x] = yuv_pixel(y[0], *u - 128, *v - 128);
+    }
+}
+
+static void yuyv_row_c(const unsigned char *y, const unsigned char *u,
+                       const unsigned char *v, __u32 *dst, int width)
+{
+    yuv_row(y, 2, y + 1, y + 3, 4, dst, width);
+}
+
+static void uyvy_row_c(const unsigned char *y, const unsigned char *u,
+                       const unsigned char *v, __u32 *dst, int width)
+{
+    yuv_row(y + 1, 2, y, y + 2, 4, dst, width);
+}
+
+static void nv12_row_c(const unsigned char *y, const unsigned char *u,
+                       const unsigned char *v, __u32 *dst, int width)
+{
+    yuv_row(y, 1, u, u + 1, 2, dst, width);
+}
+
+static void i420_row_c(const unsigned char *y, const unsigned char *u,
+                       const unsigned char *v, __u32 *dst, int width)
+{
+    yuv_row(y, 1, u, v, 1, dst, width);
+}
+
+static void grey_row_c(const unsigned char *y, const unsigned char *u,
+                       const unsigned char *v, __u32 *dst, int width)
+{
+    int x;
+
+    for(x=0; x<width; x++) {
+        dst[x] = 0xff000000u | y[x] * 0x010101u;
+    }
+}
+
+static const struct row_kernels scalar_kernels = {
+    yuyv_row_c, uyvy_row_c, nv12_row_c, i420_row_c, grey_row_c
+};
+
+#ifdef FRAME_X86
+/* SSE2: 16 pixels a step, y and the chroma differences as 8 words per
+   register, each chroma word already doubled for its two pixels */
+__attribute__((target("sse2")))
+static inline void sse2_rgb(__m128i y, __m128i d, __m128i e,
+                            __m128i *r, __m128i *g, __m128i *b)
+{
+    __m128i ys = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)),
+                                               _mm_set1_epi16(YC)),
+                               _mm_set1_epi16(32));
+
+    *r = _mm_srai_epi16(_mm_adds_epi16(ys, _mm_mullo_epi16(e, _mm_set1_epi16(RV))), 6);
+    *g = _mm_srai_epi16(_mm_subs_epi16(ys, _mm_add_epi16(_mm_mullo_epi16(d, _mm_set1_epi16(GU)),
+                                                         _mm_mullo_epi16(e, _mm_set1_epi16(GV)))), 6);
+    *b = _mm_srai_epi16(_mm_adds_epi16(ys, _mm_mullo_epi16(d, _mm_set1_epi16(BU))), 6);
+}
+
+__attribute__((target("sse2")))
+static inline void sse2_store(__m128i b8, __m128i g8, __m128i r8, __u32 *dst)
+{
+    __m128i a8 = _mm_set1_epi8((char)0xff);
+    __m128i bg_lo = _mm_unpacklo_epi8(b8, g8), bg_hi = _mm_unpackhi_epi8(b8, g8);
+    __m128i ra_lo = _mm_unpacklo_epi8(r8, a8), ra_hi = _mm_unpackhi_epi8(r8, a8);
+
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128((__m128i *)(dst + 8), _mm_unpacklo_epi16(bg_hi, ra_hi));
+    _mm_storeu_si128((__m128i *)(dst + 12), _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+/* 16 pixels from 16 luma bytes and 8 chroma words each */
+__attribute__((target("sse2")))
+static inline void sse2_pixels(__m128i y8, __m128i u, __m128i v, __u32 *dst)
+{
+    __m128i zero = _mm_setzero_si128(), c128 = _mm_set1_epi16(128);
+    __m128i d = _mm_sub_epi16(u, c128), e = _mm_sub_epi16(v, c128);
+    __m128i r0, g0, b0, r1, g1, b1;
+
+    sse2_rgb(_mm_unpacklo_epi8(y8, zero), _mm_unpacklo_epi16(d, d),
+             _mm_unpacklo_epi16(e, e), &r0, &g0, &b0);
+    sse2_rgb(_mm_unpackhi_epi8(y8, zero), _mm_unpackhi_epi16(d, d),
+             _mm_unpackhi_epi16(e, e), &r1, &g1, &b1);
+    sse2_store(_mm_packus_epi16(b0, b1), _mm_packus_epi16(g0, g1),
+               _mm_packus_epi16(r0, r1), dst);
+}
+
+/* Split 16 bytes of interleaved chroma into u and v words */
+#define SSE2_SPLIT_UV(uv, u, v) do { \
+        u = _mm_and_si128(uv, _mm_set1_epi16(0xff)); \
+        v = _mm_srli_epi16(uv, 8); \
+    } while(0)
+
+__attribute__((target("sse2")))
+static void yuyv_row_sse2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m128i mask = _mm_set1_epi16(0xff), a, b, uv, cu, cv;
+    int x;
+
+    for(x=0; x+16<=width; x+=16) {
+        a = _mm_loadu_si128((const __m128i *)(y + 2 * x));
+        b = _mm_loadu_si128((const __m128i *)(y + 2 * x + 16));
+        uv = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        SSE2_SPLIT_UV(uv, cu, cv);
+        sse2_pixels(_mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)),
+                    cu, cv, dst + x);
+    }
+    yuyv_row_c(y + 2 * x, NULL, NULL, dst + x, width - x);
+}
+
+__attribute__((target("sse2")))
+static void uyvy_row_sse2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m128i mask = _mm_set1_epi16(0xff), a, b, uv, cu, cv;
+    int x;
+
+    for(x=0; x+16<=width; x+=16) {
+        a = _mm_loadu_si128((const __m128i *)(y + 2 * x));
+        b = _mm_loadu_si128((const __m128i *)(y + 2 * x + 16));
+        uv = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        SSE2_SPLIT_UV(uv, cu, cv);
+        sse2_pixels(_mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)),
+                    cu, cv, dst + x);
+    }
+    uyvy_row_c(y + 2 * x, NULL, NULL, dst + x, width - x);
+}
+
+__attribute__((target("sse2")))
+static void nv12_row_sse2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m128i uv, cu, cv;
+    int x;
+
+    for(x=0; x+16<=width; x+=16) {
+        uv = _mm_loadu_si128((const __m128i *)(u + x));
+        SSE2_SPLIT_UV(uv, cu, cv);
+        sse2_pixels(_mm_loadu_si128((const __m128i *)(y + x)), cu, cv, dst + x);
+    }
+    nv12_row_c(y + x, u + x, NULL, dst + x, width - x);
+}
+
+__attribute__((target("sse2")))
+static void i420_row_sse2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m128i zero = _mm_setzero_si128();
+    int x;
+
+    for(x=0; x+16<=width; x+=16) {
+        sse2_pixels(_mm_loadu_si128((const __m128i *)(y + x)),
+                    _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u + x / 2)), zero),
+                    _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v + x / 2)), zero),
+                    dst + x);
+    }
+    i420_row_c(y + x, u + x / 2, v + x / 2, dst + x, width - x);
+}
+
+__attribute__((target("sse2")))
+static void grey_row_sse2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m128i g;
+    int x;
+
+    for(x=0; x+16<=width; x+=16) {
+        g = _mm_loadu_si128((const __m128i *)(y + x));
+        sse2_store(g, g, g, dst + x);
+    }
+    grey_row_c(y + x, NULL, NULL, dst + x, width - x);
+}
+
+static const struct row_kernels sse2_kernels = {
+    yuyv_row_sse2, uyvy_row_sse2, nv12_row_sse2, i420_row_sse2, grey_row_sse2
+};
+
+/* AVX2: 32 pixels a step, computed as two halves of 16 words in pixel
+   order. The byte packing works within 128 bit lanes, the final
+   permutes put the pixels back in order. */
+__attribute__((target("avx2")))
+static inline void avx2_rgb(__m256i y, __m256i u, __m256i v,
+                            __m256i *r, __m256i *g, __m256i *b)
+{
+    __m256i c128 = _mm256_set1_epi16(128);
+    __m256i d = _mm256_sub_epi16(u, c128), e = _mm256_sub_epi16(v, c128);
+    __m256i ys = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)),
+                                                     _mm256_set1_epi16(YC)),
+                                  _mm256_set1_epi16(32));
+
+    *r = _mm256_srai_epi16(_mm256_adds_epi16(ys, _mm256_mullo_epi16(e, _mm256_set1_epi16(RV))), 6);
+    *g = _mm256_srai_epi16(_mm256_subs_epi16(ys, _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(GU)),
+                                                                  _mm256_mullo_epi16(e, _mm256_set1_epi16(GV)))), 6);
+    *b = _mm256_srai_epi16(_mm256_adds_epi16(ys, _mm256_mullo_epi16(d, _mm256_set1_epi16(BU))), 6);
+}
+
+/* b8, g8 and r8 hold pixels 0-7 and 16-23 in their low lane, 8-15 and
+   24-31 in the high one, as _mm256_packus_epi16() leaves them */
+__attribute__((target("avx2")))
+static inline void avx2_store(__m256i b8, __m256i g8, __m256i r8, __u32 *dst)
+{
+    __m256i a8 = _mm256_set1_epi8((char)0xff);
+    __m256i bg_lo = _mm256_unpacklo_epi8(b8, g8), bg_hi = _mm256_unpackhi_epi8(b8, g8);
+    __m256i ra_lo = _mm256_unpacklo_epi8(r8, a8), ra_hi = _mm256_unpackhi_epi8(r8, a8);
+    __m256i p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo);     /* 0-3, 8-11 */
+    __m256i p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo);     /* 4-7, 12-15 */
+    __m256i p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi);     /* 16-19, 24-27 */
+    __m256i p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi);     /* 20-23, 28-31 */
+
+    _mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 8), _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 16), _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 24), _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+/* 32 pixels, each argument 16 words in pixel order, chroma doubled */
+__attribute__((target("avx2")))
+static inline void avx2_pixels(__m256i y0, __m256i u0, __m256i v0,
+                               __m256i y1, __m256i u1, __m256i v1, __u32 *dst)
+{
+    __m256i r0, g0, b0, r1, g1, b1;
+
+    avx2_rgb(y0, u0, v0, &r0, &g0, &b0);
+    avx2_rgb(y1, u1, v1, &r1, &g1, &b1);
+    avx2_store(_mm256_packus_epi16(b0, b1), _mm256_packus_epi16(g0, g1),
+               _mm256_packus_epi16(r0, r1), dst);
+}
+
+#define AVX2_SHUFFLE(a, b, c, d) \
+    _mm256_setr_epi8(a, -1, a, -1, b, -1, b, -1, c, -1, c, -1, d, -1, d, -1, \
+                     a, -1, a, -1, b, -1, b, -1, c, -1, c, -1, d, -1, d, -1)
+
+/* 16 packed pixels: the luma words by mask or shift, the chroma bytes
+   doubled into words by a shuffle within each lane */
+__attribute__((target("avx2")))
+static void packed_row_avx2(const unsigned char *y, __u32 *dst, int width,
+                            int uyvy)
+{
+    __m256i mask = _mm256_set1_epi16(0xff);
+    __m256i su = uyvy ? AVX2_SHUFFLE(0, 4, 8, 12) : AVX2_SHUFFLE(1, 5, 9, 13);
+    __m256i sv = uyvy ? AVX2_SHUFFLE(2, 6, 10, 14) : AVX2_SHUFFLE(3, 7, 11, 15);
+    __m256i a, b;
+    int x;
+
+    for(x=0; x+32<=width; x+=32) {
+        a = _mm256_loadu_si256((const __m256i *)(y + 2 * x));
+        b = _mm256_loadu_si256((const __m256i *)(y + 2 * x + 32));
+        if(uyvy) {
+            avx2_pixels(_mm256_srli_epi16(a, 8), _mm256_shuffle_epi8(a, su), _mm256_shuffle_epi8(a, sv),
+                        _mm256_srli_epi16(b, 8), _mm256_shuffle_epi8(b, su), _mm256_shuffle_epi8(b, sv),
+                        dst + x);
+        } else {
+            avx2_pixels(_mm256_and_si256(a, mask), _mm256_shuffle_epi8(a, su), _mm256_shuffle_epi8(a, sv),
+                        _mm256_and_si256(b, mask), _mm256_shuffle_epi8(b, su), _mm256_shuffle_epi8(b, sv),
+                        dst + x);
+        }
+    }
+    if(uyvy) {
+        uyvy_row_sse2(y + 2 * x, NULL, NULL, dst + x, width - x);
+    } else {
+        yuyv_row_sse2(y + 2 * x, NULL, NULL, dst + x, width - x);
+    }
+}
+
+__attribute__((target("avx2")))
+static void yuyv_row_avx2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    packed_row_avx2(y, dst, width, 0);
+}
+
+__attribute__((target("avx2")))
+static void uyvy_row_avx2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    packed_row_avx2(y, dst, width, 1);
+}
+
+__attribute__((target("avx2")))
+static void nv12_row_avx2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m128i su = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+    __m128i sv = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+    __m128i uv0, uv1;
+    int x;
+
+    for(x=0; x+32<=width; x+=32) {
+        uv0 = _mm_loadu_si128((const __m128i *)(u + x));
+        uv1 = _mm_loadu_si128((const __m128i *)(u + x + 16));
+        avx2_pixels(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x))),
+                    _mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv0, su)),
+                    _mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv0, sv)),
+                    _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x + 16))),
+                    _mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv1, su)),
+                    _mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv1, sv)),
+                    dst + x);
+    }
+    nv12_row_sse2(y + x, u + x, NULL, dst + x, width - x);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_double(const unsigned char *c)
+{
+    __m128i c8 = _mm_loadl_epi64((const __m128i *)c);
+
+    return _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(c8, c8));
+}
+
+__attribute__((target("avx2")))
+static void i420_row_avx2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    int x;
+
+    for(x=0; x+32<=width; x+=32) {
+        avx2_pixels(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x))),
+                    avx2_double(u + x / 2), avx2_double(v + x / 2),
+                    _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x + 16))),
+                    avx2_double(u + x / 2 + 8), avx2_double(v + x / 2 + 8),
+                    dst + x);
+    }
+    i420_row_sse2(y + x, u + x / 2, v + x / 2, dst + x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void grey_row_avx2(const unsigned char *y, const unsigned char *u,
+                          const unsigned char *v, __u32 *dst, int width)
+{
+    __m256i g;
+    int x;
+
+    for(x=0; x+32<=width; x+=32) {
+        /* Pixels 0-7 and 16-23 low, as avx2_store() wants them */
+        g = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *)(y + x)), 0xd8);
+        avx2_store(g, g, g, dst + x);
+    }
+    grey_row_sse2(y + x, NULL, NULL, dst + x, width - x);
+}
+
+static const struct row_kernels avx2_kernels = {
+    yuyv_row_avx2, uyvy_row_avx2, nv12_row_avx2, i420_row_avx2, grey_row_avx2
+};
+#endif
+
+static const char *const kernel_names[FRAME_KERNELS] = {
+    "auto", "scalar", "sse2", "avx2"
+};
+
+const char *frame_kernel_name(int kernel)
+{
+    return kernel >= 0 && kernel < FRAME_KERNELS ? kernel_names[kernel] : "unknown";
+}
+
+int frame_kernel_supported(int kernel)
+{
+    switch(kernel) {
+    case FRAME_AUTO:
+    case FRAME_SCALAR:
+        return 1;
+#ifdef FRAME_X86
+    case FRAME_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case FRAME_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+    return 0;
+}
+
+static const struct row_kernels *kernels_for(int kernel)
+{
+#ifdef FRAME_X86
+    static int best = FRAME_AUTO;
+
+    if(kernel == FRAME_AUTO) {
+        /* Racing first calls all store the same answer */
+        if(best == FRAME_AUTO) {
+            best = frame_kernel_supported(FRAME_AVX2) ? FRAME_AVX2 :
+                   frame_kernel_supported(FRAME_SSE2) ? FRAME_SSE2 : FRAME_SCALAR;
+        }
+        kernel = best;
+    }
+    if(kernel == FRAME_AVX2 && frame_kernel_supported(FRAME_AVX2)) {
+        return &avx2_kernels;
+    }
+    if(kernel == FRAME_SSE2 && frame_kernel_supported(FRAME_SSE2)) {
+        return &sse2_kernels;
+    }
+#endif
+    return &scalar_kernels;
+}
+
+int frame_convertible(__u32 pixelformat)
+{
+    switch(pixelformat) {
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YVU420:
+    case V4L2_PIX_FMT_GREY:
+        return 1;
+    }
+    return 0;
+}
+
+struct band {
+    const struct v4l2_pix_format *pix;
+    const struct row_kernels *k;
+    const unsigned char *src;
+    unsigned char *dst;
+    int dst_stride;
+    int first, last;
+};
+
+static void convert_band(const struct band *b)
+{
+    const struct v4l2_pix_format *pix = b->pix;
+    int w = pix->width, h = pix->height;
+    int stride = pix->bytesperline;
+    const unsigned char *row, *u, *v;
+    __u32 *out;
+    int line;
+
+    for(line=b->first; line<b->last; line++) {
+        out = (__u32 *)(b->dst + line * b->dst_stride);
+        switch(pix->pixelformat) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+            row = b->src + line * (stride ? stride : 2 * w);
+            if(pix->pixelformat == V4L2_PIX_FMT_YUYV) {
+                b->k->yuyv(row, NULL, NULL, out, w);
+            } else {
+                b->k->uyvy(row, NULL, NULL, out, w);
+            }
+            break;
+        case V4L2_PIX_FMT_NV12:
+            if(!stride) {
+                stride = w;
+            }
+            u = b->src + h * stride + (line / 2) * stride;
+            b->k->nv12(b->src + line * stride, u, NULL, out, w);
+            break;
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_YVU420:
+            if(!stride) {
+                stride = w;
+            }
+            /* The chroma planes have half the stride and half the lines */
+            u = b->src + h * stride + (line / 2) * (stride / 2);
+            v = u + ((h + 1) / 2) * (stride / 2);
+            if(pix->pixelformat == V4L2_PIX_FMT_YVU420) {
+                const unsigned char *t = u;
+                u = v;
+                v = t;
+            }
+            b->k->i420(b->src + line * stride, u, v, out, w);
+            break;
+        case V4L2_PIX_FMT_GREY:
+            b->k->grey(b->src + line * (stride ? stride : w), NULL, NULL, out, w);
+            break;
+        }
+    }
+}
+
+static void *band_thread(void *arg)
+{
+    convert_band(arg);
+    return NULL;
+}
+
+void frame_convert(const struct v4l2_pix_format *pix, const unsigned char *src,
+                   unsigned char *dst, int dst_stride, int kernel, int threads)
+{
+    struct band bands[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    int started[MAX_THREADS];
+    int h = pix->height, rows, i;
+
+    if(threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if(threads > 4) {
+            threads = 4;
+        }
+    }
+    if(threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+    if(threads > h / MIN_BAND_ROWS) {
+        threads = h / MIN_BAND_ROWS;
+    }
+    if(threads < 1) {
+        threads = 1;
+    }
+
+    /* Bands start on even rows, for the 4:2:0 chroma */
+    rows = (h / threads) & ~1;
+    for(i=0; i<threads; i++) {
+        bands[i].pix = pix;
+        bands[i].k = kernels_for(kernel);
+        bands[i].src = src;
+        bands[i].dst = dst;
+        bands[i].dst_stride = dst_stride;
+        bands[i].first = i * rows;
+        bands[i].last = i == threads - 1 ? h : (i + 1) * rows;
+    }
+    /* The caller converts the first band, a thread that cannot be
+       started leaves its band to the caller too */
+    for(i=1; i<threads; i++) {
+        started[i] = pthread_create(&tids[i], NULL, band_thread, &bands[i]) == 0;
+    }
+    convert_band(&bands[0]);
+    for(i=1; i<threads; i++) {
+        if(started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            convert_band(&bands[i]);
+        }
+    }
+}
+
+void frame_to_rgb32(const struct v4l2_pix_format *pix, const unsigned char *src,
+                    unsigned char *dst, int dst_stride)
+{
+    frame_convert(pix, src, dst, dst_stride, FRAME_AUTO, 0);
+}
@@ -0,0 +1,324 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#include "v4l2core.h"
+
+/* Measures the pixel conversions of v4l2frame.c, every format with
+   every kernel the CPU has, on one thread and on several, and the frame
+   statistics of v4l2analysis.c on one thread. Each output is compared
+   with the scalar kernel's, also at a size which leaves a tail for the
+   scalar code on every row. One JSON line per run; the exit status is
+   non zero when any output differs. */
+
+#define MAX_ITERATIONS 1000
+
+static const struct {
+    __u32 pixelformat;
+    const char *name;
+} formats[] = {
+    { V4L2_PIX_FMT_YUYV, "YUYV" },
+    { V4L2_PIX_FMT_UYVY, "UYVY" },
+    { V4L2_PIX_FMT_NV12, "NV12" },
+    { V4L2_PIX_FMT_YUV420, "YU12" },
+    { V4L2_PIX_FMT_GREY, "GREY" },
+};
+#define NFORMATS (sizeof(formats) / sizeof(formats[0]))
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void set_format(struct v4l2_pix_format *pix, __u32 pixelformat, int w, int h)
+{
+    memset(pix, 0, sizeof(*pix));
+    pix->pixelformat = pixelformat;
+    pix->width = w;
+    pix->height = h;
+    pix->bytesperline = pixelformat == V4L2_PIX_FMT_YUYV ||
+                        pixelformat == V4L2_PIX_FMT_UYVY ? 2 * w : w;
+}
+
+/* Noise, it reaches every clipping and saturation case */
+static unsigned char *make_frame(int w, int h)
+{
+    unsigned char *p = malloc(4 * w * h);
+    unsigned int seed = 12345;
+    int i;
+
+    for(i=0; p && i<4*w*h; i++) {
+        seed = seed * 1103515245 + 12345;
+        p[i] = seed >> 16;
+    }
+    return p;
+}
+
+/* Returns 1 when the kernel gives the scalar kernel's bytes */
+static int exact(__u32 pixelformat, int kernel, int threads, int w, int h)
+{
+    struct v4l2_pix_format pix;
+    unsigned char *src = make_frame(w, h);
+    unsigned char *ref = malloc(4 * w * h), *out = malloc(4 * w * h);
+    int same = 0;
+
+    if(src && ref && out) {
+        set_format(&pix, pixelformat, w, h);
+        frame_convert(&pix, src, ref, 4 * w, FRAME_SCALAR, 1);
+        memset(out, 0, 4 * w * h);
+        frame_convert(&pix, src, out, 4 * w, kernel, threads);
+        same = !memcmp(ref, out, 4 * w * h);
+    }
+    free(src);
+    free(ref);
+    free(out);
+    return same;
+}
+
+static double mpix_s(__u32 pixelformat, int kernel, int threads, int w, int h,
+                     int iterations)
+{
+    struct v4l2_pix_format pix;
+    unsigned char *src = make_frame(w, h), *out = malloc(4 * w * h);
+    long long start, best = 0, t;
+    int i;
+
+    if(!src || !out) {
+        free(src);
+        free(out);
+        return 0;
+    }
+    set_format(&pix, pixelformat, w, h);
+    /* The fastest run, the others mostly measure the scheduler */
+    for(i=0; i<iterations; i++) {
+        start = now_ns();
+        frame_convert(&pix, src, out, 4 * w, kernel, threads);
+        t = now_ns() - start;
+        if(!best || t < best) {
+            best = t;
+        }
+    }
+    free(src);
+    free(out);
+    return best ? (double)w * h * 1e3 / best : 0;
+}
+
+static int stats_exact(int kernel, int row_step, int w, int h)
+{
+    unsigned char *src = make_frame(w, h);
+    struct frame_stats ref, out;
+    int same = 0;
+
+    if(src) {
+        frame_stats_collect(src, w, h, 4 * w, V4L2_PIX_FMT_BGR32, row_step, FRAME_SCALAR, &ref);
+        frame_stats_collect(src, w, h, 4 * w, V4L2_PIX_FMT_BGR32, row_step, kernel, &out);
+        same = !memcmp(&ref, &out, sizeof(ref));
+    }
+    free(src);
+    return same;
+}
+
+/* Frames per second, of 0xffRRGGBB pixels like the preview converts to */
+static double stats_fps(int kernel, int row_step, int w, int h, int iterations)
+{
+    unsigned char *src = make_frame(w, h);
+    struct frame_stats st;
+    long long start, best = 0, t;
+    int i;
+
+    if(!src) {
+        return 0;
+    }
+    for(i=0; i<iterations; i++) {
+        start = now_ns();
+        frame_stats_collect(src, w, h, 4 * w, V4L2_PIX_FMT_BGR32, row_step, kernel, &st);
+        t = now_ns() - start;
+        if(!best || t < best) {
+            best = t;
+        }
+    }
+    free(src);
+    return best ? 1e9 / best : 0;
+}
+
+/* The whole frame and a centred quarter, BGR32 as the preview has or GREY */
+static int sharpness_exact(__u32 pixelformat, int kernel, int w, int h)
+{
+    unsigned char *src = make_frame(w, h);
+    struct frame_roi roi = { w / 4 + 1, h / 4, w / 2, h / 2 };
+    int stride = pixelformat == V4L2_PIX_FMT_BGR32 ? 4 * w : w;
+    int same = 0;
+
+    if(src) {
+        same = frame_sharpness(src, w, h, stride, pixelformat, NULL, FRAME_SCALAR) ==
+               frame_sharpness(src, w, h, stride, pixelformat, NULL, kernel) &&
+               frame_sharpness(src, w, h, stride, pixelformat, &roi, FRAME_SCALAR) ==
+               frame_sharpness(src, w, h, stride, pixelformat, &roi, kernel);
+    }
+    free(src);
+    return same;
+}
+
+static double sharpness_fps(__u32 pixelformat, int kernel, int w, int h, int iterations)
+{
+    unsigned char *src = make_frame(w, h);
+    int stride = pixelformat == V4L2_PIX_FMT_BGR32 ? 4 * w : w;
+    long long start, best = 0, t;
+    int i;
+
+    if(!src) {
+        return 0;
+    }
+    for(i=0; i<iterations; i++) {
+        start = now_ns();
+        frame_sharpness(src, w, h, stride, pixelformat, NULL, kernel);
+        t = now_ns() - start;
+        if(!best || t < best) {
+            best = t;
+        }
+    }
+    free(src);
+    return best ? 1e9 / best : 0;
+}
+
+void usage(const char *argv0)
+{
+    printf("Usage: %s [-n iterations] [-s WIDTHxHEIGHT] [-t threads]\n", argv0);
+    printf("       %s -h\n", argv0);
+    printf("-n to convert each frame this many times, 50 by default.\n");
+    printf("-s for the frame size, 1920x1080 by default.\n");
+    printf("-t for the threads of the threaded runs, up to 4 by default.\n");
+    printf("-h to print this message.\n");
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 50, w = 1920, h = 1080, threads = 0;
+    int runs[2], nruns, failed = 0;
+    unsigned int f;
+    int i, k, r;
+
+    for(i=1; i<argc; i++) {
+        if(!strcmp(argv[i], "-n") && i<argc-1) {
+            iterations = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-s") && i<argc-1) {
+            if(sscanf(argv[++i], "%dx%d", &w, &h) != 2) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if(!strcmp(argv[i], "-t") && i<argc-1) {
+            threads = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-h")) {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(iterations < 1 || iterations > MAX_ITERATIONS) {
+        fprintf(stderr, "The number of iterations must be 1 to %d\n", MAX_ITERATIONS);
+        return EXIT_FAILURE;
+    }
+    if(w < 2 || h < 2 || (w & 1) || (h & 1)) {
+        fprintf(stderr, "The frame size must be even and at least 2x2\n");
+        return EXIT_FAILURE;
+    }
+    if(threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if(threads > 4) {
+            threads = 4;
+        }
+    }
+    runs[0] = 1;
+    runs[1] = threads;
+    nruns = threads > 1 ? 2 : 1;
+
+    for(f=0; f<NFORMATS; f++) {
+        double scalar = mpix_s(formats[f].pixelformat, FRAME_SCALAR, 1, w, h, iterations);
+
+        for(k=FRAME_SCALAR; k<FRAME_KERNELS; k++) {
+            if(!frame_kernel_supported(k)) {
+                printf("{\"format\":\"%s\",\"kernel\":\"%s\",\"skipped\":\"not supported by the CPU\"}\n",
+                       formats[f].name, frame_kernel_name(k));
+                continue;
+            }
+            for(r=0; r<nruns; r++) {
+                double rate = k == FRAME_SCALAR && runs[r] == 1 ? scalar :
+                              mpix_s(formats[f].pixelformat, k, runs[r], w, h, iterations);
+                /* 998x562 leaves 6 pixels after the 16 and 32 pixel steps */
+                int same = exact(formats[f].pixelformat, k, runs[r], w, h) &&
+                           exact(formats[f].pixelformat, k, runs[r], 998, 562);
+
+                printf("{\"format\":\"%s\",\"kernel\":\"%s\",\"threads\":%d,\"width\":%d,"
+                       "\"height\":%d,\"mpix_s\":%.1f,\"vs_scalar\":%.2f,\"exact\":%s}\n",
+                       formats[f].name, frame_kernel_name(k), runs[r], w, h, rate,
+                       scalar > 0 ? rate / scalar : 0, same ? "true" : "false");
+                if(!same) {
+                    failed = 1;
+                }
+            }
+        }
+    }
+
+    for(k=FRAME_SCALAR; k<FRAME_KERNELS; k++) {
+        if(!frame_kernel_supported(k)) {
+            continue;
+        }
+        /* Every row, and every other row as the preview does */
+        for(r=1; r<=2; r++) {
+            int same = stats_exact(k, r, w, h) && stats_exact(k, r, 998, 562);
+
+            printf("{\"stats\":\"BGR32\",\"kernel\":\"%s\",\"row_step\":%d,\"width\":%d,"
+                   "\"height\":%d,\"fps\":%.1f,\"exact\":%s}\n", frame_kernel_name(k), r,
+                   w, h, stats_fps(k, r, w, h, iterations), same ? "true" : "false");
+            if(!same) {
+                failed = 1;
+            }
+        }
+    }
+
+    for(k=FRAME_SCALAR; k<FRAME_KERNELS; k++) {
+        if(!frame_kernel_supported(k)) {
+            continue;
+        }
+        for(f=0; f<2; f++) {
+            __u32 format = f ? V4L2_PIX_FMT_GREY : V4L2_PIX_FMT_BGR32;
+            int same = sharpness_exact(format, k, w, h) && sharpness_exact(format, k, 998, 562);
+
+            printf("{\"sharpness\":\"%s\",\"kernel\":\"%s\",\"width\":%d,\"height\":%d,"
+                   "\"fps\":%.1f,\"exact\":%s}\n", f ? "GREY" : "BGR32", frame_kernel_name(k),
+                   w, h, sharpness_fps(format, k, w, h, iterations), same ? "true" : "false");
+            if(!same) {
+                failed = 1;
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
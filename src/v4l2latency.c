@@ -0,0 +1,460 @@
+/*  v4l2ctrl - A program for saving and loading settings for V4L2 devices
+    Copyright (C) 2008-2009 Scott J. Bertin (scottbertin@yahoo.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#include "v4l2ctrl.h"
+
+/* Latency mode: how many frames and ms it takes a camera to show a
+   control change. The control is toggled between two values while
+   streaming, and the first frame whose mean luma crosses half way
+   between the levels of both values is the one showing the change.
+   Frames already captured are drained before each write, so a change
+   showing in the very next frame counts as 1. */
+
+#define LATENCY_BUFFERS 4
+#define SETTLE_FRAMES 15        /* for the levels of both values */
+#define AFTER_FRAMES 5          /* after a change, before the next one */
+#define MAX_FRAMES 60           /* a change not seen by then is missed */
+#define MIN_CONTRAST 6.0        /* luma between the two levels */
+#define ROW_STEP 2
+#define FRAME_TIMEOUT 2000      /* ms */
+
+struct probe {
+    struct stream s;
+    unsigned char *rgb;         /* YUV frames converted, 0xffRRGGBB */
+    __u32 seq;                  /* of the last frame dequeued */
+    double luma;                /* of the last frame dequeued */
+};
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int set_control(int fd, __u32 id, __s32 value)
+{
+    struct v4l2_control c;
+
+    c.id = id;
+    c.value = value;
+    return core_ioctl(fd, VIDIOC_S_CTRL, &c);
+}
+
+/* Mean luma of the frame in buffer index */
+static int frame_luma(struct probe *p, int index, double *luma)
+{
+    const struct v4l2_pix_format *pix = &p->s.pix;
+    const unsigned char *src = p->s.start[index];
+    struct frame_stats st;
+    __u32 format = pix->pixelformat;
+    int stride = pix->bytesperline;
+
+    if(frame_convertible(format) && format != V4L2_PIX_FMT_GREY) {
+        frame_convert(pix, src, p->rgb, pix->width * 4, FRAME_AUTO, 0);
+        src = p->rgb;
+        stride = pix->width * 4;
+        format = V4L2_PIX_FMT_BGR32;
+    } else if(format == V4L2_PIX_FMT_XBGR32) {
+        format = V4L2_PIX_FMT_BGR32;
+    }
+    if(frame_stats_collect(src, pix->width, pix->height, stride, format,
+                           ROW_STEP, FRAME_AUTO, &st) != 0) {
+        return -1;
+    }
+    *luma = frame_stats_mean(&st, FRAME_LUMA);
+    return 0;
+}
+
+/* Wait for the next frame, *at is when it was captured in ms of the
+   monotonic clock, or when it got here when the driver does not say */
+static int next_frame(struct probe *p, int timeout, double *at)
+{
+    struct v4l2_buffer buf;
+    int index, ret;
+
+    index = stream_dequeue_buffer(&p->s, timeout, &buf);
+    if(index < 0) {
+        return -1;
+    }
+    if(at) {
+        if((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+           V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+           (buf.timestamp.tv_sec || buf.timestamp.tv_usec)) {
+            *at = buf.timestamp.tv_sec * 1000.0 + buf.timestamp.tv_usec / 1000.0;
+        } else {
+            *at = now_ms();
+        }
+    }
+    p->seq = buf.sequence;
+    ret = frame_luma(p, index, &p->luma);
+    stream_queue(&p->s, index);
+    return ret;
+}
+
+/* Take the frames waiting in the queue, so the next one dequeued was
+   at most being captured when this returns */
+static int drain(struct probe *p)
+{
+    while(next_frame(p, 0, NULL) == 0) {
+    }
+    return errno == EAGAIN ? 0 : -1;
+}
+
+/* Level once a value has taken effect, the mean of the last frames */
+static int settle(struct probe *p, int frames, double *level)
+{
+    double sum = 0;
+    int i;
+
+    for(i=0; i<frames; i++) {
+        if(next_frame(p, FRAME_TIMEOUT, NULL)) {
+            return -1;
+        }
+        if(i >= frames - 3) {
+            sum += p->luma;
+        }
+    }
+    if(level) {
+        *level = sum / 3;
+    }
+    return 0;
+}
+
+static int int_cmp(const void *a, const void *b)
+{
+    int ia = *(const int *)a, ib = *(const int *)b;
+
+    return ia < ib ? -1 : ia > ib;
+}
+
+static int double_cmp(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return da < db ? -1 : da > db;
+}
+
+/* n > 0 values, sorted */
+#define PERCENTILE(v, n, f) ((v)[(int)((f) * ((n) - 1) + 0.5)])
+
+static void fourcc(__u32 format, char *s)
+{
+    int i;
+
+    for(i=0; i<4; i++) {
+        s[i] = (format >> (8 * i)) & 0xff;
+    }
+    s[4] = '\0';
+}
+
+/* Replace the line of the same camera, control and format in the
+   results file, or add it. One tab separated line per measurement. */
+static int save_result(const char *path, const char *key, const char *line)
+{
+    char **lines = NULL, **grown, buf[1024];
+    int i, count = 0, ret = -1;
+    size_t len = strlen(key);
+    FILE *file;
+
+    file = fopen(path, "r");
+    if(file) {
+        while(fgets(buf, sizeof(buf), file)) {
+            if(buf[0] == '#' || !strncmp(buf, key, len)) {
+                continue;
+            }
+            grown = realloc(lines, (count + 1) * sizeof(*lines));
+            if(!grown) {
+                fclose(file);
+                goto out;
+            }
+            lines = grown;
+            lines[count] = strdup(buf);
+            if(!lines[count]) {
+                fclose(file);
+                goto out;
+            }
+            count++;
+        }
+        fclose(file);
+    } else if(errno != ENOENT) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, strerror(errno));
+        goto out;
+    }
+
+    file = fopen(path, "w");
+    if(!file) {
+        fprintf(stderr, "Unable to write %s: %s\n", path, strerror(errno));
+        goto out;
+    }
+    fprintf(file, "# card\tcontrol\tformat\tfrom\tto\tchanges\tmissed\t"
+            "frames min\tmedian\tp90\tmax\tms min\tmedian\tp90\tmax\n");
+    for(i=0; i<count; i++) {
+        fputs(lines[i], file);
+    }
+    fputs(line, file);
+    if(fclose(file) == 0) {
+        ret = 0;
+    } else {
+        fprintf(stderr, "Unable to write %s: %s\n", path, strerror(errno));
+    }
+
+out:
+    for(i=0; i<count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    return ret;
+}
+
+/* The control named name, or with the id it holds */
+static int find_control(const struct control_store *s, const char *name)
+{
+    char *end;
+    unsigned long id;
+    int i;
+
+    id = strtoul(name, &end, 0);
+    if(*name && !*end) {
+        return store_find(s, id);
+    }
+    for(i=0; i<s->count; i++) {
+        if(!strcasecmp(s->name[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int run_latency(const char *device, const char *control, const __s32 *values,
+                int changes, const char *results)
+{
+    struct probe p;
+    struct control_store store;
+    struct v4l2_capability cap;
+    __u32 master_id[4];
+    __s32 master_saved[4];
+    char format[5], key[256], line[512];
+    int i, n, c, found, masters = 0, ret = EXIT_FAILURE;
+    int *frames = NULL, measured = 0, missed = 0;
+    double *ms = NULL, level[2], threshold, t0, at;
+    __s32 value[2], saved;
+    __u32 last;
+
+    memset(&p, 0, sizeof(p));
+    store_init(&store);
+    if(stream_open(&p.s, device, LATENCY_BUFFERS)) {
+        fprintf(stderr, "Unable to capture from %s: %s\n", device, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    fourcc(p.s.pix.pixelformat, format);
+    if(!frame_convertible(p.s.pix.pixelformat) &&
+       p.s.pix.pixelformat != V4L2_PIX_FMT_RGB24 &&
+       p.s.pix.pixelformat != V4L2_PIX_FMT_BGR32 &&
+       p.s.pix.pixelformat != V4L2_PIX_FMT_XBGR32) {
+        fprintf(stderr, "Cannot look into %s frames, choose a YUV or RGB "
+                "format for %s first\n", format, device);
+        goto out;
+    }
+    p.rgb = malloc((size_t)p.s.pix.width * p.s.pix.height * 4);
+    frames = malloc(changes * sizeof(*frames));
+    ms = malloc(changes * sizeof(*ms));
+    if(!p.rgb || !frames || !ms) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+    if(core_ioctl(p.s.fd, VIDIOC_QUERYCAP, &cap) != 0 ||
+       store_enumerate(p.s.fd, &store) < 0) {
+        fprintf(stderr, "Unable to query %s: %s\n", device, strerror(errno));
+        goto out;
+    }
+    store_get(p.s.fd, &store, NULL, 0);
+
+    c = find_control(&store, control);
+    if(c < 0) {
+        fprintf(stderr, "%s has no control \"%s\"\n", device, control);
+        goto out;
+    }
+    if(!store_readable(&store, c) ||
+       (store.hw_flags[c] & V4L2_CTRL_FLAG_READ_ONLY) ||
+       store.type[c] == V4L2_CTRL_TYPE_BUTTON) {
+        fprintf(stderr, "Control \"%s\" cannot be toggled\n", store.name[c]);
+        goto out;
+    }
+    saved = store.value[c];
+    if(values) {
+        value[0] = values[0];
+        value[1] = values[1];
+    } else if(store.type[c] == V4L2_CTRL_TYPE_INTEGER) {
+        /* A quarter and three quarters of the way, on a step */
+        __s32 step = store.step[c] > 0 ? store.step[c] : 1;
+        __s32 range = store.maximum[c] - store.minimum[c];
+
+        value[0] = store.minimum[c] + range / 4 / step * step;
+        value[1] = store.minimum[c] + range / 4 * 3 / step * step;
+    } else {
+        value[0] = store.minimum[c];
+        value[1] = store.maximum[c];
+    }
+
+    /* The auto mode would undo what we write */
+    for(i=0; i<control_edge_count && masters<4; i++) {
+        __s32 manual;
+
+        if(control_edges[i].dependent != store.id[c]) {
+            continue;
+        }
+        n = store_find(&store, control_edges[i].master);
+        manual = control_edges[i].master == V4L2_CID_EXPOSURE_AUTO ?
+                 V4L2_EXPOSURE_MANUAL : 0;
+        if(n < 0 || store.value[n] == manual) {
+            continue;
+        }
+        if(set_control(p.s.fd, store.id[n], manual) != 0) {
+            fprintf(stderr, "Unable to turn off \"%s\": %s\n",
+                    store.name[n], strerror(errno));
+            goto restore;
+        }
+        master_id[masters] = store.id[n];
+        master_saved[masters++] = store.value[n];
+    }
+
+    for(i=0; i<2; i++) {
+        if(set_control(p.s.fd, store.id[c], value[i]) != 0) {
+            fprintf(stderr, "Unable to set \"%s\" to %d: %s\n",
+                    store.name[c], value[i], strerror(errno));
+            goto restore;
+        }
+        if(settle(&p, SETTLE_FRAMES, &level[i])) {
+            fprintf(stderr, "No frames from %s: %s\n", device, strerror(errno));
+            goto restore;
+        }
+    }
+    if(level[1] - level[0] < MIN_CONTRAST && level[0] - level[1] < MIN_CONTRAST) {
+        fprintf(stderr, "\"%s\" at %d and %d gives luma %.1f and %.1f, not "
+                "far enough apart to see, choose other values\n",
+                store.name[c], value[0], value[1], level[0], level[1]);
+        goto restore;
+    }
+    threshold = (level[0] + level[1]) / 2;
+
+    /* At value[1] now, so the first change goes to value[0] */
+    for(i=0; i<changes; i++) {
+        int to = i % 2 == 0 ? 0 : 1;
+        int up = level[to] > level[!to];
+
+        if(drain(&p)) {
+            fprintf(stderr, "Capture failed: %s\n", strerror(errno));
+            goto restore;
+        }
+        last = p.seq;
+        t0 = now_ms();
+        if(set_control(p.s.fd, store.id[c], value[to]) != 0) {
+            fprintf(stderr, "Unable to set \"%s\" to %d: %s\n",
+                    store.name[c], value[to], strerror(errno));
+            goto restore;
+        }
+        found = 0;
+        for(n=1; n<=MAX_FRAMES; n++) {
+            if(next_frame(&p, FRAME_TIMEOUT, &at)) {
+                fprintf(stderr, "Capture failed: %s\n", strerror(errno));
+                goto restore;
+            }
+            if(up ? p.luma > threshold : p.luma < threshold) {
+                found = 1;
+                break;
+            }
+        }
+        if(found) {
+            /* The sequence also counts the frames the driver dropped */
+            frames[measured] = p.seq > last ? (int)(p.seq - last) : n;
+            ms[measured++] = at - t0;
+        } else {
+            missed++;
+        }
+        if(settle(&p, AFTER_FRAMES, NULL)) {
+            fprintf(stderr, "Capture failed: %s\n", strerror(errno));
+            goto restore;
+        }
+    }
+
+    printf("\"%s\" on %s (%s), %ux%u %s\n", store.name[c], device,
+           (const char *)cap.card, p.s.pix.width, p.s.pix.height, format);
+    printf("%d changes between %d and %d, luma %.1f and %.1f, %d missed\n",
+           changes, value[0], value[1], level[0], level[1], missed);
+    if(measured == 0) {
+        fprintf(stderr, "No change was seen within %d frames\n", MAX_FRAMES);
+        goto restore;
+    }
+    qsort(frames, measured, sizeof(*frames), int_cmp);
+    qsort(ms, measured, sizeof(*ms), double_cmp);
+    for(i=0; i<measured; i+=n) {
+        for(n=1; i+n<measured && frames[i+n]==frames[i]; n++) {
+        }
+        printf("%3d frames: %d\n", frames[i], n);
+    }
+    printf("frames: min %d, median %d, p90 %d, max %d\n", frames[0],
+           PERCENTILE(frames, measured, 0.5), PERCENTILE(frames, measured, 0.9),
+           frames[measured-1]);
+    printf("ms: min %.1f, median %.1f, p90 %.1f, max %.1f\n", ms[0],
+           PERCENTILE(ms, measured, 0.5), PERCENTILE(ms, measured, 0.9),
+           ms[measured-1]);
+
+    ret = EXIT_SUCCESS;
+    if(results) {
+        snprintf(key, sizeof(key), "%s\t%s\t%ux%u %s\t", (const char *)cap.card,
+                 store.name[c], p.s.pix.width, p.s.pix.height, format);
+        snprintf(line, sizeof(line), "%s%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t"
+                 "%.1f\t%.1f\t%.1f\t%.1f\n", key, value[0], value[1], changes,
+                 missed, frames[0], PERCENTILE(frames, measured, 0.5),
+                 PERCENTILE(frames, measured, 0.9), frames[measured-1], ms[0],
+                 PERCENTILE(ms, measured, 0.5), PERCENTILE(ms, measured, 0.9),
+                 ms[measured-1]);
+        if(save_result(results, key, line)) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+restore:
+    if(set_control(p.s.fd, store.id[c], saved) != 0) {
+        fprintf(stderr, "Unable to restore \"%s\": %s\n", store.name[c],
+                strerror(errno));
+    }
+    for(i=masters-1; i>=0; i--) {
+        set_control(p.s.fd, master_id[i], master_saved[i]);
+    }
+
+out:
+    stream_close(&p.s);
+    store_free(&store);
+    free(p.rgb);
+    free(frames);
+    free(ms);
+    return ret;
+}
@@ -0,0 +1,437 @@
+/*  v4l2ctrl - A program for saving and loading settings for V4L2 devices
+    Copyright (C) 2008-2009 Scott J. Bertin (scottbertin@yahoo.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <linux/types.h>
+
+#include "v4l2ctrl.h"
+
+/* A profile library holds many named profiles in one file which is used
+   straight from a private mapping. After the header come a hash table
+   keyed by device identity and preset name, the profile entries, the
+   settings of all profiles and a blob with the strings and payloads.
+   Offsets are in bytes, from the start of the file for the sections and
+   from the start of the blob otherwise. Values are in host byte order,
+   the magic tells when a file comes from the other one. */
+
+#define LIBRARY_MAGIC 0x504c3456    /* "V4LP" */
+#define LIBRARY_VERSION 1
+
+struct lib_header {
+    __u32 magic;
+    __u32 version;
+    __u32 count;            /* profiles */
+    __u32 buckets;          /* a power of two */
+    __u32 table_off;        /* __u32 per bucket, profile index + 1 or 0 */
+    __u32 profiles_off;
+    __u32 settings_off;
+    __u32 blob_off;
+    __u32 blob_size;
+    __u32 size;             /* of the whole file */
+};
+
+struct lib_profile {
+    __u32 hash;
+    __u32 identity;         /* blob offsets of NUL terminated strings */
+    __u32 preset;
+    __u32 first;            /* index of its first setting */
+    __u32 count;
+};
+
+struct lib_setting {
+    __u32 id;
+    __u32 kind;             /* enum setting_kind */
+    __s64 value;
+    __u32 size;
+    __u32 data;             /* blob offset of the payload */
+    char name[32];
+};
+
+struct profile_library {
+    char *map;
+    size_t size;
+    const struct lib_header *h;
+    const __u32 *table;
+    const struct lib_profile *profiles;
+    const struct lib_setting *settings;
+    __u32 nsettings;
+    const char *blob;
+};
+
+/* FNV-1a over identity, a NUL and the preset name */
+static __u32 library_hash(const char *identity, const char *preset)
+{
+    __u32 h = 2166136261u;
+    const unsigned char *p;
+
+    for(p=(const unsigned char *)identity; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    h *= 16777619u;
+    for(p=(const unsigned char *)preset; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
+}
+
+static int section_ok(const struct lib_header *h, __u32 off, __u64 size)
+{
+    return off % 8 == 0 && off <= h->size && size <= h->size - off;
+}
+
+/* A NUL terminated string inside the blob */
+static const char *blob_string(const struct profile_library *lib, __u32 off)
+{
+    if(off >= lib->h->blob_size ||
+       !memchr(lib->blob + off, 0, lib->h->blob_size - off)) {
+        return NULL;
+    }
+    return lib->blob + off;
+}
+
+struct profile_library *library_open(const char *path)
+{
+    struct profile_library *lib;
+    const struct lib_header *h;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+    lib = calloc(1, sizeof(*lib));
+    if(!lib || fstat(fd, &st)) {
+        goto fail;
+    }
+    if(st.st_size < (off_t)sizeof(*h)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    lib->size = st.st_size;
+    /* Private and writable: TRY_EXT_CTRLS writes the payloads back */
+    lib->map = mmap(NULL, lib->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(lib->map == MAP_FAILED) {
+        lib->map = NULL;
+        goto fail;
+    }
+    close(fd);
+    fd = -1;
+
+    h = lib->h = (const struct lib_header *)lib->map;
+    if(h->magic != LIBRARY_MAGIC || h->version != LIBRARY_VERSION ||
+       h->size != lib->size || !h->buckets || (h->buckets & (h->buckets - 1)) ||
+       !section_ok(h, h->table_off, (__u64)h->buckets * sizeof(__u32)) ||
+       !section_ok(h, h->profiles_off, (__u64)h->count * sizeof(struct lib_profile)) ||
+       h->settings_off > h->blob_off || !section_ok(h, h->settings_off, 0) ||
+       !section_ok(h, h->blob_off, h->blob_size)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    lib->table = (const __u32 *)(lib->map + h->table_off);
+    lib->profiles = (const struct lib_profile *)(lib->map + h->profiles_off);
+    lib->settings = (const struct lib_setting *)(lib->map + h->settings_off);
+    lib->nsettings = (h->blob_off - h->settings_off) / sizeof(struct lib_setting);
+    lib->blob = lib->map + h->blob_off;
+    return lib;
+
+fail:
+    if(fd >= 0) {
+        close(fd);
+    }
+    library_close(lib);
+    return NULL;
+}
+
+void library_close(struct profile_library *lib)
+{
+    if(!lib) {
+        return;
+    }
+    if(lib->map) {
+        munmap(lib->map, lib->size);
+    }
+    free(lib);
+}
+
+int library_count(const struct profile_library *lib)
+{
+    return lib->h->count;
+}
+
+/* Profile index of identity and preset, -1 if there is none */
+int library_find(const struct profile_library *lib, const char *identity,
+                 const char *preset)
+{
+    __u32 hash = library_hash(identity, preset), mask = lib->h->buckets - 1;
+    __u32 b, i, n;
+    const struct lib_profile *p;
+    const char *pi, *pp;
+
+    for(b=hash&mask, n=0; n<=mask; b=(b+1)&mask, n++) {
+        i = lib->table[b];
+        if(!i) {
+            break;
+        }
+        if(i > lib->h->count) {
+            return -1;
+        }
+        p = &lib->profiles[i-1];
+        if(p->hash != hash) {
+            continue;
+        }
+        pi = blob_string(lib, p->identity);
+        pp = blob_string(lib, p->preset);
+        if(pi && pp && !strcmp(pi, identity) && !strcmp(pp, preset)) {
+            return i - 1;
+        }
+    }
+    return -1;
+}
+
+const char *library_identity(const struct profile_library *lib, int index)
+{
+    return blob_string(lib, lib->profiles[index].identity);
+}
+
+const char *library_preset(const struct profile_library *lib, int index)
+{
+    return blob_string(lib, lib->profiles[index].preset);
+}
+
+/* The settings of a profile, their payloads point into the mapping. Only
+   the array has to be freed. Returns the count or -1. */
+int library_settings(const struct profile_library *lib, int index,
+                     struct setting **settings)
+{
+    const struct lib_profile *p = &lib->profiles[index];
+    const struct lib_setting *ls;
+    struct setting *s;
+    __u32 i;
+
+    if(p->first > lib->nsettings || p->count > lib->nsettings - p->first) {
+        errno = EINVAL;
+        return -1;
+    }
+    s = malloc((p->count ? p->count : 1) * sizeof(*s));
+    if(!s) {
+        return -1;
+    }
+    for(i=0; i<p->count; i++) {
+        ls = &lib->settings[p->first + i];
+        if(ls->kind > SETTING_PAYLOAD || ls->data > lib->h->blob_size ||
+           ls->size > lib->h->blob_size - ls->data) {
+            free(s);
+            errno = EINVAL;
+            return -1;
+        }
+        s[i].id = ls->id;
+        s[i].kind = ls->kind;
+        s[i].value = ls->value;
+        s[i].size = ls->size;
+        s[i].data = ls->size ? (char *)lib->blob + ls->data : NULL;
+        s[i].order = i;
+        memcpy(s[i].name, ls->name, sizeof(s[i].name));
+        s[i].name[sizeof(s[i].name) - 1] = 0;
+    }
+    *settings = s;
+    return p->count;
+}
+
+/* One profile while a library is being written */
+struct lib_entry {
+    const char *identity;
+    const char *preset;
+    const struct setting *settings;
+    int count;
+    struct setting *owned;      /* settings taken from the old library */
+};
+
+static __u32 blob_add(char *blob, __u32 *used, const void *data, size_t size)
+{
+    __u32 off = *used;
+
+    if(size) {
+        memcpy(blob + off, data, size);
+    }
+    *used += size;
+    return off;
+}
+
+static int write_library(const char *path, const struct lib_entry *e, int count)
+{
+    struct lib_header h;
+    __u32 *table, b, used = 0, nsettings = 0;
+    struct lib_profile *profiles;
+    struct lib_setting *settings;
+    size_t blob_size = 0;
+    char *buf, *blob, *tmp_path;
+    int i, j, fd, ret = -1;
+    FILE *file;
+
+    for(i=0; i<count; i++) {
+        blob_size += strlen(e[i].identity) + strlen(e[i].preset) + 2;
+        for(j=0; j<e[i].count; j++) {
+            blob_size += e[i].settings[j].size;
+        }
+        nsettings += e[i].count;
+    }
+
+    memset(&h, 0, sizeof(h));
+    h.magic = LIBRARY_MAGIC;
+    h.version = LIBRARY_VERSION;
+    h.count = count;
+    /* At most half full, so that probes stay short */
+    for(h.buckets=8; h.buckets<2*(__u32)count; h.buckets*=2)
+        ;
+    h.table_off = (sizeof(h) + 7) & ~7;
+    h.profiles_off = (h.table_off + h.buckets * sizeof(__u32) + 7) & ~7;
+    h.settings_off = (h.profiles_off + count * sizeof(*profiles) + 7) & ~7;
+    h.blob_off = h.settings_off + nsettings * sizeof(*settings);
+    h.blob_size = blob_size;
+    h.size = (h.blob_off + blob_size + 7) & ~7;
+
+    buf = calloc(1, h.size);
+    tmp_path = malloc(strlen(path) + 5);
+    if(!buf || !tmp_path) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+    memcpy(buf, &h, sizeof(h));
+    table = (__u32 *)(buf + h.table_off);
+    profiles = (struct lib_profile *)(buf + h.profiles_off);
+    settings = (struct lib_setting *)(buf + h.settings_off);
+    blob = buf + h.blob_off;
+
+    nsettings = 0;
+    for(i=0; i<count; i++) {
+        profiles[i].hash = library_hash(e[i].identity, e[i].preset);
+        profiles[i].identity = blob_add(blob, &used, e[i].identity,
+                                        strlen(e[i].identity) + 1);
+        profiles[i].preset = blob_add(blob, &used, e[i].preset,
+                                      strlen(e[i].preset) + 1);
+        profiles[i].first = nsettings;
+        profiles[i].count = e[i].count;
+        for(j=0; j<e[i].count; j++) {
+            const struct setting *s = &e[i].settings[j];
+            struct lib_setting *ls = &settings[nsettings++];
+            ls->id = s->id;
+            ls->kind = s->kind;
+            ls->value = s->value;
+            ls->size = s->size;
+            ls->data = blob_add(blob, &used, s->data, s->size);
+            strncpy(ls->name, s->name, sizeof(ls->name) - 1);
+        }
+
+        for(b=profiles[i].hash&(h.buckets-1); table[b]; b=(b+1)&(h.buckets-1))
+            ;
+        table[b] = i + 1;
+    }
+
+    /* Replace the old library in one go */
+    sprintf(tmp_path, "%s.tmp", path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if(!file) {
+        fprintf(stderr, "Unable to open %s: %s\n", tmp_path, strerror(errno));
+        if(fd >= 0) {
+            close(fd);
+        }
+        goto out;
+    }
+    if(fwrite(buf, h.size, 1, file) != 1 || fclose(file) ||
+       rename(tmp_path, path)) {
+        fprintf(stderr, "Unable to write %s: %s\n", path, strerror(errno));
+        unlink(tmp_path);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    free(buf);
+    free(tmp_path);
+    return ret;
+}
+
+/* Add a profile to the library at path, replacing the one with the same
+   identity and preset. The library is created if it does not exist. */
+int library_add(const char *path, const char *identity, const char *preset,
+                const struct setting *settings, int count)
+{
+    struct profile_library *lib;
+    struct lib_entry *e;
+    int i, n = 0, total = 1, ret = -1;
+
+    lib = library_open(path);
+    if(!lib && errno != ENOENT) {
+        fprintf(stderr, "Unable to read library %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if(lib) {
+        total += library_count(lib);
+    }
+
+    e = calloc(total, sizeof(*e));
+    if(!e) {
+        fprintf(stderr, "Out of memory\n");
+        library_close(lib);
+        return -1;
+    }
+    for(i=0; lib && i<library_count(lib); i++) {
+        if(!library_identity(lib, i) || !library_preset(lib, i)) {
+            fprintf(stderr, "Library %s is damaged\n", path);
+            goto out;
+        }
+        if(!strcmp(library_identity(lib, i), identity) &&
+           !strcmp(library_preset(lib, i), preset)) {
+            continue;
+        }
+        e[n].identity = library_identity(lib, i);
+        e[n].preset = library_preset(lib, i);
+        e[n].count = library_settings(lib, i, &e[n].owned);
+        if(e[n].count < 0) {
+            fprintf(stderr, "Library %s is damaged\n", path);
+            goto out;
+        }
+        e[n].settings = e[n].owned;
+        n++;
+    }
+    e[n].identity = identity;
+    e[n].preset = preset;
+    e[n].settings = settings;
+    e[n].count = count;
+    n++;
+
+    ret = write_library(path, e, n);
+
+out:
+    for(i=0; i<total; i++) {
+        free(e[i].owned);
+    }
+    free(e);
+    library_close(lib);
+    return ret;
+}
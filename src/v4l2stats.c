@@ -0,0 +1,296 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <libv4l2.h>
+
+#include "v4l2core.h"
+
+/* Entries are claimed once and never freed, a full table only loses the
+   new keys. Every field is updated with relaxed atomics: a snapshot may
+   be a few calls behind, never torn. */
+#define TABLE_SIZE 1024
+
+struct slot {
+    unsigned long long key;         /* request number + 1, control id */
+    unsigned long count;
+    unsigned long errors;
+    unsigned long long total_ns;
+    unsigned long long max_ns;
+    unsigned long buckets[STAT_BUCKETS];
+};
+
+static const struct {
+    unsigned long request;
+    const char *name;
+} requests[] = {
+    { VIDIOC_QUERYCAP, "QUERYCAP" },
+    { VIDIOC_QUERYCTRL, "QUERYCTRL" },
+    { VIDIOC_QUERY_EXT_CTRL, "QUERY_EXT_CTRL" },
+    { VIDIOC_QUERYMENU, "QUERYMENU" },
+    { VIDIOC_G_CTRL, "G_CTRL" },
+    { VIDIOC_S_CTRL, "S_CTRL" },
+    { VIDIOC_G_EXT_CTRLS, "G_EXT_CTRLS" },
+    { VIDIOC_S_EXT_CTRLS, "S_EXT_CTRLS" },
+    { VIDIOC_TRY_EXT_CTRLS, "TRY_EXT_CTRLS" },
+    { VIDIOC_SUBSCRIBE_EVENT, "SUBSCRIBE_EVENT" },
+    { VIDIOC_DQEVENT, "DQEVENT" },
+    { VIDIOC_REQBUFS, "REQBUFS" },
+    { VIDIOC_QBUF, "QBUF" },
+    { VIDIOC_DQBUF, "DQBUF" },
+    { VIDIOC_STREAMON, "STREAMON" },
+    { VIDIOC_STREAMOFF, "STREAMOFF" },
+};
+#define NREQUESTS (sizeof(requests) / sizeof(requests[0]))
+
+static struct slot table[TABLE_SIZE];
+static unsigned long dropped;
+
+static unsigned int request_number(unsigned long request)
+{
+    unsigned int i;
+
+    for(i=0; i<NREQUESTS; i++) {
+        if(requests[i].request == request) {
+            return i;
+        }
+    }
+    return NREQUESTS;
+}
+
+const char *ioctl_name(unsigned long request)
+{
+    unsigned int i = request_number(request);
+
+    return i < NREQUESTS ? requests[i].name : "other";
+}
+
+/* The control an ioctl is about. Enumeration is recorded under the
+   control found, the end of it under the last one. */
+static __u32 control_of(unsigned long request, const void *arg)
+{
+    const struct v4l2_ext_controls *ext;
+
+    switch(request) {
+    case VIDIOC_QUERYCTRL:
+        return ((const struct v4l2_queryctrl *)arg)->id;
+    case VIDIOC_QUERY_EXT_CTRL:
+        return ((const struct v4l2_query_ext_ctrl *)arg)->id;
+    case VIDIOC_QUERYMENU:
+        return ((const struct v4l2_querymenu *)arg)->id;
+    case VIDIOC_G_CTRL:
+    case VIDIOC_S_CTRL:
+        return ((const struct v4l2_control *)arg)->id;
+    case VIDIOC_G_EXT_CTRLS:
+    case VIDIOC_S_EXT_CTRLS:
+    case VIDIOC_TRY_EXT_CTRLS:
+        ext = arg;
+        if(ext->count == 1) {
+            return ext->controls[0].id;
+        }
+        if(ext->ctrl_class) {
+            return ext->ctrl_class;
+        }
+        return ext->count ? V4L2_CTRL_ID2CLASS(ext->controls[0].id) : 0;
+    }
+    return 0;
+}
+
+static struct slot *find_slot(unsigned long long key)
+{
+    unsigned int h = (unsigned int)(key * 0x9e3779b97f4a7c15ULL >> 54) % TABLE_SIZE;
+    unsigned long long cur;
+    unsigned int i;
+
+    for(i=0; i<TABLE_SIZE; i++) {
+        struct slot *s = &table[(h + i) % TABLE_SIZE];
+        cur = __atomic_load_n(&s->key, __ATOMIC_ACQUIRE);
+        if(cur == key) {
+            return s;
+        }
+        if(cur == 0) {
+            if(__atomic_compare_exchange_n(&s->key, &cur, key, 0,
+                                           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+               cur == key) {
+                return s;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void record(unsigned long request, __u32 id, unsigned long long ns, int failed)
+{
+    unsigned long long key, max;
+    unsigned int bucket = 0;
+    unsigned long long us = ns / 1000;
+    struct slot *s;
+
+    key = ((unsigned long long)(request_number(request) + 1) << 32) | id;
+    s = find_slot(key);
+    if(!s) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    while(us && bucket < STAT_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+    if(failed) {
+        __atomic_fetch_add(&s->errors, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&s->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->buckets[bucket], 1, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&s->max_ns, __ATOMIC_RELAXED);
+    while(ns > max && !__atomic_compare_exchange_n(&s->max_ns, &max, ns, 1,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+int core_ioctl(int fd, unsigned long request, void *arg)
+{
+    struct timespec start, end;
+    int ret, err;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = v4l2_ioctl(fd, request, arg);
+    err = errno;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    record(request, control_of(request, arg) & ~(V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND),
+           (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec,
+           ret == -1);
+    errno = err;
+    return ret;
+}
+
+int stats_snapshot(struct ioctl_stat *out, int max)
+{
+    unsigned long long key;
+    unsigned int i, k, n = 0;
+
+    for(i=0; i<TABLE_SIZE; i++) {
+        key = __atomic_load_n(&table[i].key, __ATOMIC_ACQUIRE);
+        if(!key || !__atomic_load_n(&table[i].count, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if((int)n < max) {
+            struct ioctl_stat *st = &out[n];
+            k = (unsigned int)(key >> 32) - 1;
+            st->request = k < NREQUESTS ? requests[k].request : 0;
+            st->id = (__u32)key;
+            st->count = __atomic_load_n(&table[i].count, __ATOMIC_RELAXED);
+            st->errors = __atomic_load_n(&table[i].errors, __ATOMIC_RELAXED);
+            st->total_ns = __atomic_load_n(&table[i].total_ns, __ATOMIC_RELAXED);
+            st->max_ns = __atomic_load_n(&table[i].max_ns, __ATOMIC_RELAXED);
+            for(k=0; k<STAT_BUCKETS; k++) {
+                st->buckets[k] = __atomic_load_n(&table[i].buckets[k], __ATOMIC_RELAXED);
+            }
+        }
+        n++;
+    }
+    return n;
+}
+
+/* Keys stay, so that a reset never races with a thread claiming a slot */
+void stats_reset(void)
+{
+    unsigned int i, k;
+
+    for(i=0; i<TABLE_SIZE; i++) {
+        __atomic_store_n(&table[i].count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&table[i].errors, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&table[i].total_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&table[i].max_ns, 0, __ATOMIC_RELAXED);
+        for(k=0; k<STAT_BUCKETS; k++) {
+            __atomic_store_n(&table[i].buckets[k], 0, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&dropped, 0, __ATOMIC_RELAXED);
+}
+
+/* The upper bound of the bucket holding that fraction of the calls,
+   or the slowest call if that is faster */
+unsigned long long stats_percentile(const struct ioctl_stat *st, double fraction)
+{
+    unsigned long seen = 0, want = (unsigned long)(st->count * fraction + 0.5);
+    unsigned int i;
+
+    if(want < 1) {
+        want = 1;
+    }
+    for(i=0; i<STAT_BUCKETS - 1; i++) {
+        seen += st->buckets[i];
+        if(seen >= want) {
+            return (1000ULL << i) < st->max_ns ? 1000ULL << i : st->max_ns;
+        }
+    }
+    return st->max_ns;
+}
+
+static int stat_cmp(const void *a, const void *b)
+{
+    const struct ioctl_stat *sa = a, *sb = b;
+
+    if(sa->total_ns != sb->total_ns) {
+        return sa->total_ns < sb->total_ns ? 1 : -1;
+    }
+    return 0;
+}
+
+void stats_print(FILE *file)
+{
+    struct ioctl_stat *st;
+    unsigned long long total = 0;
+    unsigned long calls = 0;
+    int i, n;
+
+    n = stats_snapshot(NULL, 0);
+    st = malloc((n ? n : 1) * sizeof(*st));
+    if(!st) {
+        return;
+    }
+    n = stats_snapshot(st, n);
+    qsort(st, n, sizeof(*st), stat_cmp);
+
+    fprintf(file, "%-16s %-10s %8s %6s %10s %10s %10s %10s\n", "ioctl", "control",
+            "calls", "errors", "total ms", "p50 us", "p99 us", "max us");
+    for(i=0; i<n; i++) {
+        calls += st[i].count;
+        total += st[i].total_ns;
+        fprintf(file, "%-16s 0x%08x %8lu %6lu %10.3f %10.1f %10.1f %10.1f\n",
+                st[i].request ? ioctl_name(st[i].request) : "other", st[i].id,
+                st[i].count, st[i].errors, st[i].total_ns / 1e6,
+                stats_percentile(&st[i], 0.5) / 1e3,
+                stats_percentile(&st[i], 0.99) / 1e3, st[i].max_ns / 1e3);
+    }
+    fprintf(file, "%lu ioctls, %.3f ms", calls, total / 1e6);
+    if(dropped) {
+        fprintf(file, ", %lu not recorded", dropped);
+    }
+    fprintf(file, "\n");
+    free(st);
+}
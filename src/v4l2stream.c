@@ -0,0 +1,182 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <libv4l2.h>
+
+#include "v4l2core.h"
+
+static void unmap(struct stream *s)
+{
+    struct v4l2_requestbuffers req;
+    int i;
+
+    for(i=0; i<s->count; i++) {
+        v4l2_munmap(s->start[i], s->length[i]);
+    }
+    if(s->count) {
+        /* Frees the buffers in the driver, older ones refuse a count of 0 */
+        memset(&req, 0, sizeof(req));
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        core_ioctl(s->fd, VIDIOC_REQBUFS, &req);
+    }
+    s->count = 0;
+}
+
+int stream_open(struct stream *s, const char *device, int count)
+{
+    struct v4l2_format fmt;
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buf;
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    int err;
+
+    memset(s, 0, sizeof(*s));
+    if(count > STREAM_MAX_BUFFERS) {
+        count = STREAM_MAX_BUFFERS;
+    }
+    s->fd = v4l2_open(device, O_RDWR | O_NONBLOCK);
+    if(s->fd < 0) {
+        return -1;
+    }
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if(core_ioctl(s->fd, VIDIOC_G_FMT, &fmt) != 0) {
+        goto fail;
+    }
+    s->pix = fmt.fmt.pix;
+
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if(core_ioctl(s->fd, VIDIOC_REQBUFS, &req) != 0) {
+        goto fail;
+    }
+    if(req.count < 2) {
+        errno = ENOMEM;
+        goto fail;
+    }
+    if(req.count > STREAM_MAX_BUFFERS) {
+        req.count = STREAM_MAX_BUFFERS;
+    }
+
+    for(s->count=0; s->count<(int)req.count; s->count++) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = s->count;
+        if(core_ioctl(s->fd, VIDIOC_QUERYBUF, &buf) != 0) {
+            goto fail;
+        }
+        s->length[s->count] = buf.length;
+        s->start[s->count] = v4l2_mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED, s->fd, buf.m.offset);
+        if(s->start[s->count] == MAP_FAILED) {
+            goto fail;
+        }
+        if(core_ioctl(s->fd, VIDIOC_QBUF, &buf) != 0) {
+            s->count++;
+            goto fail;
+        }
+    }
+
+    if(core_ioctl(s->fd, VIDIOC_STREAMON, &type) != 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    err = errno;
+    unmap(s);
+    v4l2_close(s->fd);
+    s->fd = -1;
+    errno = err;
+    return -1;
+}
+
+int stream_dequeue_buffer(struct stream *s, int timeout, struct v4l2_buffer *buf)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = s->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = poll(&pfd, 1, timeout);
+    if(ret < 0) {
+        return -1;
+    }
+    if(ret == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    memset(buf, 0, sizeof(*buf));
+    buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf->memory = V4L2_MEMORY_MMAP;
+    if(core_ioctl(s->fd, VIDIOC_DQBUF, buf) != 0) {
+        return -1;
+    }
+    return buf->index;
+}
+
+int stream_dequeue(struct stream *s, int timeout, __u32 *bytesused)
+{
+    struct v4l2_buffer buf;
+    int index;
+
+    index = stream_dequeue_buffer(s, timeout, &buf);
+    if(index >= 0 && bytesused) {
+        *bytesused = buf.bytesused;
+    }
+    return index;
+}
+
+int stream_queue(struct stream *s, int index)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    return core_ioctl(s->fd, VIDIOC_QBUF, &buf);
+}
+
+void stream_close(struct stream *s)
+{
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if(s->fd < 0) {
+        return;
+    }
+    core_ioctl(s->fd, VIDIOC_STREAMOFF, &type);
+    unmap(s);
+    v4l2_close(s->fd);
+    s->fd = -1;
+}
@@ -0,0 +1,378 @@
+/*  v4l2ucp - A universal control panel for all V4L2 devices
+    Copyright (C) 2005 Scott J. Bertin (scottbertin@yahoo.com)
+    Copyright (C) 2009 Vasily Khoruzhick (anarsoul@gmail.com)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#include "v4l2core.h"
+
+/* Gain steps are not calibrated, its whole range is taken to be this
+   many doublings of the signal */
+#define GAIN_STOPS 8.0
+/* Luma follows exposure through the camera's gamma */
+#define GAMMA 2.2
+
+static const __u32 tune_ids[TUNE_CONTROLS] = {
+    V4L2_CID_EXPOSURE_ABSOLUTE,
+    V4L2_CID_GAIN,
+    V4L2_CID_RED_BALANCE,
+    V4L2_CID_BLUE_BALANCE,
+    V4L2_CID_WHITE_BALANCE_TEMPERATURE,
+    V4L2_CID_EXPOSURE_AUTO,
+    V4L2_CID_AUTOGAIN,
+    V4L2_CID_AUTO_WHITE_BALANCE,
+};
+
+static const char *const tune_names[TUNE_CONTROLS] = {
+    "exposure", "gain", "red", "blue", "temperature",
+    "exposure auto", "autogain", "auto white balance",
+};
+
+void tuner_init(struct tuner *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->exposure = 1;
+    t->white_balance = 1;
+    t->target = 110;
+    t->tolerance = 8;
+    t->gray_tolerance = 0.05;
+    t->delay = 4;
+    t->max_frames = 30;
+    t->start = -1;
+}
+
+int tuner_add_control(struct tuner *t, const struct v4l2_queryctrl *q, __s32 value)
+{
+    int i;
+
+    if(q->flags & (V4L2_CTRL_FLAG_DISABLED | V4L2_CTRL_FLAG_READ_ONLY)) {
+        return 0;
+    }
+    for(i=0; i<TUNE_CONTROLS; i++) {
+        if(tune_ids[i] == q->id) {
+            t->ctrl[i].id = q->id;
+            t->ctrl[i].value = value;
+            t->ctrl[i].minimum = q->minimum;
+            t->ctrl[i].maximum = q->maximum;
+            t->ctrl[i].step = q->step > 0 ? q->step : 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static __s32 clamp_step(const struct tune_control *c, double v)
+{
+    double steps;
+
+    if(v <= c->minimum) {
+        return c->minimum;
+    }
+    if(v >= c->maximum) {
+        return c->maximum;
+    }
+    steps = floor((v - c->minimum) / c->step + 0.5);
+    return c->minimum + (__s32)steps * c->step;
+}
+
+struct writes {
+    int n;
+    int which[TUNE_CONTROLS];
+    __s32 value[TUNE_CONTROLS];
+};
+
+static void add_write(struct writes *w, const struct tuner *t, int which, __s32 value)
+{
+    if(!t->ctrl[which].id || t->ctrl[which].value == value) {
+        return;
+    }
+    w->which[w->n] = which;
+    w->value[w->n] = value;
+    w->n++;
+}
+
+/* The auto modes the camera has are turned off before anything else */
+static void manual_modes(const struct tuner *t, struct writes *w)
+{
+    if(t->exposure) {
+        add_write(w, t, TUNE_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL);
+        add_write(w, t, TUNE_AUTOGAIN, 0);
+    }
+    if(t->white_balance) {
+        add_write(w, t, TUNE_AUTO_WHITE_BALANCE, 0);
+    }
+}
+
+/* Exposure before gain when brightening, gain before exposure when
+   darkening, for the least noise. Works in stops. */
+static void tune_exposure(const struct tuner *t, const struct frame_stats *st,
+                          double luma, struct writes *w)
+{
+    const struct tune_control *e = &t->ctrl[TUNE_EXPOSURE], *g = &t->ctrl[TUNE_GAIN];
+    double stops, range, base;
+    __s32 v;
+
+    stops = GAMMA * log2(t->target / (luma > 1 ? luma : 1));
+    /* A mean over clipped highlights understates the brightness */
+    if(st->clipped > st->pixels / 5 && stops > -0.5) {
+        stops = -0.5;
+    }
+    if(stops > 3) {
+        stops = 3;
+    } else if(stops < -3) {
+        stops = -3;
+    }
+
+    if(stops > 0 && e->id) {
+        base = e->value > 0 ? e->value : (e->minimum > 1 ? e->minimum : 1);
+        v = clamp_step(e, base * exp2(stops));
+        add_write(w, t, TUNE_EXPOSURE, v);
+        stops -= log2(v / base);
+    }
+    if(g->id && (stops > 0.05 || stops < 0)) {
+        range = g->maximum - g->minimum;
+        v = clamp_step(g, g->value + range * stops / GAIN_STOPS);
+        add_write(w, t, TUNE_GAIN, v);
+        if(range > 0) {
+            stops -= (v - g->value) * GAIN_STOPS / range;
+        }
+    }
+    if(stops < -0.05 && e->id) {
+        base = e->value > 0 ? e->value : 1;
+        add_write(w, t, TUNE_EXPOSURE, clamp_step(e, base * exp2(stops)));
+    }
+}
+
+/* Grey world: the red and blue means are brought to the green one */
+static void tune_white_balance(const struct tuner *t, double r, double g, double b,
+                               struct writes *w)
+{
+    const struct tune_control *red = &t->ctrl[TUNE_RED], *blue = &t->ctrl[TUNE_BLUE];
+    const struct tune_control *temp = &t->ctrl[TUNE_TEMPERATURE];
+    double change;
+
+    if(red->id && blue->id) {
+        add_write(w, t, TUNE_RED, clamp_step(red, (red->value > 0 ? red->value : 1) * g / r));
+        add_write(w, t, TUNE_BLUE, clamp_step(blue, (blue->value > 0 ? blue->value : 1) * g / b));
+    } else if(temp->id) {
+        /* Too blue means the camera assumes warmer light than there is,
+           the temperature goes up until blue and red match */
+        change = sqrt(b / r);
+        if(change > 1.25) {
+            change = 1.25;
+        } else if(change < 0.8) {
+            change = 0.8;
+        }
+        add_write(w, t, TUNE_TEMPERATURE, clamp_step(temp, temp->value * change));
+    }
+}
+
+static int write_cmp(const void *a, const void *b)
+{
+    __u32 ia = *(const __u32 *)a, ib = *(const __u32 *)b;
+
+    return ia < ib ? -1 : ia > ib;
+}
+
+int tuner_frame(struct tuner *t, const struct frame_stats *st, double ms,
+                __u32 *ids, __s32 *values)
+{
+    struct writes w;
+    double luma, r, g, b;
+    int ae_ok, awb_ok, i, k, classes;
+    __u32 sorted[TUNE_CONTROLS][2];
+
+    t->frame++;
+    if(!st->pixels || (!t->exposure && !t->white_balance)) {
+        return 0;
+    }
+    if(t->settle > 0) {
+        t->settle--;
+        return 0;
+    }
+
+    memset(&w, 0, sizeof(w));
+    manual_modes(t, &w);
+
+    luma = frame_stats_mean(st, FRAME_LUMA);
+    r = frame_stats_mean(st, FRAME_RED);
+    g = frame_stats_mean(st, FRAME_GREEN);
+    b = frame_stats_mean(st, FRAME_BLUE);
+    ae_ok = !t->exposure || fabs(luma - t->target) <= t->tolerance;
+    awb_ok = !t->white_balance || g < 1 || r < 1 || b < 1 ||
+             (fabs(r / g - 1) <= t->gray_tolerance && fabs(b / g - 1) <= t->gray_tolerance);
+
+    if(w.n == 0 && ae_ok && awb_ok) {
+        if(t->start >= 0) {
+            t->converged++;
+            t->converge_frames = t->frame - t->start;
+            t->converge_ms = ms - t->start_ms;
+            if(t->log) {
+                fprintf(t->log, "tuner: converged in %d frames, %.1f ms, %d adjustments, %d ioctls\n",
+                        t->converge_frames, t->converge_ms, t->adjustments, t->ioctls);
+            }
+            t->start = -1;
+        }
+        return 0;
+    }
+
+    if(t->start < 0) {
+        t->start = t->frame;
+        t->start_ms = ms;
+        t->adjustments = 0;
+        t->ioctls = 0;
+        t->missed = 0;
+    } else if(!t->missed && t->frame - t->start > t->max_frames) {
+        t->missed = 1;
+        if(t->log) {
+            fprintf(t->log, "tuner: not converged after %d frames\n", t->max_frames);
+        }
+    }
+
+    if(!ae_ok) {
+        tune_exposure(t, st, luma, &w);
+    }
+    if(!awb_ok) {
+        tune_white_balance(t, r, g, b, &w);
+    }
+    if(w.n == 0) {
+        /* Out of range: nothing left to turn, as good as it gets */
+        t->start = -1;
+        return 0;
+    }
+
+    /* By id, which keeps each control class together for one
+       S_EXT_CTRLS per class */
+    for(i=0; i<w.n; i++) {
+        sorted[i][0] = t->ctrl[w.which[i]].id;
+        sorted[i][1] = i;
+    }
+    qsort(sorted, w.n, sizeof(sorted[0]), write_cmp);
+    classes = 0;
+    for(i=0; i<w.n; i++) {
+        k = sorted[i][1];
+        ids[i] = t->ctrl[w.which[k]].id;
+        values[i] = w.value[k];
+        if(i == 0 || V4L2_CTRL_ID2CLASS(ids[i]) != V4L2_CTRL_ID2CLASS(ids[i - 1])) {
+            classes++;
+        }
+    }
+
+    t->adjustments++;
+    t->ioctls += classes;
+    if(t->log) {
+        fprintf(t->log, "tuner: frame %d, luma %.1f, r/g %.3f, b/g %.3f:", t->frame,
+                luma, g >= 1 ? r / g : 0, g >= 1 ? b / g : 0);
+        for(i=0; i<w.n; i++) {
+            fprintf(t->log, " %s %d -> %d", tune_names[w.which[i]],
+                    t->ctrl[w.which[i]].value, w.value[i]);
+        }
+        fprintf(t->log, ", %d ioctl%s\n", classes, classes == 1 ? "" : "s");
+    }
+    for(i=0; i<w.n; i++) {
+        t->ctrl[w.which[i]].value = w.value[i];
+    }
+    /* The frames already on their way show the old values */
+    t->settle = t->delay;
+    return w.n;
+}
+
+/* The values from lo to hi, at most FOCUS_STEPS of them on the control's
+   steps */
+static void focus_pass(struct focus_sweep *f, __s32 lo, __s32 hi)
+{
+    const struct tune_control *c = &f->focus;
+    __s32 span;
+
+    lo = clamp_step(c, lo);
+    hi = clamp_step(c, hi);
+    span = hi - lo;
+    f->stride = (span + FOCUS_STEPS - 2) / (FOCUS_STEPS - 1);
+    f->stride = (f->stride + c->step - 1) / c->step * c->step;
+    if(f->stride < c->step) {
+        f->stride = c->step;
+    }
+    f->first = lo;
+    f->steps = span / f->stride + 1;
+    f->frame = 0;
+}
+
+void focus_sweep_init(struct focus_sweep *f, const struct v4l2_queryctrl *q, __s32 value)
+{
+    memset(f, 0, sizeof(*f));
+    f->delay = 4;
+    f->settle = 8;
+    f->focus.id = q->id;
+    f->focus.value = value;
+    f->focus.minimum = q->minimum;
+    f->focus.maximum = q->maximum;
+    f->focus.step = q->step > 0 ? q->step : 1;
+    f->best = value;
+    f->best_score = -1;
+    focus_pass(f, q->minimum, q->maximum);
+}
+
+/* Step 0 is written on the first frame of a pass, step i > 0 settle + i
+   frames later, and each shows delay frames after its write. Step 0 is
+   scored on its last frame, once the lens got there. */
+int focus_sweep_frame(struct focus_sweep *f, double sharpness, __s32 *value)
+{
+    int k = f->frame++, j, i, best = 0;
+
+    f->frames++;
+    j = k - f->delay - f->settle;
+    if(j >= 0 && j < f->steps) {
+        f->score[j] = sharpness;
+    }
+    if(j == f->steps - 1) {
+        for(i=1; i<f->steps; i++) {
+            if(f->score[i] > f->score[best]) {
+                best = i;
+            }
+        }
+        f->best = f->first + best * f->stride;
+        f->best_score = f->score[best];
+        if(f->log) {
+            fprintf(f->log, "focus: pass %d, %d values from %d by %d, best %d, "
+                    "sharpness %.1f, frame %d\n", f->pass, f->steps, f->first,
+                    f->stride, f->best, f->best_score, f->frames);
+        }
+        if(f->pass == 0 && f->stride > f->focus.step) {
+            f->pass = 1;
+            focus_pass(f, f->best - f->stride, f->best + f->stride);
+            k = f->frame++;
+        } else {
+            *value = f->focus.value = f->best;
+            return FOCUS_DONE;
+        }
+    }
+    if(k == 0) {
+        *value = f->focus.value = f->first;
+        return FOCUS_WRITE;
+    }
+    if(k > f->settle && k - f->settle < f->steps) {
+        *value = f->focus.value = f->first + (k - f->settle) * f->stride;
+        return FOCUS_WRITE;
+    }
+    return FOCUS_IDLE;
+}
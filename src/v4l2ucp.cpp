@@ -17,21 +17,25 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
  */
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 
 #include <QApplication>
+#include <QElapsedTimer>
 
 #include "mainWindow.h"
+#include "deviceProbe.h"
 
 void usage(const char *argv0)
 {
     using std::cout;
     using std::endl;
 
-    cout << "Usage: " << argv0 << " [-h | --help] [filename]..." << endl;
+    cout << "Usage: " << argv0 << " [-h | --help] [--profile-startup] [filename]..." << endl;
     cout << "-h or --help will print this message and exit." << endl;
+    cout << "--profile-startup prints how long each device took to open." << endl;
     cout << "filename is one or more device files for the ";
     cout << "V4L2 devices to control." << endl;
     cout << "If no filenames are given, the filename specified in the" << endl;
@@ -40,41 +44,78 @@ void usage(const char *argv0)
     cout << "Also accepts standard Qt arguments." << endl;
 }
 
+/* Per device timings of the startup, the slowest probe is marked */
+static void printProfile(const QList<V4L2DeviceProbe> &probes, qint64 probeTime,
+                         qint64 startupTime)
+{
+    int slowest = -1;
+    qint64 worst = 0;
+    for(int i = 0; i < probes.size(); i++) {
+        const V4L2DeviceProbe &p = probes[i];
+        qint64 t = p.openTime + p.capTime + p.enumTime;
+        if(t > worst) {
+            worst = t;
+            slowest = i;
+        }
+    }
+
+    printf("  %-20s %9s %9s %9s %9s %9s\n", "device", "open", "querycap",
+           "controls", "window", "total");
+    for(int i = 0; i < probes.size(); i++) {
+        const V4L2DeviceProbe &p = probes[i];
+        qint64 total = p.openTime + p.capTime + p.enumTime + p.buildTime;
+        printf("%c %-20s %9.1f %9.1f %9.1f %9.1f %9.1f  ", i == slowest ? '*' : ' ',
+               p.fileName.constData(), p.openTime / 1e6, p.capTime / 1e6,
+               p.enumTime / 1e6, p.buildTime / 1e6, total / 1e6);
+        if(!p.error.isEmpty())
+            printf("failed\n");
+        else
+            printf("%d controls%s\n", p.infos.size(), p.fromCache ? " from cache" : "");
+    }
+    printf("times in ms, probing %d devices took %.1f ms, startup %.1f ms\n",
+           probes.size(), probeTime / 1e6, startupTime / 1e6);
+    fflush(stdout);
+}
+
 int main(int argc, char **argv)
 {
-    MainWindow *w;
     QApplication a(argc, argv);
+    QList<QByteArray> files;
+    bool profile = false;
     bool windowOpened = false;
-    
+
     for(int i=1; i<argc; i++) {
         if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
             usage(argv[0]);
             exit(EXIT_SUCCESS);
         }
-        w = MainWindow::openFile(argv[i]);
-        if(w) {
-            w->show();
-            windowOpened = true;
+        if(!strcmp(argv[i], "--profile-startup")) {
+            profile = true;
+            continue;
         }
+        files.append(argv[i]);
     }
-    
-    if(argc == 1) {
+
+    if(files.isEmpty()) {
         const char *fname = getenv("V4L2UCP_DEV");
-        if(fname) {
-            w = MainWindow::openFile(fname);
-            if(w) {
-                w->show();
-                windowOpened = true;
-            }
-        } else {
-            w = MainWindow::openFile("/dev/video0");
-            if(w) {
-                w->show();
-                windowOpened = true;
-            }
-        }
+        files.append(fname ? fname : "/dev/video0");
     }
-    
+
+    /* Devices are probed in parallel, the windows are built here */
+    QElapsedTimer clock;
+    clock.start();
+    QList<V4L2DeviceProbe> probes = V4L2DeviceProbe::probeAll(files);
+    qint64 probeTime = clock.nsecsElapsed();
+    for(int i = 0; i < probes.size(); i++) {
+        if(MainWindow::create(probes[i]))
+            windowOpened = true;
+    }
+
+    if(profile) {
+        printProfile(probes, probeTime, clock.nsecsElapsed());
+        MainWindow::setProfileStartup(true);
+    }
+
     if(!windowOpened)
         exit(EXIT_FAILURE);
     